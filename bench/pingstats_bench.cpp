@@ -0,0 +1,280 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "console_view_impl.hpp"
+#include "csv_exporter.hpp"
+#include "icmp_checksum.hpp"
+#include "json_exporter.hpp"
+#include "metrics_server.hpp"
+#include "quantile_sketch.hpp"
+#include "statistics_aggregator_impl.hpp"
+
+using namespace pingstats;
+
+namespace {
+
+/// Upper bound of writer threads used by the add_sample benchmarks.
+constexpr int kMaxWriterThreads = 64;
+/// Samples fed to every host before snapshot benchmarks run.
+constexpr int kWarmupSamplesPerHost = 64;
+/// Rows appended before the CSV benchmark truncates its file again.
+constexpr std::int64_t kCsvRowsBeforeTruncate = 1 << 14;
+
+/// Deterministic RTT stream in the 1..60 ms range typical of WAN targets.
+std::vector<double> make_rtts(std::size_t count)
+{
+    std::mt19937 rng(42);
+    std::lognormal_distribution<double> dist(2.5, 0.5);
+    std::vector<double> rtts(count);
+    for (auto& rtt : rtts) {
+        rtt = std::min(60.0, 1.0 + dist(rng));
+    }
+    return rtts;
+}
+
+std::string host_name(int index)
+{
+    return "host-" + std::to_string(index);
+}
+
+/// Aggregator with host_count registered and warmed-up hosts; built once per size and reused
+/// across the repetitions Google Benchmark runs to calibrate iteration counts.
+std::shared_ptr<StatisticsAggregator> warm_aggregator(int host_count)
+{
+    static std::map<int, std::shared_ptr<StatisticsAggregator>> cache;
+    auto& aggregator = cache[host_count];
+    if (!aggregator) {
+        aggregator = make_statistics_aggregator();
+        const auto rtts = make_rtts(kWarmupSamplesPerHost);
+        for (int i = 0; i < host_count; ++i) {
+            const auto handle = aggregator->register_host(host_name(i));
+            for (double rtt : rtts) {
+                aggregator->add_sample(handle, rtt, true);
+            }
+        }
+    }
+    return aggregator;
+}
+
+/// Aggregator shared by all writer threads, one registered host per thread index.
+struct WriterFixture
+{
+    std::shared_ptr<StatisticsAggregator> aggregator{make_statistics_aggregator()};
+    std::vector<StatisticsAggregator::HostHandle> handles;
+    std::vector<double> rtts{make_rtts(1024)};
+
+    WriterFixture()
+    {
+        for (int i = 0; i < kMaxWriterThreads; ++i) {
+            handles.push_back(aggregator->register_host(host_name(i)));
+        }
+    }
+};
+
+WriterFixture& writer_fixture()
+{
+    static WriterFixture fixture;
+    return fixture;
+}
+
+}  // namespace
+
+/// Each writer thread feeds its own host: the common case of one session per target.
+static void BM_AddSamplePerHost(benchmark::State& state)
+{
+    auto& fixture = writer_fixture();
+    const auto handle = fixture.handles[static_cast<std::size_t>(state.thread_index())];
+    std::size_t i = 0;
+    for (auto _ : state) {
+        fixture.aggregator->add_sample(handle, fixture.rtts[i++ & 1023U], true);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddSamplePerHost)->Threads(1)->Threads(8)->Threads(kMaxWriterThreads)->UseRealTime();
+
+/// All writer threads contend on a single host.
+static void BM_AddSampleSharedHost(benchmark::State& state)
+{
+    auto& fixture = writer_fixture();
+    const auto handle = fixture.handles.front();
+    std::size_t i = 0;
+    for (auto _ : state) {
+        fixture.aggregator->add_sample(handle, fixture.rtts[i++ & 1023U], true);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddSampleSharedHost)->Threads(1)->Threads(8)->Threads(kMaxWriterThreads)->UseRealTime();
+
+/// snapshot_all() with no new samples, served from the per-host snapshot cache.
+static void BM_SnapshotAllUnchanged(benchmark::State& state)
+{
+    const auto aggregator = warm_aggregator(static_cast<int>(state.range(0)));
+    benchmark::DoNotOptimize(aggregator->snapshot_all());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(aggregator->snapshot_all());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SnapshotAllUnchanged)->Arg(10)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+/// snapshot_all() after every host received a sample, so every snapshot is rebuilt.
+static void BM_SnapshotAllChanged(benchmark::State& state)
+{
+    const int host_count = static_cast<int>(state.range(0));
+    const auto aggregator = warm_aggregator(host_count);
+    std::vector<StatisticsAggregator::HostHandle> handles;
+    for (int i = 0; i < host_count; ++i) {
+        handles.push_back(aggregator->register_host(host_name(i)));
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto handle : handles) {
+            aggregator->add_sample(handle, 12.5, true);
+        }
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(aggregator->snapshot_all());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SnapshotAllChanged)->Arg(10)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+/// Median and tail estimation, which replaced the sort-based compute_median().
+static void BM_QuantileSketchMedian(benchmark::State& state)
+{
+    QuantileSketch sketch;
+    for (double rtt : make_rtts(static_cast<std::size_t>(state.range(0)))) {
+        sketch.add(rtt);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sketch.quantile(0.5));
+    }
+}
+BENCHMARK(BM_QuantileSketchMedian)->Arg(256)->Arg(100000);
+
+static void BM_QuantileSketchAdd(benchmark::State& state)
+{
+    QuantileSketch sketch;
+    const auto rtts = make_rtts(1024);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        sketch.add(rtts[i++ & 1023U]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QuantileSketchAdd);
+
+static void BM_IcmpChecksum(benchmark::State& state)
+{
+    std::vector<std::uint8_t> packet(static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < packet.size(); ++i) {
+        packet[i] = static_cast<std::uint8_t>(i * 31U);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(packet.data());
+        benchmark::DoNotOptimize(icmp_checksum(packet.data(), packet.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IcmpChecksum)->Arg(64)->Arg(1500);
+
+static void BM_MakeSparkline(benchmark::State& state)
+{
+    const auto rtts = make_rtts(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ConsoleViewImpl::make_sparkline(rtts, 60));
+    }
+}
+BENCHMARK(BM_MakeSparkline)->Arg(256);
+
+static void BM_WriteSnapshotsCsv(benchmark::State& state)
+{
+    const auto snapshots = warm_aggregator(static_cast<int>(state.range(0)))->snapshot_all();
+    const auto path = (std::filesystem::temp_directory_path() / "pingstats_bench.csv").string();
+    std::filesystem::remove(path);
+    std::int64_t rows = 0;
+    for (auto _ : state) {
+        write_snapshots_csv_append(path, snapshots);
+        rows += state.range(0);
+        if (rows >= kCsvRowsBeforeTruncate) {
+            state.PauseTiming();
+            std::filesystem::remove(path);
+            rows = 0;
+            state.ResumeTiming();
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteSnapshotsCsv)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+/// Long-lived writer as used by the periodic exporter: one write per row set, no reopen.
+static void BM_CsvSnapshotWriter(benchmark::State& state)
+{
+    const auto snapshots = warm_aggregator(static_cast<int>(state.range(0)))->snapshot_all();
+    const auto path = (std::filesystem::temp_directory_path() / "pingstats_bench_writer.csv").string();
+    std::filesystem::remove(path);
+    {
+        CsvRotationPolicy rotation;
+        rotation.max_bytes = 64U << 20U;
+        rotation.keep_files = 0;
+        CsvSnapshotWriter writer(path, rotation);
+        for (auto _ : state) {
+            writer.append(snapshots);
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CsvSnapshotWriter)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+static void BM_WriteSnapshotsJson(benchmark::State& state)
+{
+    const auto snapshots = warm_aggregator(static_cast<int>(state.range(0)))->snapshot_all();
+    const auto path = (std::filesystem::temp_directory_path() / "pingstats_bench.json").string();
+    for (auto _ : state) {
+        write_snapshots_json(path, snapshots);
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteSnapshotsJson)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+static void BM_NdjsonSnapshotWriter(benchmark::State& state)
+{
+    const auto snapshots = warm_aggregator(static_cast<int>(state.range(0)))->snapshot_all();
+    const auto path = (std::filesystem::temp_directory_path() / "pingstats_bench.ndjson").string();
+    std::filesystem::remove(path);
+    {
+        NdjsonSnapshotWriter writer(path);
+        for (auto _ : state) {
+            writer.append(snapshots);
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NdjsonSnapshotWriter)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+/// Cost of one /metrics render; scrapes within an epoch reuse its result.
+static void BM_RenderOpenMetrics(benchmark::State& state)
+{
+    const auto snapshots = warm_aggregator(static_cast<int>(state.range(0)))->snapshot_all();
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        render_openmetrics(out, snapshots);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RenderOpenMetrics)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <netinet/in.h>
+
+namespace pingstats {
+
+/// Caches IPv4 name resolutions per host so the probe path does not call getaddrinfo.
+/// Entries expire after a TTL; a zero TTL resolves once and keeps the address for the run.
+/// Thread-safety: all public methods are safe for concurrent use.
+class AddressResolverCache {
+public:
+    /// Result of a lookup; resolve_ms is zero when the address came from the cache.
+    struct Lookup {
+        sockaddr_in address;
+        double resolve_ms;
+    };
+
+    explicit AddressResolverCache(std::chrono::seconds ttl);
+
+    /// Return the cached address, resolving when missing or expired; throws on resolution errors.
+    Lookup lookup(std::string_view host);
+
+    /// Resolve now and replace any cached entry; throws on resolution errors.
+    Lookup refresh(std::string_view host);
+
+    /// Drop the cached entry for host so the next lookup resolves again.
+    void invalidate(std::string_view host);
+
+    /// Drop all cached entries.
+    void clear();
+
+private:
+    struct Entry {
+        sockaddr_in address;
+        std::chrono::steady_clock::time_point resolved_at;
+    };
+
+    /// Blocking getaddrinfo wrapper returning the first IPv4 address.
+    static sockaddr_in resolve(const std::string& host);
+
+    std::chrono::seconds ttl_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace pingstats
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pingstats {
+
+// Largest number of histogram boundaries accepted from any source.
+constexpr std::size_t kMaxBucketBoundaries = 64;
+
+// Hard-coded fallback boundaries in milliseconds, used when no file or CLI value applies.
+const std::vector<double>& default_bucket_boundaries();
+
+// Check that boundaries are non-empty, finite, non-negative, strictly ascending, and at most
+// kMaxBucketBoundaries long. Throws std::invalid_argument describing the first violation.
+void validate_bucket_boundaries(const std::vector<double>& boundaries);
+
+// Parse a preset name (fine|log|coarse) or a comma-separated list such as "1,5,10,50".
+// Throws std::invalid_argument on malformed numbers or invalid boundaries.
+std::vector<double> parse_bucket_boundaries(std::string_view spec);
+
+// Load {"bucket_boundaries": [...]} from a JSON file and validate it.
+// Throws std::runtime_error when the file cannot be read, std::invalid_argument on bad content.
+std::vector<double> load_bucket_boundaries_file(const std::string& path);
+
+}  // namespace pingstats
@@ -1,14 +1,24 @@
 #pragma once
 
+#include <chrono>
 #include <optional>
 #include <string>
 #include <vector>
 
 namespace pingstats {
 
-// Output format selection for exporting aggregated statistics.
+// Output format selection for exporting aggregated statistics; Ndjson appends one JSON line
+// per host and export tick.
 // Not thread-safe for concurrent mutation; synchronize externally.
-enum class OutputFormat { None, Csv, Json };
+enum class OutputFormat { None, Csv, Json, Ndjson };
+
+// ICMP socket kind for backends that can choose one (Linux): Auto prefers the unprivileged
+// datagram socket and falls back to a raw socket when ping_group_range excludes the process.
+enum class IcmpSocketMode { Auto, Raw, Datagram };
+
+// Histogram layout for per-host RTT distributions: Fixed uses the classic bucket boundaries,
+// LogLinear an HDR-style log-linear histogram with configurable precision.
+enum class HistogramMode { Fixed, LogLinear };
 
 // Target configuration container for a single host.
 // Thread-safety: callers must coordinate concurrent access.
@@ -17,6 +27,7 @@ struct TargetConfig {
     std::optional<double> interval_s;
     std::optional<OutputFormat> output_format;
     std::optional<std::string> output_file;
+    // Histogram boundaries (ms, ascending) for this target; empty uses the aggregator default.
     std::vector<double> bucket_boundaries;
 
     TargetConfig() = default;
@@ -27,4 +38,41 @@ struct TargetConfig {
     TargetConfig& operator=(TargetConfig&&) = default;
 };
 
+// Runtime options for platform ping backends; backends ignore fields they do not support.
+// Thread-safety: treat as immutable once passed to a backend.
+struct BackendConfig {
+    // Lifetime of cached name resolutions; zero resolves once and keeps the address for the run.
+    std::chrono::seconds resolve_ttl{300};
+    // Measure RTT with kernel (or NIC) timestamps where the platform supports it.
+    bool kernel_timestamps{false};
+    // Socket kind used to send and receive echoes.
+    IcmpSocketMode icmp_socket_mode{IcmpSocketMode::Auto};
+
+    BackendConfig() = default;
+    ~BackendConfig() = default;
+    BackendConfig(const BackendConfig&) = default;
+    BackendConfig& operator=(const BackendConfig&) = default;
+    BackendConfig(BackendConfig&&) = default;
+    BackendConfig& operator=(BackendConfig&&) = default;
+};
+
+// Options for the statistics aggregator shared by all sessions.
+// Thread-safety: treat as immutable once passed to the aggregator.
+struct AggregatorConfig {
+    HistogramMode histogram_mode{HistogramMode::Fixed};
+    // Fixed mode: boundaries (ms) for hosts registered without their own; empty uses the built-in set.
+    std::vector<double> bucket_boundaries;
+    // Log-linear mode: trackable RTT range and significant decimal digits (1..5) kept per value.
+    double log_linear_lowest_ms{0.01};
+    double log_linear_highest_ms{60000.0};
+    int log_linear_significant_digits{2};
+
+    AggregatorConfig() = default;
+    ~AggregatorConfig() = default;
+    AggregatorConfig(const AggregatorConfig&) = default;
+    AggregatorConfig& operator=(const AggregatorConfig&) = default;
+    AggregatorConfig(AggregatorConfig&&) = default;
+    AggregatorConfig& operator=(AggregatorConfig&&) = default;
+};
+
 }  // namespace pingstats
@@ -26,10 +26,13 @@ public:
     /// Stop periodic rendering and join the worker thread.
     void stop() override;
 
+    /// Downsample RTTs into a sparkline string of at most width glyphs.
+    static std::string make_sparkline(const std::vector<double>& values, std::size_t width);
+
 private:
     /// Clear screen and print heading with current timestamp.
     void render_header() const;
-    /// Render KPI table per host (count, loss, min/max/mean/median, last RTT).
+    /// Render KPI table per host (count, loss, min/max/mean/median, p95/p99, last RTT).
     void render_table(const std::vector<StatisticsSnapshot>& snapshots) const;
     /// Render recent RTT sparklines per host.
     void render_time_series(const std::vector<StatisticsSnapshot>& snapshots) const;
@@ -40,11 +43,13 @@ private:
     static std::string format_double_or_dash(double value, bool has_value);
     /// Format packet loss percentage or '-'.
     static std::string format_loss(double loss_ratio, bool has_value);
-    /// Downsample RTTs into a sparkline string.
-    static std::string make_sparkline(const std::vector<double>& values, std::size_t width);
     /// Build proportional histogram bar.
     static std::string make_histogram_bar(double value, double max_value, std::size_t width);
 
+    /// Published set the current frame was sorted from; a new sort happens only when it changes.
+    std::shared_ptr<const SnapshotSet> rendered_set_;
+    /// rendered_set_ hosts ordered by name; touched only by the rendering thread.
+    std::vector<StatisticsSnapshot> sorted_snapshots_;
     std::atomic<bool> running_{false};
     std::thread render_thread_;
     std::mutex start_stop_mutex_;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -8,11 +11,64 @@
 
 namespace pingstats {
 
+// When a CsvSnapshotWriter starts a new file; zero disables a limit.
+struct CsvRotationPolicy {
+    // Rotate before a write would grow the current file beyond this many bytes.
+    std::uint64_t max_bytes{0};
+    // Rotate once the current file has received rows spanning this long.
+    std::chrono::seconds max_age{0};
+    // Rotated files kept as <path>.1 (newest) .. <path>.<keep_files>; older ones are removed.
+    unsigned keep_files{5};
+};
+
+// Long-lived CSV appender: keeps the file open, formats each row set into one reusable buffer
+// with std::to_chars, and hands it to the OS in a single write. The file is opened on the first
+// append (writing the header when it is new or empty) and rotated per the policy. An existing
+// file whose header differs from the current columns is rotated to <path>.1 rather than appended
+// to; with keep_files == 0 the append throws instead.
+// Not thread-safe; use from one exporting thread.
+class CsvSnapshotWriter {
+public:
+    explicit CsvSnapshotWriter(std::string path, CsvRotationPolicy rotation = CsvRotationPolicy{});
+    ~CsvSnapshotWriter();
+
+    CsvSnapshotWriter(const CsvSnapshotWriter&) = delete;
+    CsvSnapshotWriter& operator=(const CsvSnapshotWriter&) = delete;
+    CsvSnapshotWriter(CsvSnapshotWriter&&) = delete;
+    CsvSnapshotWriter& operator=(CsvSnapshotWriter&&) = delete;
+
+    // Append one row per snapshot stamped with timestamp; skips work when snapshots is empty.
+    // Rotation age is measured on these timestamps. Throws std::runtime_error on I/O errors.
+    void append(const std::vector<StatisticsSnapshot>& snapshots,
+                std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now());
+
+    // Close the current file; the next append reopens (or recreates) it.
+    void close();
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+
+private:
+    void open();
+    // Whether writing pending_bytes stamped timestamp must go to a fresh file.
+    [[nodiscard]] bool should_rotate(std::uint64_t pending_bytes,
+                                     std::chrono::system_clock::time_point timestamp) const;
+    // Close, shift <path>.N names up by one, move the current file to <path>.1, and reopen.
+    void rotate();
+
+    std::string path_;
+    CsvRotationPolicy rotation_;
+    std::FILE* file_{nullptr};
+    std::uint64_t file_bytes_{0};
+    // Timestamp of the first rows this writer put into the current file.
+    std::optional<std::chrono::system_clock::time_point> file_started_;
+    std::string buffer_;
+};
+
 // Append snapshots to a CSV file. If the file is new/empty, a header is written.
+// Opens and closes the file per call; periodic exporters should keep a CsvSnapshotWriter.
 // Throws std::runtime_error on I/O errors.
 void write_snapshots_csv_append(const std::string& path,
                                 const std::vector<StatisticsSnapshot>& snapshots,
                                 std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now());
 
 }  // namespace pingstats
-
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace pingstats {
+
+/// Contiguous ring of at most capacity elements, allocated once at construction. push_back()
+/// overwrites the oldest element when full, so steady-state use never allocates. The live range
+/// occupies at most two contiguous runs, which copy_to() copies in chronological order.
+/// Thread-safety: not synchronized; guard externally when shared.
+template <typename T>
+class FixedRingBuffer {
+public:
+    FixedRingBuffer() = default;
+
+    explicit FixedRingBuffer(std::size_t capacity)
+        : data_(capacity == 0 ? nullptr : std::make_unique<T[]>(capacity)), capacity_(capacity)
+    {
+    }
+
+    /// Deep copy of the live range only, re-based so the copy starts at index 0.
+    FixedRingBuffer(const FixedRingBuffer& other) : FixedRingBuffer(other.capacity_)
+    {
+        other.copy_to(data_.get());
+        size_ = other.size_;
+    }
+
+    FixedRingBuffer& operator=(const FixedRingBuffer& other)
+    {
+        if (this != &other) {
+            FixedRingBuffer copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    /// Moved-from buffers are left empty with capacity 0.
+    FixedRingBuffer(FixedRingBuffer&& other) noexcept
+        : data_(std::move(other.data_)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          head_(std::exchange(other.head_, 0)),
+          size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    FixedRingBuffer& operator=(FixedRingBuffer&& other) noexcept
+    {
+        data_ = std::move(other.data_);
+        capacity_ = std::exchange(other.capacity_, 0);
+        head_ = std::exchange(other.head_, 0);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+    ~FixedRingBuffer() = default;
+
+    /// Append value, dropping the oldest element when the buffer is full; no-op at capacity 0.
+    void push_back(const T& value)
+    {
+        if (capacity_ == 0) {
+            return;
+        }
+        std::size_t tail = head_ + size_;
+        if (tail >= capacity_) {
+            tail -= capacity_;
+        }
+        data_[tail] = value;
+        if (size_ < capacity_) {
+            ++size_;
+        } else if (++head_ == capacity_) {
+            head_ = 0;
+        }
+    }
+
+    /// Element index positions after the oldest; index must be < size().
+    [[nodiscard]] const T& operator[](std::size_t index) const
+    {
+        std::size_t pos = head_ + index;
+        if (pos >= capacity_) {
+            pos -= capacity_;
+        }
+        return data_[pos];
+    }
+
+    [[nodiscard]] std::size_t size() const { return size_; }
+    [[nodiscard]] std::size_t capacity() const { return capacity_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+    /// Forget all elements, keeping the allocation.
+    void clear()
+    {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    /// Replace out's contents with the elements oldest first (at most two block copies).
+    void copy_to(std::vector<T>& out) const
+    {
+        out.resize(size_);
+        copy_to(out.data());
+    }
+
+private:
+    /// Copy the live range into dest (room for size() elements), oldest first.
+    void copy_to(T* dest) const
+    {
+        const std::size_t first_run = std::min(size_, capacity_ - head_);
+        std::copy_n(data_.get() + head_, first_run, dest);
+        std::copy_n(data_.get(), size_ - first_run, dest + first_run);
+    }
+
+    std::unique_ptr<T[]> data_;
+    std::size_t capacity_{0};
+    std::size_t head_{0};  ///< index of the oldest element
+    std::size_t size_{0};
+};
+
+}  // namespace pingstats
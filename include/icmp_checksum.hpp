@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace pingstats {
+
+/// Internet checksum (RFC 1071) over len bytes, for the ICMP header checksum field.
+/// Words are loaded with memcpy, so data needs no particular alignment.
+inline std::uint16_t icmp_checksum(const void* data, std::size_t len) {
+    const auto* bytes = static_cast<const std::uint8_t*>(data);
+    std::uint32_t sum = 0;
+    const std::size_t nwords = len / 2;
+    for (std::size_t i = 0; i < nwords; ++i) {
+        std::uint16_t word;
+        std::memcpy(&word, bytes + 2 * i, sizeof(word));
+        sum += word;
+    }
+    if (len & 1U) {
+        sum += bytes[len - 1];
+    }
+    while (sum >> 16U) {
+        sum = (sum & 0xFFFFU) + (sum >> 16U);
+    }
+    return static_cast<std::uint16_t>(~sum);
+}
+
+} // namespace pingstats
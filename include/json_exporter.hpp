@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdio>
 #include <string>
 #include <vector>
 
@@ -8,11 +9,54 @@
 
 namespace pingstats {
 
-// Write snapshots to a JSON file (overwrites existing file).
+// Publishes the full JSON snapshot document: renders it into one reused buffer, writes that to
+// <path>.tmp and renames it over path, so readers see either the previous or the new document.
+// Not thread-safe; use from one exporting thread.
+class JsonSnapshotWriter {
+public:
+    explicit JsonSnapshotWriter(std::string path);
+
+    // Replace the document at path. Throws std::runtime_error on I/O errors, leaving the previous
+    // document in place.
+    void write(const std::vector<StatisticsSnapshot>& snapshots,
+               std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now());
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    std::string buffer_;
+};
+
+// Streams snapshots as NDJSON: each append adds one compact JSON object per host (timestamp,
+// host, summary metrics, windows, histogram buckets; no recent_rtts) in a single write to a file
+// kept open, so consumers can tail it instead of re-parsing a document.
+// Not thread-safe; use from one exporting thread.
+class NdjsonSnapshotWriter {
+public:
+    explicit NdjsonSnapshotWriter(std::string path);
+    ~NdjsonSnapshotWriter();
+
+    NdjsonSnapshotWriter(const NdjsonSnapshotWriter&) = delete;
+    NdjsonSnapshotWriter& operator=(const NdjsonSnapshotWriter&) = delete;
+    NdjsonSnapshotWriter(NdjsonSnapshotWriter&&) = delete;
+    NdjsonSnapshotWriter& operator=(NdjsonSnapshotWriter&&) = delete;
+
+    // Append one line per snapshot; opens the file on first use. Throws std::runtime_error on
+    // I/O errors.
+    void append(const std::vector<StatisticsSnapshot>& snapshots,
+                std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now());
+
+private:
+    std::string path_;
+    std::FILE* file_{nullptr};
+    std::string buffer_;
+};
+
+// Write snapshots to a JSON file, atomically replacing an existing one.
 // Throws std::runtime_error on I/O errors.
 void write_snapshots_json(const std::string& path,
                           const std::vector<StatisticsSnapshot>& snapshots,
                           std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now());
 
 }  // namespace pingstats
-
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "platform_ping_backend.hpp"
+
+namespace pingstats {
+
+/// Socket options fixed for an engine's lifetime; backends with equal options share an engine.
+struct LinuxIcmpEngineOptions {
+    /// Take RTTs from SO_TIMESTAMPING (RX and, where delivered, TX error-queue stamps).
+    bool kernel_timestamps{false};
+    /// Use an unprivileged SOCK_DGRAM ICMP socket (net.ipv4.ping_group_range) instead of SOCK_RAW.
+    bool datagram_socket{false};
+
+    bool operator==(const LinuxIcmpEngineOptions&) const = default;
+};
+
+/// Shared ICMP engine for Linux: one raw or datagram socket sends echoes for all targets and a
+/// single epoll-driven receiver thread demultiplexes replies by identifier/sequence.
+/// Each backend leases its own identifier, and a reply only completes a probe when identifier,
+/// sequence, source address, and the per-probe payload token all match. Probes complete through
+/// callbacks on the receiver thread, which also expires them, so any number can be in flight
+/// without a blocked caller per probe. Datagram sockets have the
+/// kernel deliver only this socket's replies but rewrite the header identifier, so the leased
+/// identifier also travels in the payload.
+/// Thread-safety: all public methods are safe for concurrent use.
+class LinuxIcmpEngine {
+public:
+    struct EchoResult {
+        bool success;
+        double rtt_ms;
+        PlatformPingBackend::ClockSource clock_source{PlatformPingBackend::ClockSource::UserSpace};
+    };
+
+    /// One probe of a batch: destination plus the identifier/sequence it is sent under.
+    struct EchoRequest {
+        sockaddr_in dest;
+        std::uint16_t identifier;
+        std::uint16_t sequence;
+    };
+
+    /// Completion handler; runs exactly once per submitted probe, normally on the receiver thread.
+    using EchoCallback = std::function<void(const EchoResult&)>;
+
+    using Options = LinuxIcmpEngineOptions;
+
+    explicit LinuxIcmpEngine(Options options = Options{});
+    ~LinuxIcmpEngine();
+
+    LinuxIcmpEngine(const LinuxIcmpEngine&) = delete;
+    LinuxIcmpEngine& operator=(const LinuxIcmpEngine&) = delete;
+    LinuxIcmpEngine(LinuxIcmpEngine&&) = delete;
+    LinuxIcmpEngine& operator=(LinuxIcmpEngine&&) = delete;
+
+    /// Process-wide engine shared by all Linux backends with the same options; started on first
+    /// use and torn down when the last user releases it. Throws if the socket cannot be opened.
+    static std::shared_ptr<LinuxIcmpEngine> shared(const Options& options = Options{});
+
+    /// Open the ICMP socket and epoll set and start the receiver thread; throws on errors.
+    void start();
+
+    /// Stop the receiver thread and close descriptors; idempotent.
+    void stop();
+
+    /// Lease an ICMP identifier unique among live backends; throws std::runtime_error once all
+    /// kIdentifierRange identifiers are leased.
+    std::uint16_t acquire_identifier();
+
+    /// Return an identifier obtained from acquire_identifier().
+    void release_identifier(std::uint16_t identifier);
+
+    /// Send one echo request to dest and return immediately; on_complete receives the reply, or
+    /// success=false once timeout expires or the engine stops. Unrelated or stale replies are
+    /// skipped. Throws if the request cannot be sent, in which case on_complete is not called.
+    /// on_complete must not block and must not call the synchronous echo APIs.
+    void echo_async(const sockaddr_in& dest, std::uint16_t identifier, std::uint16_t sequence,
+                    std::chrono::milliseconds timeout, EchoCallback on_complete);
+
+    /// Blocking wrapper over echo_async(); must not be called from a completion callback.
+    EchoResult echo(const sockaddr_in& dest, std::uint16_t identifier, std::uint16_t sequence,
+                    std::chrono::milliseconds timeout);
+
+    /// Send all requests with sendmmsg and block until each has a reply or timeout expires.
+    /// Results are in request order; requests the kernel did not accept report success=false.
+    std::vector<EchoResult> echo_batch(const std::vector<EchoRequest>& requests, std::chrono::milliseconds timeout);
+
+    /// Size of the engine's identifier block, i.e. the most backends that can be live at once.
+    static constexpr std::uint32_t kIdentifierRange = 16384;
+
+private:
+    /// In-flight probe awaiting its reply; completed by the receiver thread.
+    struct Pending {
+        std::chrono::steady_clock::time_point sent_at;
+        std::uint32_t dest_addr{0};
+        std::uint64_t token{0};
+        std::int64_t user_tx_ns{0};      ///< CLOCK_REALTIME just before sendto (kernel RX mode only)
+        std::int64_t kernel_tx_ns{0};    ///< software TX stamp from the error queue
+        std::int64_t hardware_tx_ns{0};  ///< NIC TX stamp from the error queue
+        EchoCallback on_complete;
+    };
+
+    /// Timeout entry in the expiry heap; stale once its probe completed or was replaced.
+    struct Expiry {
+        std::chrono::steady_clock::time_point deadline;
+        std::uint32_t key;
+        std::uint64_t token;
+        bool operator>(const Expiry& other) const { return deadline > other.deadline; }
+    };
+
+    /// Callback detached from pending_ together with the result to hand it outside the lock.
+    using Completion = std::pair<EchoCallback, EchoResult>;
+
+    /// Kernel/NIC timestamps attached to a received message; zero when absent.
+    struct Timestamps {
+        std::int64_t software_ns{0};
+        std::int64_t hardware_ns{0};
+    };
+
+    /// Fill packet (kPacketSize bytes) with an echo request and create its unregistered probe.
+    std::shared_ptr<Pending> build_probe(const sockaddr_in& dest, std::uint16_t identifier, std::uint16_t sequence,
+                                         std::uint8_t* packet);
+    /// Stamp the send time, insert the probe into pending_, and arm its expiry; caller holds mutex_.
+    /// A probe displaced by a wrapped sequence is failed via completions. Returns true when the
+    /// new deadline is the earliest, i.e. the receiver must be woken to shorten its wait.
+    bool register_probe(std::uint32_t key, const std::shared_ptr<Pending>& pending,
+                        std::chrono::milliseconds timeout, std::vector<Completion>& completions);
+    /// Remove a probe that was never sent; returns false if it already completed.
+    bool cancel_probe(std::uint32_t key, const std::shared_ptr<Pending>& pending);
+    /// Wake the receiver thread through the eventfd.
+    void wake_receiver();
+    /// Wait for the socket to become writable again after EAGAIN; false if deadline passes first.
+    bool wait_writable(std::chrono::steady_clock::time_point deadline) const;
+    /// Fail every probe whose deadline has passed; caller holds mutex_.
+    void expire_probes(std::chrono::steady_clock::time_point now, std::vector<Completion>& completions);
+    /// epoll_wait timeout in ms until the earliest deadline, or -1 when nothing is pending.
+    int next_expiry_timeout();
+    /// Run detached callbacks; must be called without mutex_ held.
+    static void run_completions(std::vector<Completion>& completions);
+    /// Attach a classic BPF program accepting only Echo Replies within the identifier block (raw only).
+    void attach_reply_filter();
+    /// Request SO_TIMESTAMPING (falling back to SO_TIMESTAMPNS for RX only).
+    void enable_timestamping();
+    /// Receiver thread body: waits on epoll until readiness or the next probe deadline, drains the
+    /// socket, and expires overdue probes.
+    void receive_loop();
+    /// Read all queued datagrams without blocking (recvmmsg batches) and complete matching probes.
+    void drain_socket();
+    /// Collect TX timestamps looped back on the socket error queue.
+    void drain_error_queue();
+    /// Validate one received ICMP message (IPv4 header included on raw sockets) and complete its
+    /// probe if pending.
+    void handle_packet(const std::uint8_t* data, std::size_t len, const sockaddr_in& source,
+                       std::chrono::steady_clock::time_point received_at, const Timestamps& stamps);
+    /// Extract SCM_TIMESTAMPING/SCM_TIMESTAMPNS control messages.
+    static Timestamps parse_timestamps(msghdr& msg);
+
+    /// Identifier a probe was sent under: the header field on raw sockets, the payload copy on
+    /// datagram sockets. icmp must hold a full echo header plus token and identifier.
+    std::uint16_t probe_identifier(const std::uint8_t* icmp) const;
+
+    /// Demultiplexing key combining identifier and sequence.
+    static std::uint32_t make_key(std::uint16_t identifier, std::uint16_t sequence) {
+        return (static_cast<std::uint32_t>(identifier) << 16U) | sequence;
+    }
+
+    Options options_;
+    bool kernel_rx_enabled_{false};
+    bool kernel_tx_enabled_{false};
+    int sock_fd_{-1};
+    int epoll_fd_{-1};
+    int wake_fd_{-1};
+    std::uint16_t identifier_base_{0};
+    std::uint32_t next_identifier_{0};
+    std::vector<std::uint16_t> free_identifiers_;
+    std::atomic<std::uint64_t> next_token_{0};
+    std::atomic<bool> running_{false};
+    std::thread receiver_;
+    std::mutex mutex_;
+    std::unordered_map<std::uint32_t, std::shared_ptr<Pending>> pending_;
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<>> expiries_;
+};
+
+} // namespace pingstats
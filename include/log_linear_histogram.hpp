@@ -0,0 +1,77 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pingstats {
+
+/// HDR-histogram style log-linear histogram over non-negative integers (e.g. microseconds).
+/// Values are grouped into power-of-two buckets, each split into linear sub-buckets sized so
+/// every recorded value keeps the requested number of significant decimal digits. The counts
+/// index of a value is computed with a leading-zero count and shifts, never a search.
+/// Histograms with the same layout merge by adding counts.
+/// Thread-safety: not synchronized; guard externally when shared.
+class LogLinearHistogram {
+public:
+    /// Track values in [lowest_discernible, highest_trackable] with significant_digits (1..5)
+    /// decimal digits of precision; throws std::invalid_argument on an impossible layout.
+    LogLinearHistogram(std::uint64_t lowest_discernible, std::uint64_t highest_trackable, int significant_digits);
+
+    /// Count one value; values above the trackable range land in the highest bucket.
+    void record(std::uint64_t value) { ++counts_[index_for(value)]; ++total_count_; }
+
+    /// Add another histogram's counts; throws std::invalid_argument when layouts differ.
+    void merge(const LogLinearHistogram& other);
+
+    /// Reset all counts, keeping the layout.
+    void clear();
+
+    /// Counts slot for value: bucket from the highest set bit, sub-bucket from the bits below it.
+    [[nodiscard]] std::size_t index_for(std::uint64_t value) const
+    {
+        if (value > highest_trackable_) {
+            value = highest_trackable_;
+        }
+        const int pow2_ceiling = std::bit_width(value | sub_bucket_mask_);
+        const int bucket_index = pow2_ceiling - unit_magnitude_ - (sub_bucket_half_count_magnitude_ + 1);
+        const auto sub_bucket_index = static_cast<std::size_t>(value >> (bucket_index + unit_magnitude_));
+        return (static_cast<std::size_t>(bucket_index + 1) << sub_bucket_half_count_magnitude_) +
+               sub_bucket_index - sub_bucket_half_count_;
+    }
+
+    /// Smallest value counted in slot index.
+    [[nodiscard]] std::uint64_t lowest_equivalent(std::size_t index) const;
+
+    /// Smallest value above slot index, i.e. its exclusive upper bound.
+    [[nodiscard]] std::uint64_t next_non_equivalent(std::size_t index) const;
+
+    /// Number of counts slots.
+    [[nodiscard]] std::size_t slot_count() const { return counts_.size(); }
+
+    /// Values counted in slot index.
+    [[nodiscard]] std::uint64_t count_at(std::size_t index) const { return counts_[index]; }
+
+    /// Values recorded in total.
+    [[nodiscard]] std::uint64_t total_count() const { return total_count_; }
+
+    /// True when other uses the same range and precision, so merge() is valid.
+    [[nodiscard]] bool same_layout(const LogLinearHistogram& other) const;
+
+private:
+    /// Bucket and sub-bucket of slot index, the inverse of index_for.
+    void split_index(std::size_t index, int& bucket_index, std::uint64_t& sub_bucket_index) const;
+
+    std::uint64_t lowest_discernible_;
+    std::uint64_t highest_trackable_;
+    int significant_digits_;
+    int unit_magnitude_{0};
+    int sub_bucket_half_count_magnitude_{0};
+    std::size_t sub_bucket_half_count_{0};
+    std::uint64_t sub_bucket_mask_{0};
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_count_{0};
+};
+
+}  // namespace pingstats
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "statistics_aggregator.hpp"
+
+namespace pingstats {
+
+/// Content type of the /metrics response.
+inline constexpr const char* kOpenMetricsContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+/// Append the OpenMetrics text exposition of snapshots to out, terminated by "# EOF".
+/// Per host: probe and loss counters, loss ratio, RTT min/max/mean and quantile gauges, rolling
+/// window gauges (window="1m|5m|15m"), and the RTT histogram with cumulative buckets. RTTs are
+/// exported in seconds, the OpenMetrics base unit.
+/// The histogram's le bounds are histogram_bounds_ms when given (needed in log-linear mode, whose
+/// snapshots only carry the populated slots), otherwise each snapshot's fixed boundaries; either
+/// way the set does not change between scrapes. A bucket counts RTTs <= its bound.
+void render_openmetrics(std::string& out, const std::vector<StatisticsSnapshot>& snapshots,
+                        const std::vector<double>& histogram_bounds_ms = {});
+
+/// Where the metrics listener binds; an empty host binds all interfaces.
+struct MetricsListenAddress {
+    std::string host{"127.0.0.1"};
+    std::uint16_t port{0};
+};
+
+/// Parse "port", "host:port" or "[ipv6]:port"; a bare port binds to localhost and ":port" to all
+/// interfaces. Throws std::invalid_argument on malformed input.
+MetricsListenAddress parse_metrics_listen_address(const std::string& value);
+
+/// Minimal HTTP/1.1 listener serving GET/HEAD /metrics in OpenMetrics text format.
+/// One thread multiplexes all connections with poll(). The response (headers and body) is
+/// rendered lazily, once per published SnapshotSet, and every scrape of that epoch sends the
+/// same shared buffer, so the cost per scrape is a few writes regardless of host count.
+/// Connections are closed after each response; slow or idle clients are dropped after a timeout.
+/// Thread-safety: start()/stop() must not race each other; the accessors are safe anywhere.
+class MetricsServer {
+public:
+    /// Bind and listen immediately so address errors surface before probing starts; throws
+    /// std::runtime_error when the address cannot be resolved or bound. Not supported on Windows.
+    /// histogram_bounds_ms is passed to render_openmetrics().
+    MetricsServer(std::shared_ptr<StatisticsAggregator> aggregator, const MetricsListenAddress& address,
+                  std::vector<double> histogram_bounds_ms = {});
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+    MetricsServer(MetricsServer&&) = delete;
+    MetricsServer& operator=(MetricsServer&&) = delete;
+
+    /// Start serving; idempotent.
+    void start();
+
+    /// Stop serving and close all connections; idempotent.
+    void stop();
+
+    /// Bound port; resolves port 0 to the one the kernel picked.
+    [[nodiscard]] std::uint16_t port() const { return port_; }
+
+    /// Number of /metrics bodies rendered so far.
+    [[nodiscard]] std::uint64_t render_count() const { return render_count_.load(std::memory_order_relaxed); }
+
+private:
+    struct Response;
+    struct Connection;
+
+    void run();
+    /// Read the request or send the response as revents allow; false once the connection is done.
+    bool service(Connection& connection, short revents, std::chrono::steady_clock::time_point now);
+    /// Pick the response for a complete request head.
+    void respond(Connection& connection);
+    /// Response for the current published snapshot set, rendered on first use.
+    std::shared_ptr<const Response> metrics_response();
+    static std::shared_ptr<const Response> make_response(std::string_view status, std::string_view content_type,
+                                                         std::string_view extra_headers, std::string_view body);
+
+    std::shared_ptr<StatisticsAggregator> aggregator_;
+    std::vector<double> histogram_bounds_ms_;
+    int listen_fd_{-1};
+    int wake_read_fd_{-1};
+    int wake_write_fd_{-1};
+    std::uint16_t port_{0};
+    std::shared_ptr<const Response> cached_;
+    std::string body_;  ///< render buffer reused across epochs
+    std::atomic<std::uint64_t> render_count_{0};
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+};
+
+}  // namespace pingstats
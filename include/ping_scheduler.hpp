@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace pingstats {
+
+/// Runs periodic probe tasks for many targets on a small fixed worker pool.
+/// Next-run deadlines are kept in a min-heap, so an idle target costs one heap node and one
+/// map entry instead of a dedicated thread.
+/// Thread-safety: all public methods are safe for concurrent use.
+class PingScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    /// Performs one probe and returns the delay until the next run (measured from the run start).
+    using Task = std::function<Clock::duration()>;
+    using TaskId = std::uint64_t;
+
+    /// Start worker_count worker threads (at least one).
+    explicit PingScheduler(std::size_t worker_count);
+    ~PingScheduler();
+
+    PingScheduler(const PingScheduler&) = delete;
+    PingScheduler& operator=(const PingScheduler&) = delete;
+    PingScheduler(PingScheduler&&) = delete;
+    PingScheduler& operator=(PingScheduler&&) = delete;
+
+    /// Register a task whose first run is due at first_run; returns an id for remove().
+    TaskId add(Task task, Clock::time_point first_run);
+
+    /// Unregister a task; blocks until an in-progress run of it has returned.
+    /// Must not be called from inside the task itself.
+    void remove(TaskId id);
+
+    /// Number of worker threads serving the heap.
+    [[nodiscard]] std::size_t worker_count() const { return workers_.size(); }
+
+private:
+    struct Entry {
+        Task task;
+        bool running{false};
+    };
+
+    struct Deadline {
+        Clock::time_point due;
+        TaskId id;
+        bool operator>(const Deadline& other) const { return due > other.due; }
+    };
+
+    /// Worker body: waits for the earliest deadline, runs the task, and re-arms it.
+    void worker_loop();
+
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable idle_cv_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>> heap_;
+    std::unordered_map<TaskId, Entry> entries_;
+    TaskId next_id_{1};
+    bool stopping_{false};
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace pingstats
@@ -3,11 +3,14 @@
 #include <memory>
 
 #include "config.hpp"
+#include "statistics_aggregator.hpp"
 
 namespace pingstats {
 
+class PingScheduler;
 class PlatformPingBackend;
-class StatisticsAggregator;
+class SampleIngestor;
+class SampleSink;
 
 /// Manages the lifecycle of pinging a single target.
 /// Thread-safety: callers must synchronize start/stop/set_interval when shared.
@@ -40,6 +43,8 @@ protected:
     TargetConfig target_;
     std::shared_ptr<PlatformPingBackend> backend_;
     std::shared_ptr<StatisticsAggregator> aggregator_;
+    /// Aggregator slot for target_.host, registered when the session starts.
+    StatisticsAggregator::HostHandle host_handle_{0};
 };
 
 /// Factory to create a platform-specific ping session bound to backend and aggregator.
@@ -47,5 +52,16 @@ std::unique_ptr<PingSession> make_ping_session(TargetConfig target,
                                                std::shared_ptr<PlatformPingBackend> backend,
                                                std::shared_ptr<StatisticsAggregator> aggregator);
 
+/// Factory for a session driven by a shared PingScheduler instead of its own thread.
+/// Falls back to the thread-per-session variant when scheduler is null. With an ingestor, results
+/// are queued to it instead of being written to the aggregator on the probing thread. A sink
+/// additionally receives every individual probe with its send time and sequence number.
+std::unique_ptr<PingSession> make_ping_session(TargetConfig target,
+                                               std::shared_ptr<PlatformPingBackend> backend,
+                                               std::shared_ptr<StatisticsAggregator> aggregator,
+                                               std::shared_ptr<PingScheduler> scheduler,
+                                               std::shared_ptr<SampleIngestor> ingestor = nullptr,
+                                               std::shared_ptr<SampleSink> sink = nullptr);
+
 }  // namespace pingstats
 
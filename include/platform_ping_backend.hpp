@@ -1,7 +1,11 @@
 #pragma once
 
 #include <chrono>
+#include <exception>
+#include <functional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace pingstats {
 
@@ -9,11 +13,25 @@ namespace pingstats {
 // Thread-safety: instances may be used from multiple threads only if derived classes guarantee it.
 class PlatformPingBackend {
 public:
+    // Clock that produced rtt_ms, from least to most precise.
+    enum class ClockSource {
+        UserSpace,   // steady_clock read around the send/receive syscalls
+        KernelRx,    // kernel receive timestamp, user-space send timestamp
+        KernelTxRx,  // kernel software timestamps on both send and receive
+        Hardware,    // NIC timestamps on both send and receive
+    };
+
     struct PingResult {
         bool success;
         double rtt_ms;
+        // Time spent resolving the host for this probe (0 when served from a cache); not part of rtt_ms.
+        double resolve_ms{0.0};
+        ClockSource clock_source{ClockSource::UserSpace};
     };
 
+    // Completion handler for send_ping_async.
+    using PingCallback = std::function<void(const PingResult&)>;
+
     virtual ~PlatformPingBackend() = default;
 
     PlatformPingBackend() = default;
@@ -30,9 +48,44 @@ public:
     // Thread-safety: ensure no concurrent send_ping calls when invoked.
     virtual void shutdown() = 0;
 
+    // Optional hook to resolve/prepare a target ahead of its first probe.
+    // Thread-safety: same guarantees as send_ping.
+    virtual void prepare_host(std::string_view /*host*/) {}
+
     // Send a single ping to the given host with timeout.
     // Thread-safety: implementation defines reentrancy; typically one call at a time per instance.
     virtual PingResult send_ping(std::string_view host, std::chrono::milliseconds timeout) = 0;
+
+    // Submit a ping and return without waiting for it; on_complete runs exactly once with the
+    // result, possibly before this call returns and possibly on a backend-owned thread, so it must
+    // be quick and must not call the blocking APIs of this backend. Throws when the probe cannot be
+    // submitted (e.g. resolution failure), in which case on_complete is not called.
+    // The default performs send_ping inline; backends with a native event loop keep many probes in
+    // flight per calling thread.
+    // Thread-safety: same guarantees as send_ping.
+    virtual void send_ping_async(std::string_view host, std::chrono::milliseconds timeout, PingCallback on_complete)
+    {
+        on_complete(send_ping(host, timeout));
+    }
+
+    // Ping every host once, concurrently where the platform allows, all sharing one timeout.
+    // Returns one result per host in input order; hosts that cannot be resolved or sent to report
+    // success=false instead of throwing. The default issues send_ping calls one after another.
+    // Thread-safety: same guarantees as send_ping.
+    virtual std::vector<PingResult> send_ping_batch(const std::vector<std::string>& hosts,
+                                                    std::chrono::milliseconds timeout)
+    {
+        std::vector<PingResult> results;
+        results.reserve(hosts.size());
+        for (const auto& host : hosts) {
+            try {
+                results.push_back(send_ping(host, timeout));
+            } catch (const std::exception&) {
+                results.push_back(PingResult{false, 0.0});
+            }
+        }
+        return results;
+    }
 };
 
 }  // namespace pingstats
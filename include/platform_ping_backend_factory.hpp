@@ -1,5 +1,6 @@
 #pragma once
 
+#include "config.hpp"
 #include "platform_ping_backend.hpp"
 
 #include <memory>
@@ -10,5 +11,8 @@ namespace pingstats {
 /// On unsupported platforms, returns a stub backend that always reports "unsuccessful".
 std::unique_ptr<PlatformPingBackend> make_platform_ping_backend();
 
+/// Same as above, applying runtime options such as the resolver cache TTL where supported.
+std::unique_ptr<PlatformPingBackend> make_platform_ping_backend(const BackendConfig& config);
+
 } // namespace pingstats
 
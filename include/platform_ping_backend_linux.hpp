@@ -1,38 +1,69 @@
 #pragma once
 
+#include "address_resolver_cache.hpp"
+#include "config.hpp"
 #include "platform_ping_backend.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace pingstats {
 
+class LinuxIcmpEngine;
+
 /// Linux-specific implementation of PlatformPingBackend for ICMP echo.
-/// Thread-safety: not thread-safe; callers must synchronize concurrent access.
+/// All instances with the same options share one LinuxIcmpEngine, so N targets use one socket and
+/// one receive thread. The socket is raw (CAP_NET_RAW) or an unprivileged ICMP datagram socket,
+/// chosen by BackendConfig::icmp_socket_mode.
+/// Thread-safety: send_ping may be called concurrently; initialize/shutdown must not race it.
 class LinuxPingBackend final : public PlatformPingBackend {
 public:
-    LinuxPingBackend();
+    explicit LinuxPingBackend(const BackendConfig& config = BackendConfig{});
     ~LinuxPingBackend() override;
 
-    /// Initializes raw-socket resources; throws on errors.
+    /// Attaches to the shared ICMP engine (opening its socket on first use); throws when no
+    /// permitted socket kind can be opened.
     void initialize() override;
 
-    /// Releases resources; may be called multiple times.
+    /// Detaches from the shared engine; may be called multiple times.
     void shutdown() override;
 
-    /// Sends an ICMP echo to host and waits until timeout. Returns success and RTT in milliseconds.
+    /// Resolves host into the address cache so the first probe does not pay for name resolution.
+    void prepare_host(std::string_view host) override;
+
+    /// Sends an ICMP echo to host and waits until timeout. Returns success and RTT in milliseconds;
+    /// resolution time (cache misses only) is reported separately in resolve_ms.
+    /// Thin blocking wrapper over send_ping_async().
     PingResult send_ping(std::string_view host, std::chrono::milliseconds timeout) override;
 
+    /// Submits an ICMP echo through the engine and returns at once; on_complete runs on the engine's
+    /// receiver thread when the reply arrives or the timeout expires. Resolution happens inline and
+    /// throws on failure.
+    void send_ping_async(std::string_view host, std::chrono::milliseconds timeout, PingCallback on_complete) override;
+
+    /// Sends one echo per host through the engine's sendmmsg path and waits for all replies.
+    std::vector<PingResult> send_ping_batch(const std::vector<std::string>& hosts,
+                                            std::chrono::milliseconds timeout) override;
+
+    /// Re-resolve host immediately, e.g. after a DNS change; throws on resolution errors.
+    void refresh_host(std::string_view host);
+
     LinuxPingBackend(const LinuxPingBackend&) = delete;
     LinuxPingBackend& operator=(const LinuxPingBackend&) = delete;
-    LinuxPingBackend(LinuxPingBackend&&) noexcept = default;
-    LinuxPingBackend& operator=(LinuxPingBackend&&) noexcept = default;
+    LinuxPingBackend(LinuxPingBackend&&) = delete;
+    LinuxPingBackend& operator=(LinuxPingBackend&&) = delete;
 
 private:
-    int sock_fd_{-1};
+    BackendConfig config_;
+    std::shared_ptr<LinuxIcmpEngine> engine_;
+    AddressResolverCache resolver_;
     std::uint16_t identifier_{0};
-    std::uint16_t sequence_{0};
+    std::atomic<std::uint16_t> sequence_{0};
     bool initialized_{false};
 };
 
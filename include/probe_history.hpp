@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sample_sink.hpp"
+
+namespace pingstats {
+
+/// On-disk block of one host's probe history; a history file is a plain sequence of blocks.
+/// The payload after the header holds three columns:
+///   timestamps  send times in ms after first_ms, bit-packed as delta-of-delta with the Gorilla
+///               buckets '0', '10'+7, '110'+9, '1110'+12 and '1111'+64 bits, MSB first
+///   losses      bitmap, bit i set when sample i failed, (count + 7) / 8 bytes
+///   rtts        successful samples only: RTT quantized to microseconds, zigzag delta to the
+///               previous successful sample, LEB128 varint
+/// All fields use host byte order.
+inline constexpr char kHistoryBlockMagic[4] = {'P', 'S', 'H', 'B'};
+inline constexpr std::uint16_t kHistoryBlockVersion = 1;
+
+struct HistoryBlockHeader {
+    char magic[4];
+    std::uint16_t version;
+    std::uint16_t reserved;
+    std::uint32_t count;
+    /// Bytes following the header: timestamp_bytes + loss bytes + RTT bytes.
+    std::uint32_t payload_bytes;
+    /// Send time range covered by the block, for skipping it without decoding.
+    std::int64_t min_ms;
+    std::int64_t max_ms;
+    /// Send time of the first sample; later ones may be earlier when probes complete out of order.
+    std::int64_t first_ms;
+    std::uint32_t timestamp_bytes;
+    std::uint32_t rtt_bytes;
+};
+
+static_assert(sizeof(HistoryBlockHeader) == 48, "history block headers are 48 bytes on disk");
+
+/// One decoded probe: send time with millisecond and RTT with microsecond resolution.
+struct HistorySample {
+    std::int64_t sent_unix_ms{0};
+    double rtt_ms{0.0};
+    bool success{false};
+
+    bool operator==(const HistorySample&) const = default;
+};
+
+/// Incrementally compresses one host's samples into the block columns, so a buffered block costs
+/// its compressed size (a few bytes per sample) rather than a raw record per sample.
+/// Thread-safety: none; callers serialize access per encoder.
+class HistoryBlockEncoder {
+public:
+    void append(const ProbeSample& sample);
+
+    [[nodiscard]] std::uint32_t count() const { return count_; }
+
+    /// Serialize header and columns of the current block into out (appending) and keep it open.
+    void serialize_block(std::vector<std::uint8_t>& out) const;
+
+    /// serialize_block() and start a new block.
+    void finish_block(std::vector<std::uint8_t>& out);
+
+private:
+    void write_bits(std::uint64_t value, int bits);
+
+    std::uint32_t count_{0};
+    std::int64_t first_ms_{0};
+    std::int64_t min_ms_{0};
+    std::int64_t max_ms_{0};
+    std::int64_t prev_ms_{0};
+    std::int64_t prev_delta_{0};
+    std::int64_t prev_rtt_us_{0};
+    std::vector<std::uint8_t> timestamps_;
+    int bit_fill_{8};  ///< bits used in the last timestamps_ byte
+    std::vector<std::uint8_t> losses_;
+    std::vector<std::uint8_t> rtts_;
+};
+
+/// Decode the samples of one block; payload must hold header.payload_bytes bytes. Throws
+/// std::runtime_error on malformed columns.
+std::vector<HistorySample> decode_history_block(const HistoryBlockHeader& header, const std::uint8_t* payload);
+
+/// File name used for a host inside a history directory; characters outside [A-Za-z0-9._-] and
+/// a leading '.' are percent-encoded.
+std::string history_file_name(const std::string& host);
+
+/// SampleSink keeping a compressed history per host in one file per host under a directory.
+/// Samples are encoded as they arrive into the host's open block. Once it holds block_samples
+/// samples it is sealed and queued for a writer thread, so record() never touches the file.
+/// flush() also queues every open block; the writer stores it at the end of the file and
+/// overwrites it there as it grows, so flushing often does not split blocks. At 1 Hz, a block of
+/// a stable host costs roughly 3-4 bytes per sample.
+/// Thread-safety: all public methods are safe for concurrent use; each host has its own lock.
+class ProbeHistoryStore final : public SampleSink {
+public:
+    static constexpr std::uint32_t kDefaultBlockSamples = 1024;
+
+    /// Create directory if needed; throws std::runtime_error when that fails.
+    explicit ProbeHistoryStore(std::string directory, std::uint32_t block_samples = kDefaultBlockSamples);
+    ~ProbeHistoryStore() override;
+
+    HostId register_host(const std::string& host) override;
+    /// Encode one sample; queues the block for the writer when it fills up. Write errors are
+    /// reported on stderr and drop that block.
+    void record(HostId host, const ProbeSample& sample) override;
+    /// Queue every open block with samples not yet queued and wait until the writer has stored
+    /// them, so readers see all samples recorded so far.
+    void flush() override;
+
+private:
+    struct HostSeries {
+        std::string path;
+        std::mutex mutex;
+        HistoryBlockEncoder encoder;
+        /// Samples of the open block already queued by flush().
+        std::uint32_t queued_count{0};
+        /// File size up to the end of the last sealed block; the open block is stored after it.
+        /// Only the writer thread touches it once the host is registered.
+        std::uint64_t sealed_bytes{0};
+    };
+
+    /// Serialized block waiting for the writer thread.
+    struct PendingBlock {
+        HostSeries* series;
+        std::vector<std::uint8_t> bytes;
+        /// Full block; the next block of the host starts after it.
+        bool sealed;
+    };
+
+    /// Serialize the open block of series and queue it; caller holds series.mutex.
+    void queue_block(HostSeries& series, bool sealed);
+    void writer_loop();
+    /// Store block at the host's sealed end, replacing the open block written there before.
+    static void write_block(PendingBlock& block);
+
+    std::string directory_;
+    std::uint32_t block_samples_;
+    mutable std::shared_mutex hosts_mutex_;
+    std::vector<std::unique_ptr<HostSeries>> hosts_;
+    std::unordered_map<std::string, HostId> host_ids_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<PendingBlock> queue_;
+    std::uint64_t queued_blocks_{0};   ///< guarded by queue_mutex_
+    std::uint64_t written_blocks_{0};  ///< guarded by queue_mutex_
+    bool stopping_{false};             ///< guarded by queue_mutex_
+    std::thread writer_;
+};
+
+/// Samples of host sent within [from, to], in recording order. Blocks outside the range are
+/// skipped by their header, and no other host's file is opened. An unknown host yields no
+/// samples; a truncated trailing block is ignored. Throws std::runtime_error on corrupt blocks.
+std::vector<HistorySample> read_probe_history(const std::string& directory,
+                                              const std::string& host,
+                                              std::chrono::system_clock::time_point from,
+                                              std::chrono::system_clock::time_point to);
+
+}  // namespace pingstats
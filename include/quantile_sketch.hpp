@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pingstats {
+
+/// Streaming quantile estimator in the style of DDSketch: values fall into logarithmic bins whose
+/// width guarantees a bounded relative error, so any quantile over the whole stream is answered
+/// from constant memory. Sketches with the same accuracy can be merged losslessly.
+/// Thread-safety: not synchronized; guard externally when shared.
+class QuantileSketch {
+public:
+    /// Default relative accuracy (1%) of reported quantiles.
+    static constexpr double kDefaultRelativeAccuracy = 0.01;
+    /// Default bin limit; at 1% accuracy 2048 bins span more than 17 orders of magnitude.
+    static constexpr std::size_t kDefaultMaxBins = 2048;
+
+    explicit QuantileSketch(double relative_accuracy = kDefaultRelativeAccuracy,
+                            std::size_t max_bins = kDefaultMaxBins);
+
+    /// Record one non-negative value; values too small to index are counted as zero.
+    void add(double value);
+
+    /// Fold another sketch into this one; throws std::invalid_argument on differing accuracy.
+    void merge(const QuantileSketch& other);
+
+    /// Estimate the q-quantile (q in [0,1]) interpolating between neighbouring ranks; 0 when empty.
+    [[nodiscard]] double quantile(double q) const;
+
+    /// Number of recorded values.
+    [[nodiscard]] std::uint64_t count() const { return count_; }
+
+    /// Drop all recorded values, keeping the configuration.
+    void clear();
+
+private:
+    /// Add n values to the bin for index, growing or collapsing the dense bin range as needed.
+    void add_to_bin(int index, std::uint64_t n);
+    /// Value represented by the rank-th smallest recorded value.
+    [[nodiscard]] double value_at_rank(std::uint64_t rank) const;
+    [[nodiscard]] int index_for(double value) const;
+    [[nodiscard]] double value_for(int index) const;
+
+    double relative_accuracy_;
+    double log_gamma_;
+    double midpoint_factor_;
+    std::size_t max_bins_;
+    std::vector<std::uint64_t> bins_;  ///< bins_[i] counts values with index offset_ + i
+    int offset_{0};
+    std::uint64_t zero_count_{0};
+    std::uint64_t count_{0};
+};
+
+}  // namespace pingstats
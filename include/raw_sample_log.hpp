@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sample_sink.hpp"
+
+namespace pingstats {
+
+/// On-disk layout of a raw sample log (host byte order, all offsets in bytes):
+///   [0, kRawLogHeaderBytes)                     RawSampleLogHeader, zero padded
+///   [dictionary_offset, +dictionary_capacity)   host dictionary entries
+///   [records_offset, +capacity * 32)            RawSampleRecord array, preallocated in chunks
+/// A dictionary entry is {uint32 host_id, uint32 length, length name bytes}, padded to 8 bytes.
+/// Record slots are handed out in order but filled concurrently, so readers must skip records
+/// without kRawRecordCommitted; a cleanly closed log has no such holes and is trimmed to
+/// record_count records.
+inline constexpr char kRawLogMagic[8] = {'P', 'S', 'R', 'A', 'W', 'L', 'O', 'G'};
+inline constexpr std::uint32_t kRawLogVersion = 1;
+inline constexpr std::size_t kRawLogHeaderBytes = 4096;
+
+/// RawSampleRecord::flags bits.
+inline constexpr std::uint32_t kRawRecordCommitted = 1U << 0U;
+inline constexpr std::uint32_t kRawRecordSuccess = 1U << 1U;
+
+struct RawSampleLogHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint64_t dictionary_offset;
+    std::uint64_t dictionary_capacity;
+    /// Bytes of dictionary entries written; updated after each complete entry.
+    std::uint64_t dictionary_used;
+    std::uint32_t host_count;
+    std::uint32_t reserved;
+    std::uint64_t records_offset;
+    /// Record slots handed out as of the last flush (exact after a clean close).
+    std::uint64_t record_count;
+    std::int64_t created_unix_ns;
+};
+
+/// Fixed-size probe record; two per cache line and never straddling one.
+struct RawSampleRecord {
+    std::int64_t sent_unix_ns;
+    double rtt_ms;
+    std::uint32_t host_id;
+    std::uint32_t sequence;
+    /// kRawRecord* bits; written last, so a committed record is complete.
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(RawSampleRecord) == 32, "raw log records are 32 bytes on disk");
+static_assert(sizeof(RawSampleLogHeader) <= kRawLogHeaderBytes);
+
+/// Largest accepted RawSampleLog::Options::max_records: 2^31 records, 64 GiB of records.
+inline constexpr std::uint64_t kRawLogMaxRecords = 1ULL << 31U;
+
+/// Append-only, memory-mapped log of every probe. The file grows in preallocated chunks and the
+/// record area is mapped one fixed-size chunk at a time as it grows, so only the used extent
+/// takes address space and record pointers never move. Appending reserves a slot with one atomic
+/// increment and stores the record in place, without locks or syscalls except when a chunk
+/// boundary is crossed. Reopening an existing log continues appending after
+/// its last committed record and keeps its host ids.
+/// Thread-safety: all public methods are safe for concurrent use.
+class RawSampleLog final : public SampleSink {
+public:
+    struct Options {
+        /// Record slots added to the file whenever it fills up; also the size of one mapping,
+        /// rounded up to a power of two of at least one page.
+        std::uint64_t grow_records{1U << 20U};
+        /// Upper bound on records, at most kRawLogMaxRecords; later samples are dropped and counted.
+        std::uint64_t max_records{1ULL << 28U};
+        /// Bytes reserved for the host dictionary of a new log.
+        std::uint64_t dictionary_bytes{1U << 20U};
+    };
+
+    /// Open or create the log at path; throws std::runtime_error on I/O errors or a file that is
+    /// not a compatible raw sample log, and std::invalid_argument on zero options or max_records
+    /// above kRawLogMaxRecords.
+    explicit RawSampleLog(const std::string& path);
+    RawSampleLog(const std::string& path, Options options);
+    ~RawSampleLog() override;
+
+    HostId register_host(const std::string& host) override;
+    void record(HostId host, const ProbeSample& sample) override;
+    /// Store the record count in the header and schedule dirty pages for writeback.
+    void flush() override;
+
+    /// Samples rejected because max_records was reached.
+    [[nodiscard]] std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    /// Map a fresh log into an empty file.
+    void create_log(std::int64_t created_unix_ns);
+    /// Validate and map an existing log, reloading its dictionary and append position.
+    void open_log(std::uint64_t file_size);
+    /// Extend the file until it holds slot index; false when that fails or exceeds max_records.
+    bool grow_to(std::uint64_t index);
+    /// Map the header and dictionary area and size the chunk table for max_records_.
+    void map_header(std::uint64_t records_offset);
+    /// Map every record chunk that overlaps the first capacity slots; false (errno set) when a
+    /// mapping fails. Caller holds mutex_ or has not published the log yet.
+    bool map_chunks(std::uint64_t capacity);
+    /// msync the header area and the mapped records below capacity_ with flags (MS_ASYNC/MS_SYNC).
+    void sync(int flags) const;
+    /// Unmap everything mapped so far.
+    void unmap_all();
+    RawSampleLogHeader& header() const { return *reinterpret_cast<RawSampleLogHeader*>(base_); }
+    /// Slot index; only valid below capacity_, whose chunks are all mapped.
+    RawSampleRecord& record_at(std::uint64_t index) const
+    {
+        return chunks_[index >> chunk_shift_].load(std::memory_order_acquire)[index & (chunk_records_ - 1)];
+    }
+
+    std::string path_;
+    Options options_;
+    int fd_{-1};
+    std::uint8_t* base_{nullptr};  ///< header and dictionary, up to records_offset
+    std::size_t base_bytes_{0};
+    std::uint64_t chunk_records_{0};  ///< slots per record mapping (power of two)
+    unsigned chunk_shift_{0};
+    std::unique_ptr<std::atomic<RawSampleRecord*>[]> chunks_;
+    std::uint64_t chunk_count_{0};   ///< entries in chunks_
+    std::uint64_t mapped_chunks_{0};  ///< leading chunks mapped; guarded by mutex_
+    std::uint64_t max_records_{0};
+    std::atomic<std::uint64_t> next_record_{0};
+    std::atomic<std::uint64_t> capacity_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::mutex mutex_;  ///< guards growth and the dictionary
+    std::unordered_map<std::string, HostId> host_ids_;
+};
+
+/// Read-only view of a raw sample log for offline tools and tests: maps the file and exposes the
+/// records in place, without parsing them.
+class RawSampleLogView {
+public:
+    /// Throws std::runtime_error when the file cannot be mapped or is not a raw sample log.
+    explicit RawSampleLogView(const std::string& path);
+    ~RawSampleLogView();
+
+    RawSampleLogView(const RawSampleLogView&) = delete;
+    RawSampleLogView& operator=(const RawSampleLogView&) = delete;
+    RawSampleLogView(RawSampleLogView&&) = delete;
+    RawSampleLogView& operator=(RawSampleLogView&&) = delete;
+
+    [[nodiscard]] const RawSampleLogHeader& header() const
+    {
+        return *reinterpret_cast<const RawSampleLogHeader*>(base_);
+    }
+    /// Host names indexed by host id.
+    [[nodiscard]] const std::vector<std::string>& hosts() const { return hosts_; }
+    /// Record slots present in the file, committed or not.
+    [[nodiscard]] const RawSampleRecord* records() const
+    {
+        return reinterpret_cast<const RawSampleRecord*>(base_ + header().records_offset);
+    }
+    [[nodiscard]] std::uint64_t record_slots() const { return record_slots_; }
+
+private:
+    const std::uint8_t* base_{nullptr};
+    std::size_t size_{0};
+    std::uint64_t record_slots_{0};
+    std::vector<std::string> hosts_;
+};
+
+}  // namespace pingstats
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "quantile_sketch.hpp"
+#include "statistics_aggregator.hpp"
+
+namespace pingstats {
+
+/// Rolling statistics over the recent past, built from a ring of fixed-width time slots. Each slot
+/// keeps counts, sum, extrema, and a small quantile sketch for the samples recorded during its
+/// interval; a window summary merges the newest slots, so its cost is O(slots) regardless of the
+/// sample rate. Slots are recycled lazily when their interval comes around again.
+/// Thread-safety: not synchronized; guard externally when shared.
+class RollingWindow {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Default slot width; windows are resolved to this granularity.
+    static constexpr std::chrono::seconds kDefaultSlotWidth{10};
+    /// Default slot count; 90 slots of 10 s cover the longest (15 minute) window.
+    static constexpr std::size_t kDefaultSlotCount = 90;
+
+    explicit RollingWindow(std::chrono::seconds slot_width = kDefaultSlotWidth,
+                           std::size_t slot_count = kDefaultSlotCount);
+
+    /// Record one measurement taken at now; success=false counts as loss.
+    void add(Clock::time_point now, double rtt_ms, bool success);
+
+    /// Summarize the slots covering the last span before now: the current, partially filled slot
+    /// plus enough earlier ones to reach span (capped at the ring length).
+    [[nodiscard]] WindowSummary summarize(Clock::time_point now, std::chrono::seconds span) const;
+
+    /// Drop all recorded samples.
+    void clear();
+
+private:
+    struct Slot {
+        std::int64_t epoch{-1};  ///< slot_width-sized interval index this slot currently holds
+        std::size_t sent{0};
+        std::size_t success{0};
+        double sum_ms{0.0};
+        double min_ms{std::numeric_limits<double>::infinity()};
+        double max_ms{-std::numeric_limits<double>::infinity()};
+        QuantileSketch quantiles;
+    };
+
+    [[nodiscard]] std::int64_t epoch_for(Clock::time_point now) const;
+    /// Empty the slot and mark it as holding interval epoch.
+    static void reset_slot(Slot& slot, std::int64_t epoch);
+
+    std::chrono::steady_clock::duration slot_width_;
+    std::vector<Slot> slots_;
+};
+
+}  // namespace pingstats
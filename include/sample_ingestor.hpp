@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.hpp"
+#include "statistics_aggregator.hpp"
+
+namespace pingstats {
+
+/// One measurement on its way from a probing thread to the aggregator.
+struct SampleRecord {
+    StatisticsAggregator::HostHandle host{0};
+    double rtt_ms{0.0};
+    bool success{false};
+    std::chrono::steady_clock::time_point measured_at{};
+};
+
+/// Decouples probing from aggregation: producers push SampleRecords into a lock-free SPSC lane of
+/// their own (one per producing thread, created on that thread's first submit), and a single
+/// ingest thread drains all lanes in batches into the aggregator. Producers never touch the
+/// aggregator's locks, and per-host statistics have exactly one writer while it runs.
+/// Thread-safety: submit() and flush() are safe from any thread; start()/stop() must not race.
+class SampleIngestor {
+public:
+    /// Records per producer lane (rounded up to a power of two).
+    static constexpr std::size_t kDefaultLaneCapacity = 4096;
+    /// Longest flush() waits by default.
+    static constexpr std::chrono::milliseconds kDefaultFlushTimeout{5000};
+
+    explicit SampleIngestor(std::shared_ptr<StatisticsAggregator> aggregator,
+                            std::size_t lane_capacity = kDefaultLaneCapacity);
+    ~SampleIngestor();
+
+    SampleIngestor(const SampleIngestor&) = delete;
+    SampleIngestor& operator=(const SampleIngestor&) = delete;
+    SampleIngestor(SampleIngestor&&) = delete;
+    SampleIngestor& operator=(SampleIngestor&&) = delete;
+
+    /// Start the ingest thread; idempotent.
+    void start();
+
+    /// Close every lane, drain everything submitted so far (including pushes that were in flight
+    /// when the lanes closed) and stop the ingest thread; idempotent. Later submits are applied
+    /// to the aggregator directly.
+    void stop();
+
+    /// Queue one record. Wait-free unless the calling thread's lane is full, in which case it
+    /// yields until the ingest thread makes room, so samples are never dropped.
+    void submit(const SampleRecord& record);
+
+    /// Wait until every record submitted before the call has reached the aggregator, the ingestor
+    /// stops, or timeout expires. Records submitted during the wait are not waited for. Returns
+    /// false on timeout.
+    bool flush(std::chrono::milliseconds timeout = kDefaultFlushTimeout);
+
+private:
+    /// One producer thread's queue. The producer raises pushing around each push and then
+    /// rechecks closed; stop() sets closed and then drains until no push is in flight, so no
+    /// record can land in a lane after its final drain.
+    struct Lane {
+        explicit Lane(std::size_t capacity) : queue(capacity) {}
+
+        SpscQueue<SampleRecord> queue;
+        std::atomic<bool> closed{false};
+        std::atomic<bool> pushing{false};
+    };
+
+    /// The calling thread's lane, registering one on first use.
+    Lane& lane_for_current_thread();
+    /// Ingest thread body: drain all lanes, idling briefly when they are empty.
+    void ingest_loop();
+    /// Apply up to one batch from every lane; returns the number of records applied.
+    std::size_t drain_lanes(std::vector<std::shared_ptr<Lane>>& lanes);
+
+    std::shared_ptr<StatisticsAggregator> aggregator_;
+    std::size_t lane_capacity_;
+    std::uint64_t id_;  ///< distinguishes ingestors in the per-thread lane cache
+    std::mutex lanes_mutex_;
+    std::vector<std::shared_ptr<Lane>> lanes_;
+    bool lanes_closed_{false};  ///< state of new lanes; guarded by lanes_mutex_
+    std::atomic<std::uint64_t> lanes_version_{0};
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+};
+
+}  // namespace pingstats
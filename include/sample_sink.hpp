@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pingstats {
+
+/// One probe outcome as handed to a SampleSink, before it is folded into any statistics.
+struct ProbeSample {
+    /// Wall-clock time the probe was submitted.
+    std::chrono::system_clock::time_point sent_at{};
+    double rtt_ms{0.0};
+    /// Per-host probe counter, starting at 0 when the session starts; gaps mean dropped records.
+    std::uint32_t sequence{0};
+    bool success{false};
+};
+
+/// Receives every individual probe result alongside the aggregator, e.g. to persist raw samples.
+/// Thread-safety: implementations must accept concurrent record() calls from probing threads and
+/// completion callbacks; register_host() and flush() may be called from any thread.
+class SampleSink {
+public:
+    /// Sink-local host id handed out by register_host().
+    using HostId = std::uint32_t;
+
+    virtual ~SampleSink() = default;
+
+    SampleSink() = default;
+    SampleSink(const SampleSink&) = delete;
+    SampleSink& operator=(const SampleSink&) = delete;
+    SampleSink(SampleSink&&) = delete;
+    SampleSink& operator=(SampleSink&&) = delete;
+
+    /// Register a host (idempotent) and return its id for record(); throws when the sink is full.
+    virtual HostId register_host(const std::string& host) = 0;
+
+    /// Record one probe of a registered host. Must stay cheap: it runs on the probing path.
+    virtual void record(HostId host, const ProbeSample& sample) = 0;
+
+    /// Publish everything recorded so far to readers of the sink's output.
+    virtual void flush() = 0;
+};
+
+/// Sink forwarding every call to all of sinks, e.g. a raw log and a compressed history at once.
+/// A single sink is returned as is; none yields nullptr.
+std::shared_ptr<SampleSink> make_sample_sink_fanout(std::vector<std::shared_ptr<SampleSink>> sinks);
+
+}  // namespace pingstats
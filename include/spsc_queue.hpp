@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace pingstats {
+
+/// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+/// Head and tail live on separate cache lines, and each side caches the other's index so the
+/// shared line is only read when the cached view is too short for the request.
+/// Elements stay in place until the consumer's callback returns, so empty() on the producer side
+/// means every pushed element has been fully consumed.
+template <typename T>
+class SpscQueue {
+public:
+    /// Capacity is rounded up to a power of two so positions wrap with a mask.
+    explicit SpscQueue(std::size_t capacity)
+        : capacity_(std::bit_ceil(capacity)), mask_(capacity_ - 1), buffer_(std::make_unique<T[]>(capacity_))
+    {
+        if (capacity == 0) {
+            throw std::invalid_argument("SpscQueue capacity must be positive");
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    SpscQueue(SpscQueue&&) = delete;
+    SpscQueue& operator=(SpscQueue&&) = delete;
+    ~SpscQueue() = default;
+
+    /// Producer side: append value; returns false when the queue is full.
+    bool try_push(const T& value)
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_) {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side: pass up to max_items elements, oldest first, to fn(const T&), then release
+    /// their slots in one store. Returns the number consumed.
+    template <typename Fn>
+    std::size_t consume(Fn&& fn, std::size_t max_items)
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < max_items) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        std::size_t available = cached_tail_ - head;
+        if (available > max_items) {
+            available = max_items;
+        }
+        for (std::size_t i = 0; i < available; ++i) {
+            fn(buffer_[(head + i) & mask_]);
+        }
+        if (available != 0) {
+            head_.store(head + available, std::memory_order_release);
+        }
+        return available;
+    }
+
+    /// True when every pushed element has been consumed; safe to call from any thread.
+    [[nodiscard]] bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    /// Elements pushed so far; safe to call from any thread.
+    [[nodiscard]] std::size_t pushed() const { return tail_.load(std::memory_order_acquire); }
+
+    /// Elements fully consumed so far; safe to call from any thread.
+    [[nodiscard]] std::size_t consumed() const { return head_.load(std::memory_order_acquire); }
+
+    [[nodiscard]] std::size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr std::size_t kCacheLineSize = 64;
+
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<T[]> buffer_;
+    alignas(kCacheLineSize) std::atomic<std::size_t> head_{0};  ///< next slot to consume
+    std::size_t cached_tail_{0};                                  ///< consumer's view of tail_
+    alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0};  ///< next slot to fill
+    std::size_t cached_head_{0};                                  ///< producer's view of head_
+};
+
+}  // namespace pingstats
@@ -1,13 +1,29 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace pingstats {
 
+/// Statistics over a recent time window (see RollingWindow); zeroed when the window is empty.
+struct WindowSummary {
+    std::size_t count{};
+    double loss_ratio{};
+    double min_ms{};
+    double max_ms{};
+    double mean_ms{};
+    double median_ms{};
+    double p95_ms{};
+    double p99_ms{};
+};
+
 /// Immutable snapshot of aggregated statistics for a host.
+/// The unprefixed metrics cover the whole run; window_* cover roughly the last 1/5/15 minutes.
 /// Thread-safety: treated as read-only value type.
 class StatisticsSnapshot {
 public:
@@ -17,9 +33,16 @@ public:
     double min_ms{};
     double max_ms{};
     double mean_ms{};
-    double median_ms{};
+    double median_ms{};  // p50 over the whole run (streaming sketch, ~1% relative error)
+    double p90_ms{};
+    double p95_ms{};
+    double p99_ms{};
+    double p999_ms{};
     std::vector<std::pair<double, double>> histogram_buckets;  // boundary,value
     std::vector<double> recent_rtts;
+    WindowSummary window_1m;
+    WindowSummary window_5m;
+    WindowSummary window_15m;
 
     StatisticsSnapshot() = default;
     ~StatisticsSnapshot() = default;
@@ -29,10 +52,20 @@ public:
     StatisticsSnapshot& operator=(StatisticsSnapshot&&) = default;
 };
 
+/// Immutable set of snapshots published by the aggregator and shared by all readers.
+struct SnapshotSet {
+    std::uint64_t version{};                          ///< aggregator data version it was built from
+    std::chrono::steady_clock::time_point built_at{};
+    std::vector<StatisticsSnapshot> hosts;            ///< registration order
+};
+
 /// Aggregates RTT samples per host.
 /// Thread-safety: implementers should make public methods safe for concurrent access.
 class StatisticsAggregator {
 public:
+    /// Compact per-host id handed out by register_host(); stable for the aggregator's lifetime.
+    using HostHandle = std::uint32_t;
+
     virtual ~StatisticsAggregator() = default;
 
     StatisticsAggregator() = default;
@@ -41,15 +74,39 @@ public:
     StatisticsAggregator(StatisticsAggregator&&) = default;
     StatisticsAggregator& operator=(StatisticsAggregator&&) = default;
 
+    /// Register a host (idempotent) and return its handle for the string-free add_sample overload.
+    virtual HostHandle register_host(const std::string& host) = 0;
+
+    /// Register a host with its own histogram boundaries (ms, ascending); empty uses the
+    /// aggregator default. Boundaries only take effect when the host is first registered.
+    virtual HostHandle register_host(const std::string& host, const std::vector<double>& bucket_boundaries) = 0;
+
     /// Record a single measurement result for a host.
     virtual void add_sample(const std::string& host, double rtt_ms, bool success) = 0;
 
+    /// Record a measurement for a registered host without any name lookup.
+    virtual void add_sample(HostHandle host, double rtt_ms, bool success) = 0;
+
+    /// Record a measurement taken at measured_at (steady clock); rolling windows file it by that
+    /// time rather than by arrival, so queued samples land in the right slot.
+    virtual void add_sample(HostHandle host, double rtt_ms, bool success,
+                            std::chrono::steady_clock::time_point measured_at) = 0;
+
     /// Retrieve a snapshot for a specific host.
     [[nodiscard]] virtual StatisticsSnapshot snapshot(const std::string& host) const = 0;
 
     /// Retrieve snapshots for all known hosts.
     [[nodiscard]] virtual std::vector<StatisticsSnapshot> snapshot_all() const = 0;
 
+    /// Snapshots of the hosts whose data changed after version (a SnapshotSet::version from an
+    /// earlier call, or 0 for all hosts), in registration order. Pass the returned version to the
+    /// next call to receive only later changes.
+    [[nodiscard]] virtual SnapshotSet snapshot_changed_since(std::uint64_t version) const = 0;
+
+    /// Current published snapshot set, shared by all readers. Rebuilt only when samples arrived
+    /// (or were reset) since it was built, so periodic readers do not repeat the work.
+    [[nodiscard]] virtual std::shared_ptr<const SnapshotSet> published_snapshots() const = 0;
+
     /// Reset statistics for a specific host.
     virtual void reset(const std::string& host) = 0;
 
@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "config.hpp"
 #include "statistics_aggregator.hpp"
 
 namespace pingstats {
@@ -10,6 +11,8 @@ namespace pingstats {
 class StatisticsAggregatorImpl : public StatisticsAggregator {
 public:
     StatisticsAggregatorImpl();
+    /// Throws std::invalid_argument when the bucket boundaries or log-linear range/precision are invalid.
+    explicit StatisticsAggregatorImpl(const AggregatorConfig& config);
     ~StatisticsAggregatorImpl() override = default;
 
     StatisticsAggregatorImpl(const StatisticsAggregatorImpl&) = delete;
@@ -17,12 +20,25 @@ public:
     StatisticsAggregatorImpl(StatisticsAggregatorImpl&&) = delete;
     StatisticsAggregatorImpl& operator=(StatisticsAggregatorImpl&&) = delete;
 
+    /// Map host to a slot in dense per-host storage; repeated calls return the same handle.
+    HostHandle register_host(const std::string& host) override;
+    /// As above with per-host boundaries; throws std::invalid_argument if they fail validation.
+    HostHandle register_host(const std::string& host, const std::vector<double>& bucket_boundaries) override;
     /// Record one measurement; success=false counts as loss.
     void add_sample(const std::string& host, double rtt_ms, bool success) override;
+    /// Record one measurement by handle; indexes straight into per-host storage.
+    void add_sample(HostHandle host, double rtt_ms, bool success) override;
+    /// Record one measurement by handle with the time it was taken.
+    void add_sample(HostHandle host, double rtt_ms, bool success,
+                    std::chrono::steady_clock::time_point measured_at) override;
     /// Retrieve metrics for a single host (empty snapshot if unknown).
     [[nodiscard]] StatisticsSnapshot snapshot(const std::string& host) const override;
     /// Retrieve metrics for all hosts.
     [[nodiscard]] std::vector<StatisticsSnapshot> snapshot_all() const override;
+    /// Hosts changed after version; cost proportional to the number of changed hosts.
+    [[nodiscard]] SnapshotSet snapshot_changed_since(std::uint64_t version) const override;
+    /// Published set; readers never block writers, and at most one reader rebuilds a stale set.
+    [[nodiscard]] std::shared_ptr<const SnapshotSet> published_snapshots() const override;
     /// Reset one host's statistics.
     void reset(const std::string& host) override;
     /// Reset statistics for all hosts.
@@ -36,5 +52,8 @@ private:
 /// Factory for shared StatisticsAggregator instance hiding concrete type.
 std::shared_ptr<StatisticsAggregator> make_statistics_aggregator();
 
+/// Factory for an aggregator with non-default options (e.g. log-linear histograms).
+std::shared_ptr<StatisticsAggregator> make_statistics_aggregator(const AggregatorConfig& config);
+
 }  // namespace pingstats
 
@@ -0,0 +1,63 @@
+#include "address_resolver_cache.hpp"
+
+#include <cstring>
+#include <netdb.h>
+#include <stdexcept>
+#include <sys/socket.h>
+
+namespace pingstats {
+
+AddressResolverCache::AddressResolverCache(std::chrono::seconds ttl) : ttl_(ttl) {}
+
+/// Serve from cache while fresh; only misses and expired entries pay for getaddrinfo.
+AddressResolverCache::Lookup AddressResolverCache::lookup(std::string_view host) {
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(std::string(host));
+        if (it != entries_.end() && (ttl_.count() == 0 || now - it->second.resolved_at < ttl_)) {
+            return Lookup{it->second.address, 0.0};
+        }
+    }
+    return refresh(host);
+}
+
+/// Resolve outside the lock so a slow DNS answer for one host does not stall the others.
+AddressResolverCache::Lookup AddressResolverCache::refresh(std::string_view host) {
+    std::string key(host);
+    const auto t0 = std::chrono::steady_clock::now();
+    const sockaddr_in address = resolve(key);
+    const auto t1 = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.insert_or_assign(std::move(key), Entry{address, t1});
+    return Lookup{address, std::chrono::duration<double, std::milli>(t1 - t0).count()};
+}
+
+void AddressResolverCache::invalidate(std::string_view host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(std::string(host));
+}
+
+void AddressResolverCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+sockaddr_in AddressResolverCache::resolve(const std::string& host) {
+    struct addrinfo hints {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_RAW;
+    hints.ai_protocol = IPPROTO_ICMP;
+    struct addrinfo* res = nullptr;
+    if (const int err = ::getaddrinfo(host.c_str(), nullptr, &hints, &res); err != 0) {
+        throw std::runtime_error(std::string("getaddrinfo failed: ") + ::gai_strerror(err));
+    }
+
+    sockaddr_in address{};
+    std::memcpy(&address, res->ai_addr, sizeof(sockaddr_in));
+    ::freeaddrinfo(res);
+    return address;
+}
+
+} // namespace pingstats
@@ -0,0 +1,154 @@
+#include "bucket_boundaries.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace pingstats {
+
+namespace {
+
+/// Named boundary tables accepted by --bucket-boundaries.
+struct Preset {
+    std::string_view name;
+    std::vector<double> boundaries;
+};
+
+const std::vector<Preset>& presets()
+{
+    static const std::vector<Preset> table{
+        {"fine", {1, 2, 3, 5, 7.5, 10, 15, 20, 30, 50, 75, 100, 150, 200, 300, 500}},
+        {"log", {0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000}},
+        {"coarse", {50, 100, 250, 500, 1000}},
+    };
+    return table;
+}
+
+/// Parse one number spanning the whole token (surrounding whitespace allowed).
+double parse_number(std::string_view token)
+{
+    const std::string text{token};
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    const double value = std::strtod(begin, &end);
+    if (end == begin) {
+        throw std::invalid_argument("Invalid bucket boundary: '" + text + "'");
+    }
+    while (*end != '\0' && std::isspace(static_cast<unsigned char>(*end))) {
+        ++end;
+    }
+    if (*end != '\0') {
+        throw std::invalid_argument("Invalid bucket boundary: '" + text + "'");
+    }
+    return value;
+}
+
+/// Split on commas and parse each element; empty elements are rejected.
+std::vector<double> parse_list(std::string_view list)
+{
+    std::vector<double> values;
+    std::size_t start = 0;
+    while (true) {
+        const std::size_t comma = list.find(',', start);
+        const std::string_view token = list.substr(start, comma == std::string_view::npos ? comma : comma - start);
+        values.push_back(parse_number(token));
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return values;
+}
+
+}  // namespace
+
+const std::vector<double>& default_bucket_boundaries()
+{
+    static const std::vector<double> boundaries{10.0, 20.0, 50.0, 100.0, 200.0, 500.0};
+    return boundaries;
+}
+
+void validate_bucket_boundaries(const std::vector<double>& boundaries)
+{
+    if (boundaries.empty()) {
+        throw std::invalid_argument("Bucket boundaries must not be empty");
+    }
+    if (boundaries.size() > kMaxBucketBoundaries) {
+        throw std::invalid_argument("At most " + std::to_string(kMaxBucketBoundaries) +
+                                    " bucket boundaries are supported, got " + std::to_string(boundaries.size()));
+    }
+    for (std::size_t i = 0; i < boundaries.size(); ++i) {
+        const double value = boundaries[i];
+        if (!std::isfinite(value) || value < 0.0) {
+            throw std::invalid_argument("Bucket boundaries must be finite and non-negative, got " +
+                                        std::to_string(value));
+        }
+        if (i > 0 && value <= boundaries[i - 1]) {
+            throw std::invalid_argument("Bucket boundaries must be strictly ascending (" +
+                                        std::to_string(boundaries[i - 1]) + " then " + std::to_string(value) + ")");
+        }
+    }
+}
+
+/// Presets are matched by exact name; anything else is treated as a list.
+std::vector<double> parse_bucket_boundaries(std::string_view spec)
+{
+    for (const auto& preset : presets()) {
+        if (spec == preset.name) {
+            return preset.boundaries;
+        }
+    }
+    auto boundaries = parse_list(spec);
+    validate_bucket_boundaries(boundaries);
+    return boundaries;
+}
+
+/// Minimal reader for the one key this file carries; other keys are ignored.
+std::vector<double> load_bucket_boundaries_file(const std::string& path)
+{
+    std::ifstream ifs(path);
+    if (!ifs.is_open()) {
+        throw std::runtime_error("Failed to open bucket file: " + path);
+    }
+    const std::string content{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+
+    const std::string key = "\"bucket_boundaries\"";
+    const std::size_t key_pos = content.find(key);
+    if (key_pos == std::string::npos) {
+        throw std::invalid_argument(path + ": missing \"bucket_boundaries\"");
+    }
+    std::size_t pos = key_pos + key.size();
+    while (pos < content.size() && std::isspace(static_cast<unsigned char>(content[pos]))) {
+        ++pos;
+    }
+    if (pos >= content.size() || content[pos] != ':') {
+        throw std::invalid_argument(path + ": expected ':' after \"bucket_boundaries\"");
+    }
+    const std::size_t open = content.find_first_not_of(" \t\r\n", pos + 1);
+    if (open == std::string::npos || content[open] != '[') {
+        throw std::invalid_argument(path + ": \"bucket_boundaries\" must be an array");
+    }
+    const std::size_t close = content.find(']', open);
+    if (close == std::string::npos) {
+        throw std::invalid_argument(path + ": unterminated \"bucket_boundaries\" array");
+    }
+    const std::string_view body = std::string_view{content}.substr(open + 1, close - open - 1);
+    if (body.find_first_not_of(" \t\r\n") == std::string_view::npos) {
+        throw std::invalid_argument(path + ": \"bucket_boundaries\" must not be empty");
+    }
+
+    std::vector<double> boundaries;
+    try {
+        boundaries = parse_list(body);
+        validate_bucket_boundaries(boundaries);
+    } catch (const std::invalid_argument& ex) {
+        throw std::invalid_argument(path + ": " + ex.what());
+    }
+    return boundaries;
+}
+
+}  // namespace pingstats
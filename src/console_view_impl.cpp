@@ -24,6 +24,8 @@ constexpr std::size_t TABLE_NUMBER_WIDTH = 8;
 constexpr std::size_t SPARKLINE_WIDTH = 40;
 /// Width of histogram bars when rendered in text.
 constexpr std::size_t HISTOGRAM_BAR_WIDTH = 30;
+/// Most histogram rows printed per host; finer histograms are merged down to fit.
+constexpr std::size_t HISTOGRAM_MAX_ROWS = 12;
 constexpr std::size_t LOSS_PERCENT_PRECISION = 1;
 constexpr std::size_t MS_PRECISION = 1;
 /// Characters from low to high intensity for sparklines.
@@ -63,6 +65,29 @@ std::string format_ms(double value)
     return oss.str();
 }
 
+/// Merge runs of adjacent buckets so a high-resolution histogram fits HISTOGRAM_MAX_ROWS rows.
+/// The trailing overflow bucket is kept as is; a merged row takes the upper bound of its last member.
+std::vector<std::pair<double, double>> coarsen_buckets(const std::vector<std::pair<double, double>>& buckets)
+{
+    if (buckets.size() <= HISTOGRAM_MAX_ROWS) {
+        return buckets;
+    }
+    const std::size_t regular = buckets.size() - 1;
+    const std::size_t group = (regular + HISTOGRAM_MAX_ROWS - 2) / (HISTOGRAM_MAX_ROWS - 1);
+    std::vector<std::pair<double, double>> rows;
+    rows.reserve(HISTOGRAM_MAX_ROWS);
+    for (std::size_t start = 0; start < regular; start += group) {
+        const std::size_t end = std::min(start + group, regular);
+        double count = 0.0;
+        for (std::size_t i = start; i < end; ++i) {
+            count += buckets[i].second;
+        }
+        rows.emplace_back(buckets[end - 1].first, count);
+    }
+    rows.push_back(buckets.back());
+    return rows;
+}
+
 }  // namespace
 
 ConsoleView::ConsoleView(std::shared_ptr<StatisticsAggregator> aggregator)
@@ -166,6 +191,8 @@ void ConsoleViewImpl::render_table(const std::vector<StatisticsSnapshot>& snapsh
         pad_right("MAX", TABLE_NUMBER_WIDTH) +
         pad_right("MEAN", TABLE_NUMBER_WIDTH) +
         pad_right("MED", TABLE_NUMBER_WIDTH) +
+        pad_right("P95", TABLE_NUMBER_WIDTH) +
+        pad_right("P99", TABLE_NUMBER_WIDTH) +
         pad_right("LAST", TABLE_NUMBER_WIDTH);
     std::cout << header << "\n";
     std::cout << std::string(header.size(), '-') << "\n";
@@ -177,6 +204,8 @@ void ConsoleViewImpl::render_table(const std::vector<StatisticsSnapshot>& snapsh
         const std::string max = format_double_or_dash(snap.max_ms, has_data);
         const std::string mean = format_double_or_dash(snap.mean_ms, has_data);
         const std::string med = format_double_or_dash(snap.median_ms, has_data);
+        const std::string p95 = format_double_or_dash(snap.p95_ms, has_data);
+        const std::string p99 = format_double_or_dash(snap.p99_ms, has_data);
         std::string last = "-";
         if (!snap.recent_rtts.empty()) {
             last = format_ms(snap.recent_rtts.back());
@@ -190,6 +219,8 @@ void ConsoleViewImpl::render_table(const std::vector<StatisticsSnapshot>& snapsh
             << pad_right(max, TABLE_NUMBER_WIDTH)
             << pad_right(mean, TABLE_NUMBER_WIDTH)
             << pad_right(med, TABLE_NUMBER_WIDTH)
+            << pad_right(p95, TABLE_NUMBER_WIDTH)
+            << pad_right(p99, TABLE_NUMBER_WIDTH)
             << pad_right(last, TABLE_NUMBER_WIDTH)
             << "\n";
     }
@@ -225,22 +256,23 @@ void ConsoleViewImpl::render_histogram(const std::vector<StatisticsSnapshot>& sn
             continue;
         }
 
+        const auto buckets = coarsen_buckets(snap.histogram_buckets);
         double max_count = 0.0;
-        for (const auto& bucket : snap.histogram_buckets) {
+        for (const auto& bucket : buckets) {
             max_count = std::max(max_count, bucket.second);
         }
 
-        for (std::size_t i = 0; i < snap.histogram_buckets.size(); ++i) {
-            const auto& bucket = snap.histogram_buckets[i];
+        for (std::size_t i = 0; i < buckets.size(); ++i) {
+            const auto& bucket = buckets[i];
             std::string label;
             if (i == 0) {
                 label = "<= " + format_ms(bucket.first);
             } else {
-                const double prev = snap.histogram_buckets[i - 1].first;
+                const double prev = buckets[i - 1].first;
                 label = format_ms(prev) + " - " + format_ms(bucket.first);
             }
-            if (i == snap.histogram_buckets.size() - 1) {
-                label = ">= " + format_ms(snap.histogram_buckets.back().first);
+            if (i == buckets.size() - 1) {
+                label = ">= " + format_ms(buckets.back().first);
             }
 
             const std::string bar = make_histogram_bar(bucket.second, max_count, HISTOGRAM_BAR_WIDTH);
@@ -254,15 +286,19 @@ void ConsoleViewImpl::render_histogram(const std::vector<StatisticsSnapshot>& sn
 
 void ConsoleViewImpl::render_once()
 {
-    auto snapshots = aggregator_->snapshot_all();
-    std::sort(snapshots.begin(), snapshots.end(), [](const auto& a, const auto& b) {
-        return a.host < b.host;
-    });
+    auto published = aggregator_->published_snapshots();
+    if (published != rendered_set_) {
+        sorted_snapshots_ = published->hosts;
+        std::sort(sorted_snapshots_.begin(), sorted_snapshots_.end(), [](const auto& a, const auto& b) {
+            return a.host < b.host;
+        });
+        rendered_set_ = std::move(published);
+    }
 
     render_header();
-    render_table(snapshots);
-    render_time_series(snapshots);
-    render_histogram(snapshots);
+    render_table(sorted_snapshots_);
+    render_time_series(sorted_snapshots_);
+    render_histogram(sorted_snapshots_);
 
     std::cout.flush();
 }
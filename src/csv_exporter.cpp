@@ -1,16 +1,21 @@
 #include "csv_exporter.hpp"
 
+#include <charconv>
 #include <chrono>
+#include <ctime>
 #include <filesystem>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
 #include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 namespace pingstats {
 
 namespace {
 
+constexpr std::string_view kCsvHeader =
+    "timestamp,host,count,loss_ratio,min_ms,max_ms,mean_ms,median_ms,p90_ms,p95_ms,p99_ms,p999_ms\n";
+
 /// Format a time point as human-readable timestamp for CSV.
 std::string format_timestamp(std::chrono::system_clock::time_point tp)
 {
@@ -22,46 +27,174 @@ std::string format_timestamp(std::chrono::system_clock::time_point tp)
 #else
     localtime_r(&t, &tm_buf);
 #endif
-    std::ostringstream oss;
-    oss << std::put_time(&tm_buf, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    char text[32];
+    const std::size_t len = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm_buf);
+    return std::string(text, len);
+}
+
+/// Whether the file at path starts with the current header line.
+bool has_current_header(const std::string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char head[kCsvHeader.size()];
+    const std::size_t read = std::fread(head, 1, sizeof(head), file);
+    std::fclose(file);
+    return std::string_view(head, read) == kCsvHeader;
+}
+
+/// Append ',' and value with six significant digits, matching the former iostream output.
+void append_field(std::string& out, double value)
+{
+    char text[32];
+    const auto res = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    out.push_back(',');
+    out.append(text, res.ptr);
+}
+
+void append_field(std::string& out, std::size_t value)
+{
+    char text[24];
+    const auto res = std::to_chars(text, text + sizeof(text), value);
+    out.push_back(',');
+    out.append(text, res.ptr);
 }
 
 }  // namespace
 
-/// Append statistics snapshots to a CSV file; creates header on first write.
-/// Skips work when no snapshots are available; throws if the file cannot be opened.
-void write_snapshots_csv_append(const std::string& path,
-                                const std::vector<StatisticsSnapshot>& snapshots,
-                                std::chrono::system_clock::time_point timestamp)
+CsvSnapshotWriter::CsvSnapshotWriter(std::string path, CsvRotationPolicy rotation)
+    : path_(std::move(path)), rotation_(rotation)
+{
+}
+
+CsvSnapshotWriter::~CsvSnapshotWriter()
+{
+    close();
+}
+
+/// Rows are rendered before deciding on rotation so the size limit sees the exact write; the
+/// header of a fresh file is prepended to the same buffer, keeping it to one write.
+void CsvSnapshotWriter::append(const std::vector<StatisticsSnapshot>& snapshots,
+                               std::chrono::system_clock::time_point timestamp)
 {
     if (snapshots.empty()) {
         return;
     }
 
-    const bool file_exists = std::filesystem::exists(path);
-    std::ofstream ofs(path, std::ios::app);
-    if (!ofs.is_open()) {
-        throw std::runtime_error("Failed to open CSV file: " + path);
+    buffer_.clear();
+    const std::string ts = format_timestamp(timestamp);
+    for (const auto& snap : snapshots) {
+        buffer_.push_back('"');
+        buffer_.append(ts);
+        buffer_.append("\",\"");
+        buffer_.append(snap.host);
+        buffer_.push_back('"');
+        append_field(buffer_, snap.count);
+        append_field(buffer_, snap.loss_ratio);
+        append_field(buffer_, snap.min_ms);
+        append_field(buffer_, snap.max_ms);
+        append_field(buffer_, snap.mean_ms);
+        append_field(buffer_, snap.median_ms);
+        append_field(buffer_, snap.p90_ms);
+        append_field(buffer_, snap.p95_ms);
+        append_field(buffer_, snap.p99_ms);
+        append_field(buffer_, snap.p999_ms);
+        buffer_.push_back('\n');
     }
 
-    if (!file_exists) {
-        ofs << "timestamp,host,count,loss_ratio,min_ms,max_ms,mean_ms,median_ms\n";
+    if (file_ == nullptr) {
+        open();
+    }
+    if (should_rotate(buffer_.size(), timestamp)) {
+        rotate();
+    }
+    if (file_bytes_ == 0) {
+        buffer_.insert(0, kCsvHeader);
     }
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        close();
+        throw std::runtime_error("Failed to write CSV file: " + path_);
+    }
+    file_bytes_ += buffer_.size();
+    if (!file_started_) {
+        file_started_ = timestamp;
+    }
+}
 
-    const std::string ts = format_timestamp(timestamp);
-    for (const auto& snap : snapshots) {
-        ofs << '"' << ts << '"'
-            << ',' << '"' << snap.host << '"'
-            << ',' << snap.count
-            << ',' << snap.loss_ratio
-            << ',' << snap.min_ms
-            << ',' << snap.max_ms
-            << ',' << snap.mean_ms
-            << ',' << snap.median_ms
-            << '\n';
+void CsvSnapshotWriter::close()
+{
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        file_ = nullptr;
     }
 }
 
-}  // namespace pingstats
+/// Unbuffered, so every append reaches the OS in exactly one write and is visible to tailers.
+/// A non-empty file with another column layout (e.g. the 8-column files of older versions) is
+/// rotated away first, so one file never mixes row layouts.
+void CsvSnapshotWriter::open()
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path_, ec);
+    if (!ec && size > 0 && !has_current_header(path_)) {
+        if (rotation_.keep_files == 0) {
+            throw std::runtime_error("CSV file has a different column layout; not appending to " + path_);
+        }
+        rotate();  // leaves path_ absent and reopens it
+        return;
+    }
+
+    file_ = std::fopen(path_.c_str(), "ab");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open CSV file: " + path_);
+    }
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+    file_bytes_ = ec ? 0 : size;
+    file_started_.reset();
+}
+
+bool CsvSnapshotWriter::should_rotate(std::uint64_t pending_bytes,
+                                      std::chrono::system_clock::time_point timestamp) const
+{
+    if (file_bytes_ == 0) {
+        return false;
+    }
+    if (rotation_.max_bytes > 0 && file_bytes_ + pending_bytes > rotation_.max_bytes) {
+        return true;
+    }
+    return rotation_.max_age.count() > 0 && file_started_ && timestamp - *file_started_ >= rotation_.max_age;
+}
+
+void CsvSnapshotWriter::rotate()
+{
+    close();
+    std::error_code ec;
+    const auto rotated = [this](unsigned index) { return path_ + "." + std::to_string(index); };
+    if (rotation_.keep_files == 0) {
+        std::filesystem::remove(path_, ec);
+    } else {
+        std::filesystem::remove(rotated(rotation_.keep_files), ec);
+        for (unsigned i = rotation_.keep_files - 1; i >= 1; --i) {
+            std::filesystem::rename(rotated(i), rotated(i + 1), ec);
+        }
+        std::filesystem::rename(path_, rotated(1), ec);
+        if (ec) {
+            throw std::runtime_error("Failed to rotate CSV file " + path_ + ": " + ec.message());
+        }
+    }
+    open();
+}
+
+/// Append statistics snapshots to a CSV file; creates header on first write.
+/// Skips work when no snapshots are available; throws if the file cannot be opened.
+void write_snapshots_csv_append(const std::string& path,
+                                const std::vector<StatisticsSnapshot>& snapshots,
+                                std::chrono::system_clock::time_point timestamp)
+{
+    CsvSnapshotWriter writer(path);
+    writer.append(snapshots, timestamp);
+}
 
+}  // namespace pingstats
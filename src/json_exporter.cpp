@@ -1,11 +1,15 @@
 #include "json_exporter.hpp"
 
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
 #include <filesystem>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
 #include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 namespace pingstats {
 
@@ -22,93 +26,269 @@ std::string format_timestamp(std::chrono::system_clock::time_point tp)
 #else
     localtime_r(&t, &tm_buf);
 #endif
-    std::ostringstream oss;
-    oss << std::put_time(&tm_buf, "%Y-%m-%dT%H:%M:%S");
-    return oss.str();
+    char text[32];
+    const std::size_t len = std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &tm_buf);
+    return std::string(text, len);
 }
 
-/// Escape a string for JSON output (basic control chars and quotes/backslashes).
-std::string escape_json(const std::string& s)
+/// Append s escaped for a JSON string (basic control chars and quotes/backslashes).
+void append_escaped(std::string& out, std::string_view s)
 {
-    std::ostringstream oss;
+    static constexpr char kHex[] = "0123456789abcdef";
     for (char c : s) {
         switch (c) {
-        case '"': oss << "\\\""; break;
-        case '\\': oss << "\\\\"; break;
-        case '\b': oss << "\\b"; break;
-        case '\f': oss << "\\f"; break;
-        case '\n': oss << "\\n"; break;
-        case '\r': oss << "\\r"; break;
-        case '\t': oss << "\\t"; break;
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
         default:
             if (static_cast<unsigned char>(c) < 0x20) {
-                oss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
-                    << static_cast<int>(static_cast<unsigned char>(c));
+                out.append("\\u00");
+                out.push_back(kHex[static_cast<unsigned char>(c) >> 4U]);
+                out.push_back(kHex[static_cast<unsigned char>(c) & 0xFU]);
             } else {
-                oss << c;
+                out.push_back(c);
             }
         }
     }
-    return oss.str();
 }
 
-}  // namespace
+/// Append a number with six significant digits (the former iostream output); null when not finite.
+void append_number(std::string& out, double value)
+{
+    if (!std::isfinite(value)) {
+        out.append("null");
+        return;
+    }
+    char text[32];
+    const auto res = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    out.append(text, res.ptr);
+}
 
-/// Write full JSON document with timestamp, per-host stats, histogram buckets, and recent RTTs.
-/// Truncates the file each time to present a fresh snapshot.
-void write_snapshots_json(const std::string& path,
-                          const std::vector<StatisticsSnapshot>& snapshots,
-                          std::chrono::system_clock::time_point timestamp)
+void append_number(std::string& out, std::size_t value)
+{
+    char text[24];
+    const auto res = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, res.ptr);
+}
+
+/// Append `"key": value`; colon is ": " in the document and ":" in NDJSON.
+template <typename T>
+void append_member(std::string& out, std::string_view key, T value, std::string_view colon)
+{
+    out.push_back('"');
+    out.append(key);
+    out.push_back('"');
+    out.append(colon);
+    append_number(out, value);
+}
+
+/// Emit one rolling-window object ("1m": {...}) without trailing separator.
+void append_window(std::string& out, const char* name, const WindowSummary& window, bool compact)
+{
+    const std::string_view colon = compact ? ":" : ": ";
+    const std::string_view sep = compact ? "," : ", ";
+    out.push_back('"');
+    out.append(name);
+    out.push_back('"');
+    out.append(colon);
+    out.push_back('{');
+    append_member(out, "count", window.count, colon);
+    out.append(sep);
+    append_member(out, "loss_ratio", window.loss_ratio, colon);
+    out.append(sep);
+    append_member(out, "min_ms", window.min_ms, colon);
+    out.append(sep);
+    append_member(out, "max_ms", window.max_ms, colon);
+    out.append(sep);
+    append_member(out, "mean_ms", window.mean_ms, colon);
+    out.append(sep);
+    append_member(out, "median_ms", window.median_ms, colon);
+    out.append(sep);
+    append_member(out, "p95_ms", window.p95_ms, colon);
+    out.append(sep);
+    append_member(out, "p99_ms", window.p99_ms, colon);
+    out.push_back('}');
+}
+
+void append_windows(std::string& out, const StatisticsSnapshot& snap, bool compact)
 {
-    std::ofstream ofs(path, std::ios::trunc);
-    if (!ofs.is_open()) {
-        throw std::runtime_error("Failed to open JSON file: " + path);
+    const std::string_view sep = compact ? "," : ", ";
+    append_window(out, "1m", snap.window_1m, compact);
+    out.append(sep);
+    append_window(out, "5m", snap.window_5m, compact);
+    out.append(sep);
+    append_window(out, "15m", snap.window_15m, compact);
+}
+
+void append_buckets(std::string& out, const StatisticsSnapshot& snap)
+{
+    for (std::size_t b = 0; b < snap.histogram_buckets.size(); ++b) {
+        const auto& bucket = snap.histogram_buckets[b];
+        out.push_back('[');
+        append_number(out, bucket.first);
+        out.push_back(',');
+        append_number(out, bucket.second);
+        out.push_back(']');
+        if (b + 1 < snap.histogram_buckets.size()) {
+            out.push_back(',');
+        }
     }
+}
+
+/// Summary metrics shared by the document and NDJSON layouts, each preceded by sep.
+void append_summary(std::string& out, const StatisticsSnapshot& snap, std::string_view sep, std::string_view colon)
+{
+    out.append(sep);
+    append_member(out, "count", snap.count, colon);
+    out.append(sep);
+    append_member(out, "loss_ratio", snap.loss_ratio, colon);
+    out.append(sep);
+    append_member(out, "min_ms", snap.min_ms, colon);
+    out.append(sep);
+    append_member(out, "max_ms", snap.max_ms, colon);
+    out.append(sep);
+    append_member(out, "mean_ms", snap.mean_ms, colon);
+    out.append(sep);
+    append_member(out, "median_ms", snap.median_ms, colon);
+    out.append(sep);
+    append_member(out, "p90_ms", snap.p90_ms, colon);
+    out.append(sep);
+    append_member(out, "p95_ms", snap.p95_ms, colon);
+    out.append(sep);
+    append_member(out, "p99_ms", snap.p99_ms, colon);
+    out.append(sep);
+    append_member(out, "p999_ms", snap.p999_ms, colon);
+}
 
-    ofs << "{\n";
-    ofs << "  \"timestamp\": \"" << escape_json(format_timestamp(timestamp)) << "\",\n";
-    ofs << "  \"hosts\": [\n";
+/// Full document: timestamp, per-host stats, rolling windows, histogram buckets and recent RTTs.
+void render_document(std::string& out,
+                     const std::vector<StatisticsSnapshot>& snapshots,
+                     std::chrono::system_clock::time_point timestamp)
+{
+    out.append("{\n  \"timestamp\": \"");
+    append_escaped(out, format_timestamp(timestamp));
+    out.append("\",\n  \"hosts\": [\n");
 
     for (std::size_t i = 0; i < snapshots.size(); ++i) {
         const auto& snap = snapshots[i];
-        ofs << "    {\n";
-        ofs << "      \"host\": \"" << escape_json(snap.host) << "\",\n";
-        ofs << "      \"count\": " << snap.count << ",\n";
-        ofs << "      \"loss_ratio\": " << snap.loss_ratio << ",\n";
-        ofs << "      \"min_ms\": " << snap.min_ms << ",\n";
-        ofs << "      \"max_ms\": " << snap.max_ms << ",\n";
-        ofs << "      \"mean_ms\": " << snap.mean_ms << ",\n";
-        ofs << "      \"median_ms\": " << snap.median_ms << ",\n";
-
-        ofs << "      \"histogram_buckets\": [";
-        for (std::size_t b = 0; b < snap.histogram_buckets.size(); ++b) {
-            const auto& bucket = snap.histogram_buckets[b];
-            ofs << "[" << bucket.first << "," << bucket.second << "]";
-            if (b + 1 < snap.histogram_buckets.size()) {
-                ofs << ",";
-            }
-        }
-        ofs << "],\n";
-
-        ofs << "      \"recent_rtts\": [";
+        out.append("    {\n      \"host\": \"");
+        append_escaped(out, snap.host);
+        out.push_back('"');
+        append_summary(out, snap, ",\n      ", ": ");
+        out.append(",\n      \"windows\": {");
+        append_windows(out, snap, false);
+        out.append("},\n      \"histogram_buckets\": [");
+        append_buckets(out, snap);
+        out.append("],\n      \"recent_rtts\": [");
         for (std::size_t r = 0; r < snap.recent_rtts.size(); ++r) {
-            ofs << snap.recent_rtts[r];
+            append_number(out, snap.recent_rtts[r]);
             if (r + 1 < snap.recent_rtts.size()) {
-                ofs << ",";
+                out.push_back(',');
             }
         }
-        ofs << "]\n";
-
-        ofs << "    }";
+        out.append("]\n    }");
         if (i + 1 < snapshots.size()) {
-            ofs << ",";
+            out.push_back(',');
         }
-        ofs << "\n";
+        out.push_back('\n');
     }
 
-    ofs << "  ]\n";
-    ofs << "}\n";
+    out.append("  ]\n}\n");
 }
 
-}  // namespace pingstats
+/// Write all of data to file; false on a short write.
+bool write_all(std::FILE* file, const std::string& data)
+{
+    return std::fwrite(data.data(), 1, data.size(), file) == data.size();
+}
 
+}  // namespace
+
+JsonSnapshotWriter::JsonSnapshotWriter(std::string path) : path_(std::move(path)) {}
+
+/// The temporary file lives next to the target so the rename stays within one file system.
+void JsonSnapshotWriter::write(const std::vector<StatisticsSnapshot>& snapshots,
+                               std::chrono::system_clock::time_point timestamp)
+{
+    buffer_.clear();
+    render_document(buffer_, snapshots, timestamp);
+
+    const std::string tmp_path = path_ + ".tmp";
+    std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Failed to open JSON file: " + tmp_path);
+    }
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    const bool written = write_all(file, buffer_);
+    const bool closed = std::fclose(file) == 0;
+    std::error_code ec;
+    if (!written || !closed) {
+        std::filesystem::remove(tmp_path, ec);
+        throw std::runtime_error("Failed to write JSON file: " + tmp_path);
+    }
+    std::filesystem::rename(tmp_path, path_, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+        throw std::runtime_error("Failed to replace JSON file: " + path_);
+    }
+}
+
+NdjsonSnapshotWriter::NdjsonSnapshotWriter(std::string path) : path_(std::move(path)) {}
+
+NdjsonSnapshotWriter::~NdjsonSnapshotWriter()
+{
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+}
+
+void NdjsonSnapshotWriter::append(const std::vector<StatisticsSnapshot>& snapshots,
+                                  std::chrono::system_clock::time_point timestamp)
+{
+    if (snapshots.empty()) {
+        return;
+    }
+
+    buffer_.clear();
+    const std::string ts = format_timestamp(timestamp);
+    for (const auto& snap : snapshots) {
+        buffer_.append("{\"timestamp\":\"");
+        append_escaped(buffer_, ts);
+        buffer_.append("\",\"host\":\"");
+        append_escaped(buffer_, snap.host);
+        buffer_.push_back('"');
+        append_summary(buffer_, snap, ",", ":");
+        buffer_.append(",\"windows\":{");
+        append_windows(buffer_, snap, true);
+        buffer_.append("},\"histogram_buckets\":[");
+        append_buckets(buffer_, snap);
+        buffer_.append("]}\n");
+    }
+
+    if (file_ == nullptr) {
+        file_ = std::fopen(path_.c_str(), "ab");
+        if (file_ == nullptr) {
+            throw std::runtime_error("Failed to open NDJSON file: " + path_);
+        }
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+    }
+    if (!write_all(file_, buffer_)) {
+        std::fclose(file_);
+        file_ = nullptr;
+        throw std::runtime_error("Failed to write NDJSON file: " + path_);
+    }
+}
+
+void write_snapshots_json(const std::string& path,
+                          const std::vector<StatisticsSnapshot>& snapshots,
+                          std::chrono::system_clock::time_point timestamp)
+{
+    JsonSnapshotWriter writer(path);
+    writer.write(snapshots, timestamp);
+}
+
+}  // namespace pingstats
@@ -0,0 +1,701 @@
+#include "linux_icmp_engine.hpp"
+#include "icmp_checksum.hpp"
+
+#if !defined(__linux__)
+#error "LinuxIcmpEngine is only available on Linux builds"
+#endif
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <condition_variable>
+#include <ctime>
+#include <linux/errqueue.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace pingstats {
+
+namespace {
+
+/// ICMP protocol number used for raw and datagram sockets.
+constexpr int kIcmpProtocol = IPPROTO_ICMP;
+/// ICMP header size in bytes.
+constexpr std::size_t kIcmpHeaderSize = sizeof(icmphdr);
+/// Payload size in bytes (traditional ping default).
+constexpr std::size_t kPayloadSize = 56;
+/// Total packet size (header + payload).
+constexpr std::size_t kPacketSize = kIcmpHeaderSize + kPayloadSize;
+/// Receive buffer requested for the shared socket so reply bursts from many targets fit.
+constexpr int kSocketReceiveBuffer = 1 << 20;
+/// Largest datagram read from the socket (IP header + ICMP + payload fits comfortably).
+constexpr std::size_t kReceiveBufferSize = 512;
+/// Datagrams read per recvmmsg call.
+constexpr unsigned kReceiveBatch = 16;
+/// Echo requests handed to one sendmmsg call.
+constexpr std::size_t kSendBatch = 64;
+/// Maximum epoll events handled per wakeup.
+constexpr int kMaxEpollEvents = 4;
+/// Bytes at the start of the payload carrying the per-probe token.
+constexpr std::size_t kTokenSize = sizeof(std::uint64_t);
+/// Payload offset of the leased identifier (network order), which datagram sockets keep intact.
+constexpr std::size_t kIdentifierOffset = kIcmpHeaderSize + kTokenSize;
+/// Echo bytes needed to demultiplex a reply: header, token, and payload identifier.
+constexpr std::size_t kMatchSize = kIdentifierOffset + sizeof(std::uint16_t);
+/// Control buffer size for timestamp/extended-error control messages.
+constexpr std::size_t kControlBufferSize = 256;
+/// SO_TIMESTAMPING flags: software RX/TX stamps plus raw NIC stamps when the device is configured.
+constexpr unsigned kTimestampingFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                                        SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+                                        SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+
+/// Nanoseconds since the epoch for a kernel timespec.
+std::int64_t to_ns(const timespec& ts) {
+    return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+/// Current CLOCK_REALTIME in nanoseconds, the clock kernel software timestamps use.
+std::int64_t realtime_now_ns() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return to_ns(ts);
+}
+
+/// Close a descriptor if open and mark it invalid.
+void close_fd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+} // namespace
+
+LinuxIcmpEngine::LinuxIcmpEngine(Options options) : options_(options) {}
+
+LinuxIcmpEngine::~LinuxIcmpEngine() {
+    stop();
+}
+
+/// Hand out the live engine for these options or create a new one; weak ownership lets it close
+/// with the last backend.
+std::shared_ptr<LinuxIcmpEngine> LinuxIcmpEngine::shared(const Options& options) {
+    static std::mutex shared_mutex;
+    static std::vector<std::pair<Options, std::weak_ptr<LinuxIcmpEngine>>> shared_engines;
+
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    for (auto& [engine_options, weak_engine] : shared_engines) {
+        if (engine_options == options) {
+            if (auto engine = weak_engine.lock()) {
+                return engine;
+            }
+        }
+    }
+    auto engine = std::make_shared<LinuxIcmpEngine>(options);
+    engine->start();
+    std::erase_if(shared_engines, [](const auto& entry) { return entry.second.expired(); });
+    shared_engines.emplace_back(options, engine);
+    return engine;
+}
+
+/// Open the ICMP socket plus epoll/eventfd; raw sockets require CAP_NET_RAW/root, datagram
+/// sockets a group inside net.ipv4.ping_group_range.
+void LinuxIcmpEngine::start() {
+    if (running_.load()) {
+        return;
+    }
+    if (options_.datagram_socket) {
+        sock_fd_ = ::socket(AF_INET, SOCK_DGRAM, kIcmpProtocol);
+        if (sock_fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "Failed to create ICMP datagram socket (check net.ipv4.ping_group_range)");
+        }
+    } else {
+        sock_fd_ = ::socket(AF_INET, SOCK_RAW, kIcmpProtocol);
+        if (sock_fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "Failed to create raw ICMP socket (need CAP_NET_RAW or root)");
+        }
+    }
+    ::setsockopt(sock_fd_, SOL_SOCKET, SO_RCVBUF, &kSocketReceiveBuffer, sizeof(kSocketReceiveBuffer));
+
+    // Random identifier block so concurrent pingstats/ping processes rarely overlap.
+    std::random_device rd;
+    identifier_base_ = static_cast<std::uint16_t>(rd() % (0x10000U - kIdentifierRange));
+    next_token_.store((static_cast<std::uint64_t>(rd()) << 32U) | rd());
+    if (!options_.datagram_socket) {
+        attach_reply_filter();
+    }
+    if (options_.kernel_timestamps) {
+        enable_timestamping();
+    }
+
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        close_fd(wake_fd_);
+        close_fd(epoll_fd_);
+        close_fd(sock_fd_);
+        throw std::runtime_error("Failed to create epoll/eventfd for ICMP engine");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = sock_fd_;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock_fd_, &ev);
+    ev.data.fd = wake_fd_;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    running_.store(true);
+    receiver_ = std::thread(&LinuxIcmpEngine::receive_loop, this);
+}
+
+/// Let the kernel drop everything but Echo Replies whose identifier lies in this engine's block, so
+/// unrelated ICMP traffic on the host never wakes the receiver. Replies that pass are still fully
+/// validated in handle_packet. If the filter is rejected the engine filters in user space only.
+void LinuxIcmpEngine::attach_reply_filter() {
+    const std::uint32_t first = identifier_base_;
+    const std::uint32_t end = first + kIdentifierRange;
+    sock_filter program[] = {
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                    // x = IP header length
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),                     // a = ICMP type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 0, 4), // not a reply -> drop
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),                     // a = ICMP identifier
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, 2),          // below block -> drop
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, end, 1, 0),            // past block -> drop
+        BPF_STMT(BPF_RET | BPF_K, kReceiveBufferSize),             // accept
+        BPF_STMT(BPF_RET | BPF_K, 0),                              // drop
+    };
+    sock_fprog filter{static_cast<unsigned short>(sizeof(program) / sizeof(program[0])), program};
+    ::setsockopt(sock_fd_, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter));
+}
+
+/// Prefer SO_TIMESTAMPING (RX + TX via error queue); older kernels still get RX stamps from
+/// SO_TIMESTAMPNS. If neither is accepted the engine silently keeps user-space timing.
+void LinuxIcmpEngine::enable_timestamping() {
+    const unsigned flags = kTimestampingFlags;
+    if (::setsockopt(sock_fd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) {
+        kernel_rx_enabled_ = true;
+        kernel_tx_enabled_ = true;
+        return;
+    }
+    const int enable = 1;
+    if (::setsockopt(sock_fd_, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0) {
+        kernel_rx_enabled_ = true;
+    }
+}
+
+/// Wake and join the receiver, fail outstanding probes, and close descriptors.
+void LinuxIcmpEngine::stop() {
+    if (running_.exchange(false)) {
+        wake_receiver();
+    }
+    if (receiver_.joinable()) {
+        receiver_.join();
+    }
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [_, pending] : pending_) {
+            completions.emplace_back(std::move(pending->on_complete), EchoResult{false, 0.0});
+        }
+        pending_.clear();
+        expiries_ = {};
+    }
+    run_completions(completions);
+    close_fd(wake_fd_);
+    close_fd(epoll_fd_);
+    close_fd(sock_fd_);
+}
+
+/// Hand out identifiers from the engine block, reusing released ones first. Never hands out an
+/// identifier that is still leased: two backends sharing one would complete each other's probes.
+std::uint16_t LinuxIcmpEngine::acquire_identifier() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_identifiers_.empty()) {
+        const std::uint16_t identifier = free_identifiers_.back();
+        free_identifiers_.pop_back();
+        return identifier;
+    }
+    if (next_identifier_ >= kIdentifierRange) {
+        throw std::runtime_error("All " + std::to_string(kIdentifierRange) + " ICMP identifiers are leased");
+    }
+    return static_cast<std::uint16_t>(identifier_base_ + next_identifier_++);
+}
+
+void LinuxIcmpEngine::release_identifier(std::uint16_t identifier) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_identifiers_.push_back(identifier);
+}
+
+/// Fill packet with an echo request for (identifier, sequence) and return its unregistered probe.
+std::shared_ptr<LinuxIcmpEngine::Pending> LinuxIcmpEngine::build_probe(const sockaddr_in& dest,
+                                                                       std::uint16_t identifier,
+                                                                       std::uint16_t sequence,
+                                                                       std::uint8_t* packet) {
+    auto pending = std::make_shared<Pending>();
+    pending->dest_addr = dest.sin_addr.s_addr;
+    pending->token = next_token_.fetch_add(1);
+
+    auto* hdr = reinterpret_cast<icmphdr*>(packet);
+    std::memset(packet, 0, kIcmpHeaderSize);
+    hdr->type = ICMP_ECHO;
+    hdr->code = 0;
+    hdr->un.echo.id = htons(identifier);
+    hdr->un.echo.sequence = htons(sequence);
+    std::memset(packet + kIcmpHeaderSize, 0x42, kPayloadSize);
+    std::memcpy(packet + kIcmpHeaderSize, &pending->token, kTokenSize);
+    const std::uint16_t payload_identifier = htons(identifier);
+    std::memcpy(packet + kIdentifierOffset, &payload_identifier, sizeof(payload_identifier));
+    hdr->checksum = 0;
+    hdr->checksum = icmp_checksum(packet, kPacketSize);
+    return pending;
+}
+
+/// Stamp the send time and publish the probe; caller holds mutex_.
+bool LinuxIcmpEngine::register_probe(std::uint32_t key, const std::shared_ptr<Pending>& pending,
+                                     std::chrono::milliseconds timeout, std::vector<Completion>& completions) {
+    if (kernel_rx_enabled_) {
+        pending->user_tx_ns = realtime_now_ns();
+    }
+    pending->sent_at = std::chrono::steady_clock::now();
+    auto& slot = pending_[key];
+    if (slot) {
+        // The sequence wrapped while the older probe was still out; it can no longer be matched.
+        completions.emplace_back(std::move(slot->on_complete), EchoResult{false, 0.0});
+    }
+    slot = pending;
+
+    const Expiry expiry{pending->sent_at + timeout, key, pending->token};
+    const bool earliest = expiries_.empty() || expiry.deadline < expiries_.top().deadline;
+    expiries_.push(expiry);
+    return earliest;
+}
+
+bool LinuxIcmpEngine::cancel_probe(std::uint32_t key, const std::shared_ptr<Pending>& pending) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(key);
+    if (it == pending_.end() || it->second != pending) {
+        return false;
+    }
+    pending_.erase(it);
+    return true;
+}
+
+void LinuxIcmpEngine::wake_receiver() {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const auto written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+/// Block until the socket accepts more data; false once deadline passes first or poll fails.
+bool LinuxIcmpEngine::wait_writable(std::chrono::steady_clock::time_point deadline) const {
+    for (;;) {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        pollfd pfd{sock_fd_, POLLOUT, 0};
+        const int ready =
+            ::poll(&pfd, 1, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count()));
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+/// Pop overdue heap entries; entries whose probe already completed are simply discarded.
+void LinuxIcmpEngine::expire_probes(std::chrono::steady_clock::time_point now, std::vector<Completion>& completions) {
+    while (!expiries_.empty() && expiries_.top().deadline <= now) {
+        const Expiry expiry = expiries_.top();
+        expiries_.pop();
+        auto it = pending_.find(expiry.key);
+        if (it != pending_.end() && it->second->token == expiry.token) {
+            completions.emplace_back(std::move(it->second->on_complete), EchoResult{false, 0.0});
+            pending_.erase(it);
+        }
+    }
+}
+
+/// Round up so the receiver never wakes just before a deadline and spins.
+int LinuxIcmpEngine::next_expiry_timeout() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (expiries_.empty()) {
+        return -1;
+    }
+    const auto remaining = expiries_.top().deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void LinuxIcmpEngine::run_completions(std::vector<Completion>& completions) {
+    for (auto& [on_complete, result] : completions) {
+        if (on_complete) {
+            on_complete(result);
+        }
+    }
+    completions.clear();
+}
+
+/// Register the probe before sending so a fast reply cannot race the bookkeeping.
+void LinuxIcmpEngine::echo_async(const sockaddr_in& dest, std::uint16_t identifier, std::uint16_t sequence,
+                                 std::chrono::milliseconds timeout, EchoCallback on_complete) {
+    if (!running_.load()) {
+        throw std::runtime_error("LinuxIcmpEngine not started");
+    }
+
+    std::uint8_t packet[kPacketSize];
+    auto pending = build_probe(dest, identifier, sequence, packet);
+    pending->on_complete = std::move(on_complete);
+    const std::uint32_t key = make_key(identifier, sequence);
+    std::vector<Completion> displaced;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake = register_probe(key, pending, timeout, displaced);
+    }
+    run_completions(displaced);
+    if (wake) {
+        wake_receiver();
+    }
+
+    const auto sent = ::sendto(sock_fd_, packet, kPacketSize, 0,
+                               reinterpret_cast<const sockaddr*>(&dest), sizeof(dest));
+    if ((sent < 0 || static_cast<std::size_t>(sent) != kPacketSize) && cancel_probe(key, pending)) {
+        throw std::runtime_error("sendto failed");
+    }
+}
+
+/// The promise is shared with the callback so it outlives a set_value racing our wake-up.
+LinuxIcmpEngine::EchoResult LinuxIcmpEngine::echo(const sockaddr_in& dest, std::uint16_t identifier,
+                                                  std::uint16_t sequence, std::chrono::milliseconds timeout) {
+    auto promise = std::make_shared<std::promise<EchoResult>>();
+    auto future = promise->get_future();
+    echo_async(dest, identifier, sequence, timeout,
+               [promise](const EchoResult& result) { promise->set_value(result); });
+    return future.get();
+}
+
+/// Push the probes out with sendmmsg in chunks of kSendBatch, registering each chunk under one lock
+/// just before it is sent, then wait until all have completed. EINTR and EAGAIN are retried; probes
+/// the kernel still refuses fail immediately.
+std::vector<LinuxIcmpEngine::EchoResult> LinuxIcmpEngine::echo_batch(const std::vector<EchoRequest>& requests,
+                                                                     std::chrono::milliseconds timeout) {
+    if (!running_.load()) {
+        throw std::runtime_error("LinuxIcmpEngine not started");
+    }
+
+    struct BatchState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::size_t remaining{0};
+        std::vector<EchoResult> results;
+    };
+    const std::size_t count = requests.size();
+    auto state = std::make_shared<BatchState>();
+    state->remaining = count;
+    state->results.assign(count, EchoResult{false, 0.0});
+
+    std::vector<std::uint8_t> packets(count * kPacketSize);
+    std::vector<std::shared_ptr<Pending>> pendings(count);
+    std::vector<std::uint32_t> keys(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto& request = requests[i];
+        pendings[i] = build_probe(request.dest, request.identifier, request.sequence, &packets[i * kPacketSize]);
+        pendings[i]->on_complete = [state, i](const EchoResult& result) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->results[i] = result;
+            if (--state->remaining == 0) {
+                state->cv.notify_all();
+            }
+        };
+        keys[i] = make_key(request.identifier, request.sequence);
+    }
+    // Each chunk is registered, and so timestamped, right before its own sendmmsg; stamping the
+    // whole batch up front would charge later chunks with the send time of earlier ones.
+    std::vector<Completion> completions;
+    std::size_t registered = 0;
+    std::size_t sent_count = 0;
+    iovec iovs[kSendBatch];
+    mmsghdr msgs[kSendBatch];
+    while (sent_count < count) {
+        const std::size_t chunk = std::min(count - sent_count, kSendBatch);
+        bool wake = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t i = sent_count; i < sent_count + chunk; ++i) {
+                wake = register_probe(keys[i], pendings[i], timeout, completions) || wake;
+            }
+        }
+        registered = sent_count + chunk;
+        run_completions(completions);
+        if (wake) {
+            wake_receiver();
+        }
+
+        const auto give_up_at = pendings[sent_count]->sent_at + timeout;
+        std::size_t chunk_sent = 0;
+        while (chunk_sent < chunk) {
+            const std::size_t first = sent_count + chunk_sent;
+            const std::size_t left = chunk - chunk_sent;
+            for (std::size_t i = 0; i < left; ++i) {
+                const std::size_t index = first + i;
+                iovs[i] = iovec{&packets[index * kPacketSize], kPacketSize};
+                msgs[i] = mmsghdr{};
+                msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&requests[index].dest);
+                msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            const int sent = ::sendmmsg(sock_fd_, msgs, static_cast<unsigned>(left), 0);
+            if (sent > 0) {
+                chunk_sent += static_cast<std::size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(give_up_at)) {
+                continue;
+            }
+            break; // hard error, or the send buffer stayed full until these probes would time out
+        }
+        sent_count += chunk_sent;
+        if (chunk_sent < chunk) {
+            break; // the rest of the batch is failed below
+        }
+    }
+    for (std::size_t i = sent_count; i < count; ++i) {
+        // Probes of later chunks were never registered, so only the current chunk needs cancelling.
+        if (i >= registered || cancel_probe(keys[i], pendings[i])) {
+            pendings[i]->on_complete(EchoResult{false, 0.0});
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->remaining == 0; });
+    return std::move(state->results);
+}
+
+/// Single receive thread for all targets; exits when stop() signals the eventfd.
+void LinuxIcmpEngine::receive_loop() {
+    epoll_event events[kMaxEpollEvents];
+    std::vector<Completion> completions;
+    while (running_.load()) {
+        const int n = ::epoll_wait(epoll_fd_, events, kMaxEpollEvents, next_expiry_timeout());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == sock_fd_) {
+                // EPOLLERR signals queued TX timestamps; drain_socket picks them up first.
+                drain_socket();
+            } else if (events[i].data.fd == wake_fd_) {
+                std::uint64_t count = 0;
+                [[maybe_unused]] const auto consumed = ::read(wake_fd_, &count, sizeof(count));
+            }
+        }
+        // Replies drained above win over a deadline that passed in the same wakeup.
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            expire_probes(std::chrono::steady_clock::now(), completions);
+        }
+        run_completions(completions);
+    }
+}
+
+/// Read until the socket would block so one wakeup serves a burst of replies; recvmmsg pulls up
+/// to kReceiveBatch datagrams per syscall.
+void LinuxIcmpEngine::drain_socket() {
+    // TX stamps are queued before the reply can arrive; reading them first lets the reply use them.
+    if (kernel_tx_enabled_) {
+        drain_error_queue();
+    }
+
+    std::uint8_t recv_bufs[kReceiveBatch][kReceiveBufferSize];
+    alignas(cmsghdr) char controls[kReceiveBatch][kControlBufferSize];
+    sockaddr_in recv_addrs[kReceiveBatch];
+    iovec iovs[kReceiveBatch];
+    mmsghdr msgs[kReceiveBatch];
+    while (true) {
+        for (std::size_t i = 0; i < kReceiveBatch; ++i) {
+            iovs[i] = iovec{recv_bufs[i], kReceiveBufferSize};
+            msgs[i] = mmsghdr{};
+            msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls[i];
+            msgs[i].msg_hdr.msg_controllen = kernel_rx_enabled_ ? kControlBufferSize : 0;
+        }
+        const int received = ::recvmmsg(sock_fd_, msgs, kReceiveBatch, MSG_DONTWAIT, nullptr);
+        const auto received_at = std::chrono::steady_clock::now();
+        if (received <= 0) {
+            return; // EAGAIN or error: wait for the next readiness event
+        }
+        for (int i = 0; i < received; ++i) {
+            const Timestamps stamps = kernel_rx_enabled_ ? parse_timestamps(msgs[i].msg_hdr) : Timestamps{};
+            handle_packet(recv_bufs[i], msgs[i].msg_len, recv_addrs[i], received_at, stamps);
+        }
+        if (static_cast<std::size_t>(received) < kReceiveBatch) {
+            return; // socket drained
+        }
+    }
+}
+
+/// Attach looped-back TX timestamps to the pending probe they belong to.
+void LinuxIcmpEngine::drain_error_queue() {
+    std::uint8_t err_buf[kReceiveBufferSize];
+    alignas(cmsghdr) char control[kControlBufferSize];
+    while (true) {
+        iovec iov{err_buf, sizeof(err_buf)};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        const auto len = ::recvmsg(sock_fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (len <= 0) {
+            return;
+        }
+        const Timestamps stamps = parse_timestamps(msg);
+
+        // The looped frame carries link-layer and IP headers of device-dependent size; our echo
+        // request is always its last kPacketSize bytes.
+        if (static_cast<std::size_t>(len) < kPacketSize) {
+            continue;
+        }
+        const std::size_t offset = static_cast<std::size_t>(len) - kPacketSize;
+        const std::uint8_t* icmp = err_buf + offset;
+        const auto* icmp_hdr = reinterpret_cast<const icmphdr*>(icmp);
+        if (icmp_hdr->type != ICMP_ECHO) {
+            continue;
+        }
+        std::uint64_t token = 0;
+        std::memcpy(&token, icmp + kIcmpHeaderSize, kTokenSize);
+        const std::uint32_t key = make_key(probe_identifier(icmp), ntohs(icmp_hdr->un.echo.sequence));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_.find(key);
+        if (it != pending_.end() && it->second->token == token) {
+            it->second->kernel_tx_ns = stamps.software_ns;
+            it->second->hardware_tx_ns = stamps.hardware_ns;
+        }
+    }
+}
+
+/// The kernel replaces the header identifier of datagram-socket echoes with the socket's port, so
+/// only the payload copy identifies the backend there.
+std::uint16_t LinuxIcmpEngine::probe_identifier(const std::uint8_t* icmp) const {
+    if (options_.datagram_socket) {
+        std::uint16_t identifier = 0;
+        std::memcpy(&identifier, icmp + kIdentifierOffset, sizeof(identifier));
+        return ntohs(identifier);
+    }
+    return ntohs(reinterpret_cast<const icmphdr*>(icmp)->un.echo.id);
+}
+
+/// Read software (ts[0]) and raw hardware (ts[2]) stamps, or the SO_TIMESTAMPNS fallback.
+LinuxIcmpEngine::Timestamps LinuxIcmpEngine::parse_timestamps(msghdr& msg) {
+    Timestamps stamps;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            scm_timestamping ts{};
+            std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            stamps.software_ns = to_ns(ts.ts[0]);
+            stamps.hardware_ns = to_ns(ts.ts[2]);
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts{};
+            std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            stamps.software_ns = to_ns(ts);
+        }
+    }
+    return stamps;
+}
+
+/// Complete the probe whose (identifier, sequence, destination, token) the reply echoes back.
+/// Anything else - foreign identifiers, late replies to timed-out probes, spoofed sources - is dropped
+/// and the probe stays pending until its deadline. The callback runs after mutex_ is released.
+void LinuxIcmpEngine::handle_packet(const std::uint8_t* data, std::size_t len, const sockaddr_in& source,
+                                    std::chrono::steady_clock::time_point received_at, const Timestamps& stamps) {
+    // Raw sockets deliver the IP header; datagram sockets start at the ICMP header.
+    std::size_t ip_header_len = 0;
+    if (!options_.datagram_socket) {
+        if (len < sizeof(iphdr)) {
+            return;
+        }
+        const auto* ip_hdr = reinterpret_cast<const iphdr*>(data);
+        ip_header_len = static_cast<std::size_t>(ip_hdr->ihl * 4);
+    }
+    if (ip_header_len + kMatchSize > len) {
+        return;
+    }
+    const std::uint8_t* icmp = data + ip_header_len;
+    const auto* icmp_hdr = reinterpret_cast<const icmphdr*>(icmp);
+    if (icmp_hdr->type != ICMP_ECHOREPLY || icmp_hdr->code != 0) {
+        return;
+    }
+
+    std::uint64_t token = 0;
+    std::memcpy(&token, icmp + kIcmpHeaderSize, kTokenSize);
+    const std::uint32_t key = make_key(probe_identifier(icmp), ntohs(icmp_hdr->un.echo.sequence));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = pending_.find(key);
+    if (it == pending_.end()) {
+        return; // not ours, or a late reply for a probe that already timed out
+    }
+    auto& pending = *it->second;
+    if (pending.dest_addr != source.sin_addr.s_addr || pending.token != token) {
+        return; // stale reply from an earlier probe that reused this sequence, or wrong peer
+    }
+
+    // Use the most precise pair of clocks available; both ends of a pair share one time base.
+    constexpr double kNsPerMs = 1'000'000.0;
+    EchoResult result{true, std::chrono::duration<double, std::milli>(received_at - pending.sent_at).count()};
+    if (stamps.hardware_ns > 0 && pending.hardware_tx_ns > 0 && stamps.hardware_ns >= pending.hardware_tx_ns) {
+        result.rtt_ms = static_cast<double>(stamps.hardware_ns - pending.hardware_tx_ns) / kNsPerMs;
+        result.clock_source = PlatformPingBackend::ClockSource::Hardware;
+    } else if (stamps.software_ns > 0 && pending.kernel_tx_ns > 0 && stamps.software_ns >= pending.kernel_tx_ns) {
+        result.rtt_ms = static_cast<double>(stamps.software_ns - pending.kernel_tx_ns) / kNsPerMs;
+        result.clock_source = PlatformPingBackend::ClockSource::KernelTxRx;
+    } else if (stamps.software_ns > 0 && pending.user_tx_ns > 0 && stamps.software_ns >= pending.user_tx_ns) {
+        result.rtt_ms = static_cast<double>(stamps.software_ns - pending.user_tx_ns) / kNsPerMs;
+        result.clock_source = PlatformPingBackend::ClockSource::KernelRx;
+    }
+    EchoCallback on_complete = std::move(pending.on_complete);
+    pending_.erase(it);
+    lock.unlock();
+    if (on_complete) {
+        on_complete(result);
+    }
+}
+
+} // namespace pingstats
@@ -0,0 +1,105 @@
+#include "log_linear_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace pingstats {
+
+/// Layout as in HdrHistogram: sub_bucket_count is the power of two covering 2 * 10^digits, so the
+/// linear half of every bucket resolves one part in 10^digits; buckets double until the
+/// highest trackable value fits.
+LogLinearHistogram::LogLinearHistogram(std::uint64_t lowest_discernible,
+                                       std::uint64_t highest_trackable,
+                                       int significant_digits)
+    : lowest_discernible_(lowest_discernible),
+      highest_trackable_(highest_trackable),
+      significant_digits_(significant_digits)
+{
+    if (lowest_discernible < 1) {
+        throw std::invalid_argument("LogLinearHistogram lowest value must be >= 1");
+    }
+    if (highest_trackable < 2 * lowest_discernible) {
+        throw std::invalid_argument("LogLinearHistogram highest value must be >= 2 * lowest value");
+    }
+    if (significant_digits < 1 || significant_digits > 5) {
+        throw std::invalid_argument("LogLinearHistogram significant digits must be in 1..5");
+    }
+
+    const auto largest_single_unit = static_cast<std::uint64_t>(2 * std::pow(10.0, significant_digits));
+    const int sub_bucket_count_magnitude = std::bit_width(largest_single_unit - 1);
+    sub_bucket_half_count_magnitude_ = std::max(sub_bucket_count_magnitude, 1) - 1;
+    unit_magnitude_ = std::bit_width(lowest_discernible) - 1;
+    if (unit_magnitude_ + sub_bucket_half_count_magnitude_ + 1 > 62) {
+        throw std::invalid_argument("LogLinearHistogram range and precision exceed 64-bit values");
+    }
+
+    const std::uint64_t sub_bucket_count = std::uint64_t{1} << (sub_bucket_half_count_magnitude_ + 1);
+    sub_bucket_half_count_ = static_cast<std::size_t>(sub_bucket_count / 2);
+    sub_bucket_mask_ = (sub_bucket_count - 1) << unit_magnitude_;
+
+    int bucket_count = 1;
+    std::uint64_t smallest_untrackable = sub_bucket_count << unit_magnitude_;
+    while (smallest_untrackable <= highest_trackable) {
+        if (smallest_untrackable > (UINT64_MAX >> 1)) {
+            ++bucket_count;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        ++bucket_count;
+    }
+    counts_.assign(static_cast<std::size_t>(bucket_count + 1) * sub_bucket_half_count_, 0);
+}
+
+void LogLinearHistogram::merge(const LogLinearHistogram& other)
+{
+    if (!same_layout(other)) {
+        throw std::invalid_argument("Cannot merge LogLinearHistogram instances with different layouts");
+    }
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+}
+
+void LogLinearHistogram::clear()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+}
+
+bool LogLinearHistogram::same_layout(const LogLinearHistogram& other) const
+{
+    return lowest_discernible_ == other.lowest_discernible_ && highest_trackable_ == other.highest_trackable_ &&
+           significant_digits_ == other.significant_digits_;
+}
+
+/// Slots below sub_bucket_half_count_ belong to bucket 0's lower half, which has no bucket of
+/// its own in the counts layout.
+void LogLinearHistogram::split_index(std::size_t index, int& bucket_index, std::uint64_t& sub_bucket_index) const
+{
+    bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    sub_bucket_index = (index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket_index < 0) {
+        sub_bucket_index -= sub_bucket_half_count_;
+        bucket_index = 0;
+    }
+}
+
+std::uint64_t LogLinearHistogram::lowest_equivalent(std::size_t index) const
+{
+    int bucket_index = 0;
+    std::uint64_t sub_bucket_index = 0;
+    split_index(index, bucket_index, sub_bucket_index);
+    return sub_bucket_index << (bucket_index + unit_magnitude_);
+}
+
+std::uint64_t LogLinearHistogram::next_non_equivalent(std::size_t index) const
+{
+    int bucket_index = 0;
+    std::uint64_t sub_bucket_index = 0;
+    split_index(index, bucket_index, sub_bucket_index);
+    return (sub_bucket_index + 1) << (bucket_index + unit_magnitude_);
+}
+
+}  // namespace pingstats
@@ -1,5 +1,8 @@
 #include <chrono>
+#include <cstdint>
 #include <exception>
+#include <filesystem>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -10,12 +13,18 @@
 #include <utility>
 #include <vector>
 
+#include "bucket_boundaries.hpp"
 #include "config.hpp"
 #include "console_view_impl.hpp"
 #include "csv_exporter.hpp"
 #include "json_exporter.hpp"
+#include "metrics_server.hpp"
+#include "ping_scheduler.hpp"
 #include "ping_session.hpp"
+#include "probe_history.hpp"
 #include "platform_ping_backend_factory.hpp"
+#include "raw_sample_log.hpp"
+#include "sample_ingestor.hpp"
 #include "statistics_aggregator_impl.hpp"
 
 namespace pingstats {
@@ -30,12 +39,27 @@ constexpr auto kDefaultRenderPeriod = std::chrono::milliseconds{500};
 constexpr std::string_view kVersion = "0.1.0";
 /// Period for periodic CSV export when enabled.
 constexpr auto kDefaultExportPeriod = std::chrono::seconds{5};
+/// Bucket defaults shipped next to the executable; used unless overridden.
+constexpr std::string_view kDefaultBucketFile = "config/buckets_default.json";
 
 /// Parsed command-line options, kept optional until defaults are applied.
 struct CliOptions {
     std::optional<double> interval_s;
     std::optional<OutputFormat> output_format;
     std::optional<std::string> output_file;
+    std::optional<std::size_t> worker_threads;
+    std::optional<std::chrono::seconds> resolve_ttl;
+    bool kernel_timestamps{false};
+    bool ingest_queue{false};
+    std::optional<IcmpSocketMode> icmp_socket_mode;
+    std::optional<HistogramMode> histogram_mode;
+    std::optional<int> histogram_digits;
+    std::optional<std::vector<double>> bucket_boundaries;
+    std::optional<std::string> config_file;
+    std::optional<std::string> raw_log;
+    std::optional<std::string> history_dir;
+    std::optional<MetricsListenAddress> metrics_listen;
+    CsvRotationPolicy csv_rotation;
     std::vector<std::string> hosts;
     bool show_help{false};
     bool show_version{false};
@@ -56,8 +80,38 @@ void print_usage(std::ostream& os, const char* prog_name) {
        << "  --version                Show version and exit\n"
        << "  -i, --interval <sec>     Ping interval in seconds (default: "
        << kDefaultIntervalSeconds << ")\n"
-       << "  --output-format <fmt>    Output format for export: none|csv|json\n"
-       << "  --output-file <path>     Path to export aggregated statistics\n";
+       << "  --output-format <fmt>    Output format for export: none|csv|json|ndjson (json\n"
+       << "                           is replaced atomically, ndjson appends a line per host)\n"
+       << "  --output-file <path>     Path to export aggregated statistics\n"
+       << "  --workers <n>            Drive all targets from a pool of n scheduler threads\n"
+       << "                           (default: one thread per target)\n"
+       << "  --resolve-ttl <sec>      Cache host name resolutions for sec seconds; 0 resolves\n"
+       << "                           once at startup (default: 300)\n"
+       << "  --kernel-timestamps      Measure RTT with kernel/NIC timestamps where supported\n"
+       << "  --ingest-queue           Queue samples lock-free to one aggregation thread instead\n"
+       << "                           of updating statistics on the probing threads\n"
+       << "  --icmp-socket <kind>     ICMP socket on Linux: auto|raw|dgram (default: auto,\n"
+       << "                           unprivileged dgram with raw fallback)\n"
+       << "  --histogram <mode>       RTT histogram: fixed|log-linear (default: fixed)\n"
+       << "  --histogram-digits <n>   Significant digits for log-linear histograms, 1-5\n"
+       << "                           (default: 2; range 10us-60s)\n"
+       << "  --bucket-boundaries <b>  Fixed histogram boundaries in ms: comma list (e.g.\n"
+       << "                           1,5,10,50) or preset fine|log|coarse; max "
+       << kMaxBucketBoundaries << "\n"
+       << "  --config-file <path>     Bucket defaults file (default: " << kDefaultBucketFile << "\n"
+       << "                           next to the executable)\n"
+       << "  --raw-log <path>         Append every probe to a memory-mapped binary log (created\n"
+       << "                           if missing; see docs for the record layout)\n"
+       << "  --history-dir <dir>      Keep a compressed per-host probe history (one file per\n"
+       << "                           host, a few bytes per probe) in dir\n"
+       << "  --metrics-listen <[addr:]port>\n"
+       << "                           Serve OpenMetrics at http://addr:port/metrics (addr\n"
+       << "                           defaults to 127.0.0.1; use :port for all interfaces)\n"
+       << "  --csv-rotate-size <MiB>  Start a new CSV file (old ones kept as <file>.1 ..\n"
+       << "                           <file>." << CsvRotationPolicy{}.keep_files << ") once it would exceed MiB\n"
+       << "  --csv-rotate-interval <sec>\n"
+       << "                           Start a new CSV file every sec seconds\n"
+       << "Bucket precedence: --bucket-boundaries, then the bucket file, then 10,20,50,100,200,500.\n";
 }
 
 /// Map a string to the OutputFormat enum, rejecting unknown inputs early.
@@ -71,9 +125,73 @@ OutputFormat parse_output_format(const std::string& value) {
     if (value == "json") {
         return OutputFormat::Json;
     }
+    if (value == "ndjson") {
+        return OutputFormat::Ndjson;
+    }
     throw_cli_error("Unknown output format: " + value);
 }
 
+/// Map a string to the IcmpSocketMode enum, rejecting unknown inputs early.
+IcmpSocketMode parse_icmp_socket_mode(const std::string& value) {
+    if (value == "auto") {
+        return IcmpSocketMode::Auto;
+    }
+    if (value == "raw") {
+        return IcmpSocketMode::Raw;
+    }
+    if (value == "dgram") {
+        return IcmpSocketMode::Datagram;
+    }
+    throw_cli_error("Unknown ICMP socket kind: " + value);
+}
+
+/// Map a string to the HistogramMode enum, rejecting unknown inputs early.
+HistogramMode parse_histogram_mode(const std::string& value) {
+    if (value == "fixed") {
+        return HistogramMode::Fixed;
+    }
+    if (value == "log-linear") {
+        return HistogramMode::LogLinear;
+    }
+    throw_cli_error("Unknown histogram mode: " + value);
+}
+
+/// Directory of the running executable: /proc/self/exe where available, else argv[0] made
+/// canonical, else argv[0] as given. argv[0] alone breaks for PATH lookups and symlinks.
+std::filesystem::path executable_dir(const char* prog_path) {
+    std::error_code ec;
+    auto exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (ec) {
+        exe = std::filesystem::canonical(prog_path, ec);
+    }
+    if (ec) {
+        exe = prog_path;
+    }
+    return exe.parent_path();
+}
+
+/// Pick histogram boundaries by precedence: --bucket-boundaries, the bucket file, the built-in set.
+/// An explicit --config-file must load; the default file only warns when missing or invalid.
+std::vector<double> resolve_bucket_boundaries(const CliOptions& opts, const char* prog_path) {
+    if (opts.bucket_boundaries) {
+        return *opts.bucket_boundaries;
+    }
+    if (opts.config_file) {
+        try {
+            return load_bucket_boundaries_file(*opts.config_file);
+        } catch (const std::exception& ex) {
+            throw_cli_error(ex.what());
+        }
+    }
+    const auto default_file = executable_dir(prog_path) / kDefaultBucketFile;
+    try {
+        return load_bucket_boundaries_file(default_file.string());
+    } catch (const std::exception& ex) {
+        std::cerr << "Warning: " << ex.what() << "; using built-in bucket boundaries" << std::endl;
+        return default_bucket_boundaries();
+    }
+}
+
 /// Parse all CLI arguments into structured options; stops early for help/version.
 CliOptions parse_arguments(int argc, char** argv) {
     CliOptions opts;
@@ -117,6 +235,146 @@ CliOptions parse_arguments(int argc, char** argv) {
             opts.output_file = std::string{argv[++i]};
             continue;
         }
+        if (arg == "--workers") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for workers");
+            }
+            const std::string val{argv[++i]};
+            int workers = 0;
+            try {
+                workers = std::stoi(val);
+            } catch (const std::exception&) {
+                throw_cli_error("Invalid workers value: " + val);
+            }
+            if (workers <= 0) {
+                throw_cli_error("Workers must be > 0");
+            }
+            opts.worker_threads = static_cast<std::size_t>(workers);
+            continue;
+        }
+        if (arg == "--resolve-ttl") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for resolve-ttl");
+            }
+            const std::string val{argv[++i]};
+            int ttl = 0;
+            try {
+                ttl = std::stoi(val);
+            } catch (const std::exception&) {
+                throw_cli_error("Invalid resolve-ttl value: " + val);
+            }
+            if (ttl < 0) {
+                throw_cli_error("Resolve TTL must be >= 0");
+            }
+            opts.resolve_ttl = std::chrono::seconds{ttl};
+            continue;
+        }
+        if (arg == "--ingest-queue") {
+            opts.ingest_queue = true;
+            continue;
+        }
+        if (arg == "--kernel-timestamps") {
+            opts.kernel_timestamps = true;
+            continue;
+        }
+        if (arg == "--icmp-socket") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for icmp-socket");
+            }
+            const std::string val{argv[++i]};
+            opts.icmp_socket_mode = parse_icmp_socket_mode(val);
+            continue;
+        }
+        if (arg == "--histogram") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for histogram");
+            }
+            const std::string val{argv[++i]};
+            opts.histogram_mode = parse_histogram_mode(val);
+            continue;
+        }
+        if (arg == "--bucket-boundaries") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for bucket-boundaries");
+            }
+            const std::string val{argv[++i]};
+            try {
+                opts.bucket_boundaries = parse_bucket_boundaries(val);
+            } catch (const std::invalid_argument& ex) {
+                throw_cli_error(ex.what());
+            }
+            continue;
+        }
+        if (arg == "--config-file") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for config-file");
+            }
+            opts.config_file = std::string{argv[++i]};
+            continue;
+        }
+        if (arg == "--raw-log") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for raw-log");
+            }
+            opts.raw_log = std::string{argv[++i]};
+            continue;
+        }
+        if (arg == "--csv-rotate-size" || arg == "--csv-rotate-interval") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for " + arg.substr(2));
+            }
+            const std::string val{argv[++i]};
+            long long amount = 0;
+            try {
+                amount = std::stoll(val);
+            } catch (const std::exception&) {
+                throw_cli_error("Invalid " + arg.substr(2) + " value: " + val);
+            }
+            if (amount <= 0) {
+                throw_cli_error(arg.substr(2) + " must be > 0");
+            }
+            if (arg == "--csv-rotate-size") {
+                opts.csv_rotation.max_bytes = static_cast<std::uint64_t>(amount) * 1024U * 1024U;
+            } else {
+                opts.csv_rotation.max_age = std::chrono::seconds{amount};
+            }
+            continue;
+        }
+        if (arg == "--metrics-listen") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for metrics-listen");
+            }
+            try {
+                opts.metrics_listen = parse_metrics_listen_address(argv[++i]);
+            } catch (const std::invalid_argument& ex) {
+                throw_cli_error(ex.what());
+            }
+            continue;
+        }
+        if (arg == "--history-dir") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for history-dir");
+            }
+            opts.history_dir = std::string{argv[++i]};
+            continue;
+        }
+        if (arg == "--histogram-digits") {
+            if (i + 1 >= argc) {
+                throw_cli_error("Missing value for histogram-digits");
+            }
+            const std::string val{argv[++i]};
+            int digits = 0;
+            try {
+                digits = std::stoi(val);
+            } catch (const std::exception&) {
+                throw_cli_error("Invalid histogram-digits value: " + val);
+            }
+            if (digits < 1 || digits > 5) {
+                throw_cli_error("Histogram digits must be between 1 and 5");
+            }
+            opts.histogram_digits = digits;
+            continue;
+        }
 
         // Positional argument = host
         if (!arg.empty() && arg.front() == '-') {
@@ -133,16 +391,51 @@ struct SessionBundle {
     std::unique_ptr<PingSession> session;
 };
 
-/// Lightweight background loop that persists CSV snapshots periodically.
-class CsvExporterLoop {
+/// Persists one row set of snapshots; throws on I/O errors.
+using SnapshotExporter = std::function<void(const std::vector<StatisticsSnapshot>&)>;
+
+/// Exporter for the selected format, bound to one long-lived writer so a tick costs a single
+/// write: CSV and NDJSON append, JSON atomically replaces the document. Empty for None.
+SnapshotExporter make_snapshot_exporter(OutputFormat format, const CliOptions& opts) {
+    switch (format) {
+    case OutputFormat::Csv: {
+        auto writer = std::make_shared<CsvSnapshotWriter>(opts.output_file.value_or("pingstats.csv"),
+                                                          opts.csv_rotation);
+        return [writer](const std::vector<StatisticsSnapshot>& snapshots) { writer->append(snapshots); };
+    }
+    case OutputFormat::Json: {
+        auto writer = std::make_shared<JsonSnapshotWriter>(opts.output_file.value_or("pingstats.json"));
+        return [writer](const std::vector<StatisticsSnapshot>& snapshots) { writer->write(snapshots); };
+    }
+    case OutputFormat::Ndjson: {
+        auto writer = std::make_shared<NdjsonSnapshotWriter>(opts.output_file.value_or("pingstats.ndjson"));
+        return [writer](const std::vector<StatisticsSnapshot>& snapshots) { writer->append(snapshots); };
+    }
+    case OutputFormat::None:
+        break;
+    }
+    return {};
+}
+
+/// Lightweight background loop that exports the published snapshots periodically and flushes the
+/// sample sink on the same tick, so raw logs and history files keep up with the exported rows.
+/// Either part may be absent.
+class SnapshotExporterLoop {
 public:
-    CsvExporterLoop(std::shared_ptr<StatisticsAggregator> aggregator,
-                    std::string path,
-                    std::chrono::milliseconds period)
-        : aggregator_(std::move(aggregator)), path_(std::move(path)), period_(period)
+    SnapshotExporterLoop(std::shared_ptr<StatisticsAggregator> aggregator,
+                         SnapshotExporter exporter,
+                         std::shared_ptr<SampleSink> sample_sink,
+                         std::chrono::milliseconds period)
+        : aggregator_(std::move(aggregator)),
+          exporter_(std::move(exporter)),
+          sample_sink_(std::move(sample_sink)),
+          period_(period)
     {
     }
 
+    /// True when there is anything to do on a tick.
+    [[nodiscard]] bool enabled() const { return exporter_ || sample_sink_; }
+
     /// Start exporting if not already running; idempotent to avoid duplicate threads.
     void start()
     {
@@ -152,11 +445,16 @@ public:
         running_ = true;
         worker_ = std::thread([this]() {
             while (running_) {
-                auto snaps = aggregator_->snapshot_all();
-                try {
-                    write_snapshots_csv_append(path_, snaps);
-                } catch (const std::exception& ex) {
-                    std::cerr << "CSV export error: " << ex.what() << std::endl;
+                if (exporter_) {
+                    const auto published = aggregator_->published_snapshots();
+                    try {
+                        exporter_(published->hosts);
+                    } catch (const std::exception& ex) {
+                        std::cerr << "Export error: " << ex.what() << std::endl;
+                    }
+                }
+                if (sample_sink_) {
+                    sample_sink_->flush();
                 }
                 std::this_thread::sleep_for(period_);
             }
@@ -172,11 +470,20 @@ public:
         }
     }
 
-    ~CsvExporterLoop() { stop(); }
+    /// Export one row set outside the loop, e.g. the final export; only valid while stopped.
+    void write(const std::vector<StatisticsSnapshot>& snapshots)
+    {
+        if (exporter_) {
+            exporter_(snapshots);
+        }
+    }
+
+    ~SnapshotExporterLoop() { stop(); }
 
 private:
     std::shared_ptr<StatisticsAggregator> aggregator_;
-    std::string path_;
+    SnapshotExporter exporter_;
+    std::shared_ptr<SampleSink> sample_sink_;
     std::chrono::milliseconds period_;
     std::atomic<bool> running_{false};
     std::thread worker_;
@@ -211,6 +518,8 @@ int run(int argc, char** argv) {
             effective_format = OutputFormat::Csv;
         }
 
+        const auto bucket_boundaries = resolve_bucket_boundaries(opts, argv[0]);
+
         // Build target configs
         std::vector<TargetConfig> targets;
         targets.reserve(opts.hosts.size());
@@ -224,24 +533,79 @@ int run(int argc, char** argv) {
             if (opts.output_file) {
                 cfg.output_file = opts.output_file;
             }
+            cfg.bucket_boundaries = bucket_boundaries;
             targets.push_back(std::move(cfg));
         }
 
-        auto aggregator = make_statistics_aggregator();
+        AggregatorConfig aggregator_config;
+        aggregator_config.bucket_boundaries = bucket_boundaries;
+        if (opts.histogram_mode) {
+            aggregator_config.histogram_mode = *opts.histogram_mode;
+        }
+        if (opts.histogram_digits) {
+            aggregator_config.log_linear_significant_digits = *opts.histogram_digits;
+        }
+        auto aggregator = make_statistics_aggregator(aggregator_config);
+
+        // Optional shared scheduler; without it every session runs its own thread.
+        std::shared_ptr<PingScheduler> scheduler;
+        if (opts.worker_threads) {
+            scheduler = std::make_shared<PingScheduler>(*opts.worker_threads);
+        }
+
+        // Optional ingest thread; without it probing threads write to the aggregator directly.
+        std::shared_ptr<SampleIngestor> ingestor;
+        if (opts.ingest_queue) {
+            ingestor = std::make_shared<SampleIngestor>(aggregator);
+            ingestor->start();
+        }
+
+        // Optional raw sample log and probe history; receive every probe besides the aggregator.
+        std::vector<std::shared_ptr<SampleSink>> sinks;
+        if (opts.raw_log) {
+            sinks.push_back(std::make_shared<RawSampleLog>(*opts.raw_log));
+        }
+        if (opts.history_dir) {
+            sinks.push_back(std::make_shared<ProbeHistoryStore>(*opts.history_dir));
+        }
+        auto sample_sink = make_sample_sink_fanout(std::move(sinks));
+
+        auto exporter = make_snapshot_exporter(effective_format.value_or(OutputFormat::None), opts);
+        SnapshotExporterLoop export_loop{aggregator, std::move(exporter), sample_sink, kDefaultExportPeriod};
+
+        // Optional OpenMetrics endpoint; bound here so a bad address fails before probing starts.
+        std::unique_ptr<MetricsServer> metrics_server;
+        if (opts.metrics_listen) {
+            // Log-linear snapshots only carry populated slots; export them on the configured bounds.
+            metrics_server = std::make_unique<MetricsServer>(
+                aggregator, *opts.metrics_listen,
+                aggregator_config.histogram_mode == HistogramMode::LogLinear ? bucket_boundaries
+                                                                             : std::vector<double>{});
+        }
 
-        CsvExporterLoop csv_loop{aggregator,
-                                 opts.output_file.value_or("pingstats.csv"),
-                                 kDefaultExportPeriod};
-        const bool enable_csv_export = effective_format == OutputFormat::Csv;
-        const bool enable_json_export = effective_format == OutputFormat::Json;
+        BackendConfig backend_config;
+        if (opts.resolve_ttl) {
+            backend_config.resolve_ttl = *opts.resolve_ttl;
+        }
+        backend_config.kernel_timestamps = opts.kernel_timestamps;
+        if (opts.icmp_socket_mode) {
+            backend_config.icmp_socket_mode = *opts.icmp_socket_mode;
+        }
 
         std::vector<SessionBundle> sessions;
         sessions.reserve(targets.size());
         for (auto& target : targets) {
-            auto backend_unique = make_platform_ping_backend();
+            auto backend_unique = make_platform_ping_backend(backend_config);
             backend_unique->initialize();
+            try {
+                backend_unique->prepare_host(target.host);
+            } catch (const std::exception& ex) {
+                // Not fatal: the probe path retries resolution and records loss until it succeeds.
+                std::cerr << "Warning: cannot resolve " << target.host << ": " << ex.what() << std::endl;
+            }
             auto backend_shared = std::shared_ptr<PlatformPingBackend>(std::move(backend_unique));
-            auto session = make_ping_session(std::move(target), backend_shared, aggregator);
+            auto session = make_ping_session(std::move(target), backend_shared, aggregator, scheduler, ingestor,
+                                             sample_sink);
             sessions.push_back(SessionBundle{std::move(backend_shared), std::move(session)});
         }
 
@@ -249,8 +613,12 @@ int run(int argc, char** argv) {
             bundle.session->start();
         }
 
-        if (enable_csv_export) {
-            csv_loop.start();
+        if (export_loop.enabled()) {
+            export_loop.start();
+        }
+        if (metrics_server) {
+            metrics_server->start();
+            std::cout << "Serving metrics on port " << metrics_server->port() << " at /metrics" << std::endl;
         }
 
         auto view = make_console_view(aggregator);
@@ -261,14 +629,16 @@ int run(int argc, char** argv) {
         std::getline(std::cin, line);
 
         view->stop();
-        if (enable_csv_export) {
-            csv_loop.stop();
+        if (metrics_server) {
+            metrics_server->stop();
+        }
+        if (ingestor) {
+            ingestor->flush();
+        }
+        if (export_loop.enabled()) {
+            export_loop.stop();
             // Final snapshot write
-            write_snapshots_csv_append(opts.output_file.value_or("pingstats.csv"),
-                                       aggregator->snapshot_all());
-        } else if (enable_json_export) {
-            write_snapshots_json(opts.output_file.value_or("pingstats.json"),
-                                 aggregator->snapshot_all());
+            export_loop.write(aggregator->snapshot_all());
         }
         for (auto& bundle : sessions) {
             bundle.session->stop();
@@ -276,6 +646,12 @@ int run(int argc, char** argv) {
                 bundle.backend->shutdown();
             }
         }
+        if (ingestor) {
+            ingestor->stop();
+        }
+        if (sample_sink) {
+            sample_sink->flush();
+        }
 
         return 0;
     } catch (const std::exception& ex) {
@@ -0,0 +1,642 @@
+#include "metrics_server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace pingstats {
+
+namespace {
+
+/// RTTs are converted by dividing, so a millisecond value with a short decimal form (10, 12.5)
+/// prints as the matching short seconds value (0.01, 0.0125) rather than with float noise.
+constexpr double kMsPerSecond = 1000.0;
+
+/// OpenMetrics number: shortest round-trip text, or NaN/+Inf/-Inf.
+void append_number(std::string& out, double value)
+{
+    if (std::isnan(value)) {
+        out.append("NaN");
+        return;
+    }
+    if (std::isinf(value)) {
+        out.append(value > 0 ? "+Inf" : "-Inf");
+        return;
+    }
+    char text[32];
+    const auto res = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, res.ptr);
+}
+
+/// le bound: shortest round-trip digits in plain decimal notation ("0.0003", not "3e-04"), so
+/// bounds read the same as the configured boundaries; falls back to append_number if too long.
+void append_bound(std::string& out, double value)
+{
+    char text[64];
+    const auto res = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed);
+    if (res.ec != std::errc{}) {
+        append_number(out, value);
+        return;
+    }
+    out.append(text, res.ptr);
+}
+
+void append_number(std::string& out, std::uint64_t value)
+{
+    char text[24];
+    const auto res = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, res.ptr);
+}
+
+/// Append a label value with backslash, quote and newline escaped.
+void append_label_value(std::string& out, std::string_view value)
+{
+    for (char c : value) {
+        switch (c) {
+        case '\\': out.append("\\\\"); break;
+        case '"': out.append("\\\""); break;
+        case '\n': out.append("\\n"); break;
+        default: out.push_back(c);
+        }
+    }
+}
+
+/// Metric family metadata; unit is empty for unitless families.
+void append_family(std::string& out, std::string_view name, std::string_view type, std::string_view unit,
+                   std::string_view help)
+{
+    out.append("# TYPE ").append(name).push_back(' ');
+    out.append(type).push_back('\n');
+    if (!unit.empty()) {
+        out.append("# UNIT ").append(name).push_back(' ');
+        out.append(unit).push_back('\n');
+    }
+    out.append("# HELP ").append(name).push_back(' ');
+    out.append(help).push_back('\n');
+}
+
+/// Append `name{host="...",<labels>} `; labels are preformatted and start with a comma.
+void append_sample_prefix(std::string& out, std::string_view name, const std::string& host, std::string_view labels)
+{
+    out.append(name).append("{host=\"");
+    append_label_value(out, host);
+    out.push_back('"');
+    out.append(labels).append("} ");
+}
+
+template <typename T>
+void append_sample(std::string& out, std::string_view name, const std::string& host, std::string_view labels, T value)
+{
+    append_sample_prefix(out, name, host, labels);
+    append_number(out, value);
+    out.push_back('\n');
+}
+
+/// Lost probes recovered from the loss ratio, which the aggregator derives from integer counts.
+std::uint64_t lost_probes(const StatisticsSnapshot& snap)
+{
+    const auto lost = static_cast<std::uint64_t>(std::llround(static_cast<double>(snap.count) * snap.loss_ratio));
+    return std::min<std::uint64_t>(lost, snap.count);
+}
+
+struct WindowField {
+    const char* labels;
+    WindowSummary StatisticsSnapshot::*window;
+};
+
+constexpr WindowField kWindows[] = {
+    {",window=\"1m\"", &StatisticsSnapshot::window_1m},
+    {",window=\"5m\"", &StatisticsSnapshot::window_5m},
+    {",window=\"15m\"", &StatisticsSnapshot::window_15m},
+};
+
+void append_bucket(std::string& out, const std::string& host, double bound_ms, double cumulative, std::string& labels)
+{
+    labels.assign(",le=\"");
+    append_bound(labels, bound_ms / kMsPerSecond);
+    labels.push_back('"');
+    append_sample(out, "pingstats_rtt_seconds_bucket", host, labels, cumulative);
+}
+
+/// Histogram samples for one host. Every snapshot pair but the last is (inclusive upper bound ms,
+/// count); the last one counts overflow. Without bounds_ms the snapshot's own bounds are the le
+/// set, and bounds that do not increase are folded into the next bucket. With bounds_ms each
+/// snapshot bucket is counted at the first le it lies entirely below.
+void append_histogram(std::string& out, const StatisticsSnapshot& snap, const std::vector<double>& bounds_ms,
+                      std::string& labels)
+{
+    const auto& buckets = snap.histogram_buckets;
+    double total = 0.0;
+    for (const auto& bucket : buckets) {
+        total += bucket.second;
+    }
+
+    double cumulative = 0.0;
+    if (bounds_ms.empty()) {
+        double last_bound = -INFINITY;
+        for (std::size_t i = 0; i + 1 < buckets.size(); ++i) {
+            cumulative += buckets[i].second;
+            const double bound = buckets[i].first;
+            if (!(bound > last_bound) || !std::isfinite(bound)) {
+                continue;
+            }
+            last_bound = bound;
+            append_bucket(out, snap.host, bound, cumulative, labels);
+        }
+    } else {
+        std::size_t next = 0;
+        for (const double bound : bounds_ms) {
+            for (; next + 1 < buckets.size() && buckets[next].first <= bound; ++next) {
+                cumulative += buckets[next].second;
+            }
+            append_bucket(out, snap.host, bound, cumulative, labels);
+        }
+    }
+    append_sample(out, "pingstats_rtt_seconds_bucket", snap.host, ",le=\"+Inf\"", total);
+    append_sample(out, "pingstats_rtt_seconds_count", snap.host, "", total);
+    append_sample(out, "pingstats_rtt_seconds_sum", snap.host, "", snap.mean_ms / kMsPerSecond * total);
+}
+
+}  // namespace
+
+void render_openmetrics(std::string& out, const std::vector<StatisticsSnapshot>& snapshots,
+                        const std::vector<double>& histogram_bounds_ms)
+{
+    // OpenMetrics wants each family contiguous, so the hosts are walked once per family.
+    append_family(out, "pingstats_probes", "counter", "", "Echo requests sent.");
+    for (const auto& snap : snapshots) {
+        append_sample(out, "pingstats_probes_total", snap.host, "", static_cast<std::uint64_t>(snap.count));
+    }
+    append_family(out, "pingstats_probes_lost", "counter", "", "Echo requests that got no reply.");
+    for (const auto& snap : snapshots) {
+        append_sample(out, "pingstats_probes_lost_total", snap.host, "", lost_probes(snap));
+    }
+    append_family(out, "pingstats_loss_ratio", "gauge", "", "Fraction of probes lost over the whole run.");
+    for (const auto& snap : snapshots) {
+        append_sample(out, "pingstats_loss_ratio", snap.host, "", snap.loss_ratio);
+    }
+
+    const auto rtt_gauge = [&](std::string_view name, std::string_view help, double StatisticsSnapshot::*field) {
+        append_family(out, name, "gauge", "seconds", help);
+        for (const auto& snap : snapshots) {
+            append_sample(out, name, snap.host, "", snap.*field / kMsPerSecond);
+        }
+    };
+    rtt_gauge("pingstats_rtt_min_seconds", "Lowest RTT over the whole run.", &StatisticsSnapshot::min_ms);
+    rtt_gauge("pingstats_rtt_max_seconds", "Highest RTT over the whole run.", &StatisticsSnapshot::max_ms);
+    rtt_gauge("pingstats_rtt_mean_seconds", "Mean RTT over the whole run.", &StatisticsSnapshot::mean_ms);
+
+    append_family(out, "pingstats_rtt_quantile_seconds", "gauge", "seconds",
+                  "RTT quantiles over the whole run (streaming sketch, ~1% relative error).");
+    for (const auto& snap : snapshots) {
+        append_sample(out, "pingstats_rtt_quantile_seconds", snap.host, ",quantile=\"0.5\"", snap.median_ms / kMsPerSecond);
+        append_sample(out, "pingstats_rtt_quantile_seconds", snap.host, ",quantile=\"0.9\"", snap.p90_ms / kMsPerSecond);
+        append_sample(out, "pingstats_rtt_quantile_seconds", snap.host, ",quantile=\"0.95\"", snap.p95_ms / kMsPerSecond);
+        append_sample(out, "pingstats_rtt_quantile_seconds", snap.host, ",quantile=\"0.99\"", snap.p99_ms / kMsPerSecond);
+        append_sample(out, "pingstats_rtt_quantile_seconds", snap.host, ",quantile=\"0.999\"", snap.p999_ms / kMsPerSecond);
+    }
+
+    append_family(out, "pingstats_window_probes", "gauge", "", "Probes in the rolling window.");
+    for (const auto& snap : snapshots) {
+        for (const auto& w : kWindows) {
+            append_sample(out, "pingstats_window_probes", snap.host, w.labels,
+                          static_cast<std::uint64_t>((snap.*w.window).count));
+        }
+    }
+    append_family(out, "pingstats_window_loss_ratio", "gauge", "", "Fraction of probes lost in the rolling window.");
+    for (const auto& snap : snapshots) {
+        for (const auto& w : kWindows) {
+            append_sample(out, "pingstats_window_loss_ratio", snap.host, w.labels, (snap.*w.window).loss_ratio);
+        }
+    }
+    const auto window_gauge = [&](std::string_view name, std::string_view help, double WindowSummary::*field) {
+        append_family(out, name, "gauge", "seconds", help);
+        for (const auto& snap : snapshots) {
+            for (const auto& w : kWindows) {
+                append_sample(out, name, snap.host, w.labels, (snap.*w.window).*field / kMsPerSecond);
+            }
+        }
+    };
+    window_gauge("pingstats_window_rtt_min_seconds", "Lowest RTT in the rolling window.", &WindowSummary::min_ms);
+    window_gauge("pingstats_window_rtt_max_seconds", "Highest RTT in the rolling window.", &WindowSummary::max_ms);
+    window_gauge("pingstats_window_rtt_mean_seconds", "Mean RTT in the rolling window.", &WindowSummary::mean_ms);
+
+    std::string labels;
+    append_family(out, "pingstats_window_rtt_quantile_seconds", "gauge", "seconds",
+                  "RTT quantiles in the rolling window.");
+    for (const auto& snap : snapshots) {
+        for (const auto& w : kWindows) {
+            const auto& window = snap.*w.window;
+            const std::pair<const char*, double> quantiles[] = {
+                {",quantile=\"0.5\"", window.median_ms},
+                {",quantile=\"0.95\"", window.p95_ms},
+                {",quantile=\"0.99\"", window.p99_ms},
+            };
+            for (const auto& [quantile, value_ms] : quantiles) {
+                labels.assign(w.labels).append(quantile);
+                append_sample(out, "pingstats_window_rtt_quantile_seconds", snap.host, labels, value_ms / kMsPerSecond);
+            }
+        }
+    }
+
+    append_family(out, "pingstats_rtt_seconds", "histogram", "seconds", "RTT distribution of answered probes.");
+    for (const auto& snap : snapshots) {
+        append_histogram(out, snap, histogram_bounds_ms, labels);
+    }
+    out.append("# EOF\n");
+}
+
+MetricsListenAddress parse_metrics_listen_address(const std::string& value)
+{
+    MetricsListenAddress address;
+    std::string_view port_text = value;
+    if (!value.empty() && value.front() == '[') {
+        const auto close = value.find(']');
+        if (close == std::string::npos || close + 1 >= value.size() || value[close + 1] != ':') {
+            throw std::invalid_argument("Invalid metrics listen address: " + value);
+        }
+        address.host = value.substr(1, close - 1);
+        port_text = std::string_view(value).substr(close + 2);
+    } else if (const auto colon = value.rfind(':'); colon != std::string::npos) {
+        if (value.find(':') != colon) {
+            throw std::invalid_argument("IPv6 metrics listen addresses need brackets, e.g. [::1]:9464: " + value);
+        }
+        address.host = value.substr(0, colon);
+        port_text = std::string_view(value).substr(colon + 1);
+    }
+
+    unsigned port = 0;
+    const char* end = port_text.data() + port_text.size();
+    const auto res = std::from_chars(port_text.data(), end, port);
+    if (port_text.empty() || res.ec != std::errc{} || res.ptr != end || port > 65535) {
+        throw std::invalid_argument("Invalid metrics listen port: " + value);
+    }
+    address.port = static_cast<std::uint16_t>(port);
+    return address;
+}
+
+/// Complete HTTP response: status line, headers and body in one buffer.
+struct MetricsServer::Response {
+    /// Snapshot set the body was rendered from; null for the fixed error responses.
+    std::shared_ptr<const SnapshotSet> source;
+    std::string bytes;
+    /// Length of the status line and headers, i.e. what a HEAD request gets.
+    std::size_t head_bytes{};
+};
+
+struct MetricsServer::Connection {
+    int fd{-1};
+    std::string request;
+    std::shared_ptr<const Response> response;
+    /// Bytes of response to send (all of it, or just the head).
+    std::size_t send_bytes{};
+    std::size_t sent{};
+    std::chrono::steady_clock::time_point deadline;
+};
+
+std::shared_ptr<const MetricsServer::Response> MetricsServer::make_response(std::string_view status,
+                                                                            std::string_view content_type,
+                                                                            std::string_view extra_headers,
+                                                                            std::string_view body)
+{
+    auto response = std::make_shared<Response>();
+    response->bytes.append("HTTP/1.1 ").append(status);
+    response->bytes.append("\r\nContent-Type: ").append(content_type);
+    response->bytes.append("\r\nContent-Length: ").append(std::to_string(body.size()));
+    response->bytes.append("\r\nConnection: close\r\n").append(extra_headers).append("\r\n");
+    response->head_bytes = response->bytes.size();
+    response->bytes.append(body);
+    return response;
+}
+
+#if defined(_WIN32)
+
+// The listener is built on POSIX sockets and poll().
+MetricsServer::MetricsServer(std::shared_ptr<StatisticsAggregator> aggregator, const MetricsListenAddress&,
+                             std::vector<double> histogram_bounds_ms)
+    : aggregator_(std::move(aggregator)), histogram_bounds_ms_(std::move(histogram_bounds_ms))
+{
+    throw std::runtime_error("The metrics endpoint is not supported on Windows");
+}
+
+MetricsServer::~MetricsServer() = default;
+void MetricsServer::start() {}
+void MetricsServer::stop() {}
+
+#else
+
+namespace {
+
+constexpr int kListenBacklog = 64;
+constexpr std::size_t kMaxConnections = 64;
+constexpr std::size_t kMaxRequestBytes = 8192;
+constexpr std::chrono::seconds kClientTimeout{10};
+/// poll() timeout, bounding how late an idle connection is dropped.
+constexpr int kPollTimeoutMs = 1000;
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+void close_fd(int& fd)
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+/// Make fd non-blocking and close-on-exec; false on failure.
+bool configure_fd(int fd)
+{
+    const int flags = ::fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+std::string describe(const MetricsListenAddress& address)
+{
+    const bool v6 = address.host.find(':') != std::string::npos;
+    return (v6 ? "[" + address.host + "]" : address.host) + ":" + std::to_string(address.port);
+}
+
+}  // namespace
+
+MetricsServer::MetricsServer(std::shared_ptr<StatisticsAggregator> aggregator, const MetricsListenAddress& address,
+                             std::vector<double> histogram_bounds_ms)
+    : aggregator_(std::move(aggregator)), histogram_bounds_ms_(std::move(histogram_bounds_ms))
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* results = nullptr;
+    const std::string service = std::to_string(address.port);
+    const int rc = ::getaddrinfo(address.host.empty() ? nullptr : address.host.c_str(), service.c_str(), &hints,
+                                 &results);
+    if (rc != 0) {
+        throw std::runtime_error("Cannot resolve metrics listen address " + describe(address) + ": " +
+                                 ::gai_strerror(rc));
+    }
+
+    int last_error = 0;
+    for (const addrinfo* ai = results; ai != nullptr && listen_fd_ < 0; ai = ai->ai_next) {
+        int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            last_error = errno;
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, kListenBacklog) == 0 && configure_fd(fd)) {
+            listen_fd_ = fd;
+        } else {
+            last_error = errno;
+            close_fd(fd);
+        }
+    }
+    ::freeaddrinfo(results);
+    if (listen_fd_ < 0) {
+        throw std::system_error(last_error, std::generic_category(),
+                                "Cannot listen for metrics on " + describe(address));
+    }
+
+    sockaddr_storage bound{};
+    socklen_t bound_len = sizeof(bound);
+    if (::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&bound), &bound_len) == 0) {
+        port_ = ntohs(bound.ss_family == AF_INET6 ? reinterpret_cast<const sockaddr_in6&>(bound).sin6_port
+                                                  : reinterpret_cast<const sockaddr_in&>(bound).sin_port);
+    }
+
+    int wake[2];
+    if (::pipe(wake) != 0 || !configure_fd(wake[0]) || !configure_fd(wake[1])) {
+        const int error = errno;
+        close_fd(listen_fd_);
+        throw std::system_error(error, std::generic_category(), "Failed to create metrics server wake pipe");
+    }
+    wake_read_fd_ = wake[0];
+    wake_write_fd_ = wake[1];
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+    close_fd(wake_write_fd_);
+    close_fd(wake_read_fd_);
+    close_fd(listen_fd_);
+}
+
+void MetricsServer::start()
+{
+    if (running_.exchange(true)) {
+        return;
+    }
+    worker_ = std::thread([this]() { run(); });
+}
+
+void MetricsServer::stop()
+{
+    if (!running_.exchange(false)) {
+        return;
+    }
+    const char byte = 1;
+    [[maybe_unused]] const auto written = ::write(wake_write_fd_, &byte, 1);
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void MetricsServer::run()
+{
+    std::vector<Connection> connections;
+    std::vector<pollfd> fds;
+    while (running_.load(std::memory_order_acquire)) {
+        fds.clear();
+        fds.push_back(pollfd{wake_read_fd_, POLLIN, 0});
+        fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+        for (const auto& connection : connections) {
+            fds.push_back(pollfd{connection.fd, static_cast<short>(connection.response ? POLLOUT : POLLIN), 0});
+        }
+        if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), kPollTimeoutMs) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[0].revents != 0) {
+            char drain[16];
+            while (::read(wake_read_fd_, drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < connections.size(); ++i) {
+            if (service(connections[i], fds[i + 2].revents, now)) {
+                if (kept != i) {
+                    connections[kept] = std::move(connections[i]);
+                }
+                ++kept;
+            }
+        }
+        connections.resize(kept);
+
+        if ((fds[1].revents & POLLIN) != 0) {
+            for (;;) {
+                int fd = ::accept(listen_fd_, nullptr, nullptr);
+                if (fd < 0) {
+                    break;  // EAGAIN once the backlog is drained; other errors retry on the next wakeup
+                }
+                if (connections.size() >= kMaxConnections || !configure_fd(fd)) {
+                    close_fd(fd);
+                    continue;
+                }
+#if defined(SO_NOSIGPIPE)
+                const int one = 1;
+                ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+                Connection connection;
+                connection.fd = fd;
+                connection.deadline = now + kClientTimeout;
+                connections.push_back(std::move(connection));
+            }
+        }
+    }
+    for (auto& connection : connections) {
+        close_fd(connection.fd);
+    }
+}
+
+bool MetricsServer::service(Connection& connection, short revents, std::chrono::steady_clock::time_point now)
+{
+    if ((revents & (POLLERR | POLLNVAL)) != 0) {
+        close_fd(connection.fd);
+        return false;
+    }
+
+    if (!connection.response && (revents & (POLLIN | POLLHUP)) != 0) {
+        char buffer[4096];
+        bool peer_closed = false;
+        for (;;) {
+            const auto received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                connection.request.append(buffer, static_cast<std::size_t>(received));
+                continue;
+            }
+            if (received == 0) {
+                peer_closed = true;  // may be a half-close after a complete request; answer it first
+                break;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            close_fd(connection.fd);
+            return false;
+        }
+        if (connection.request.find("\r\n\r\n") != std::string::npos) {
+            respond(connection);
+        } else if (peer_closed) {
+            close_fd(connection.fd);  // closed before sending a full request
+            return false;
+        } else if (connection.request.size() > kMaxRequestBytes) {
+            static const auto too_large =
+                make_response("431 Request Header Fields Too Large", "text/plain", "", "Request too large\n");
+            connection.response = too_large;
+            connection.send_bytes = too_large->bytes.size();
+        }
+    }
+
+    // Sent right away rather than after another poll(): the socket buffer is usually empty.
+    if (connection.response) {
+        while (connection.sent < connection.send_bytes) {
+            const auto written = ::send(connection.fd, connection.response->bytes.data() + connection.sent,
+                                        connection.send_bytes - connection.sent, kSendFlags);
+            if (written > 0) {
+                connection.sent += static_cast<std::size_t>(written);
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                break;
+            }
+            close_fd(connection.fd);
+            return false;
+        }
+        if (connection.sent == connection.send_bytes) {
+            close_fd(connection.fd);
+            return false;
+        }
+    }
+
+    if (now >= connection.deadline) {
+        close_fd(connection.fd);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+/// Only the request line matters: the response never depends on headers or a body.
+void MetricsServer::respond(Connection& connection)
+{
+    static const auto not_found = make_response("404 Not Found", "text/plain", "", "Not found; try /metrics\n");
+    static const auto not_allowed =
+        make_response("405 Method Not Allowed", "text/plain", "Allow: GET, HEAD\r\n", "Method not allowed\n");
+
+    const std::string_view request = connection.request;
+    const std::string_view line = request.substr(0, request.find("\r\n"));
+    const auto method_end = line.find(' ');
+    const std::string_view method = line.substr(0, method_end);
+    std::string_view target = method_end == std::string_view::npos ? std::string_view{} : line.substr(method_end + 1);
+    target = target.substr(0, target.find(' '));
+    target = target.substr(0, target.find('?'));
+
+    const bool head = method == "HEAD";
+    if (method != "GET" && !head) {
+        connection.response = not_allowed;
+    } else if (target != "/metrics") {
+        connection.response = not_found;
+    } else {
+        connection.response = metrics_response();
+    }
+    connection.send_bytes = head ? connection.response->head_bytes : connection.response->bytes.size();
+}
+
+/// published_snapshots() returns the same set until the aggregator rebuilds it, so pointer
+/// identity marks the epoch.
+std::shared_ptr<const MetricsServer::Response> MetricsServer::metrics_response()
+{
+    auto published = aggregator_->published_snapshots();
+    if (cached_ && cached_->source == published) {
+        return cached_;
+    }
+
+    static const std::vector<StatisticsSnapshot> kNoHosts;
+    body_.clear();
+    render_openmetrics(body_, published ? published->hosts : kNoHosts, histogram_bounds_ms_);
+    auto response = std::make_shared<Response>();
+    response->source = std::move(published);
+    response->bytes.reserve(160 + body_.size());
+    response->bytes.append("HTTP/1.1 200 OK\r\nContent-Type: ").append(kOpenMetricsContentType);
+    response->bytes.append("\r\nContent-Length: ").append(std::to_string(body_.size()));
+    response->bytes.append("\r\nConnection: close\r\n\r\n");
+    response->head_bytes = response->bytes.size();
+    response->bytes.append(body_);
+    cached_ = std::move(response);
+    render_count_.fetch_add(1, std::memory_order_relaxed);
+    return cached_;
+}
+
+}  // namespace pingstats
@@ -0,0 +1,96 @@
+#include "ping_scheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace pingstats {
+
+PingScheduler::PingScheduler(std::size_t worker_count)
+{
+    const std::size_t count = std::max<std::size_t>(worker_count, 1);
+    workers_.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        workers_.emplace_back(&PingScheduler::worker_loop, this);
+    }
+}
+
+/// Stop all workers; tasks still registered are dropped without another run.
+PingScheduler::~PingScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+/// Insert the task and its first deadline; wakes one worker in case it is now the earliest.
+PingScheduler::TaskId PingScheduler::add(Task task, Clock::time_point first_run)
+{
+    TaskId id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        entries_.emplace(id, Entry{std::move(task), false});
+        heap_.push(Deadline{first_run, id});
+    }
+    wake_cv_.notify_one();
+    return id;
+}
+
+/// Erase the entry; stale heap nodes are skipped lazily by the workers.
+void PingScheduler::remove(TaskId id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [&] {
+        auto it = entries_.find(id);
+        return it == entries_.end() || !it->second.running;
+    });
+    entries_.erase(id);
+}
+
+void PingScheduler::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (heap_.empty()) {
+            wake_cv_.wait(lock);
+            continue;
+        }
+        const Deadline next = heap_.top();
+        if (Clock::now() < next.due) {
+            wake_cv_.wait_until(lock, next.due);
+            continue;
+        }
+        heap_.pop();
+
+        auto it = entries_.find(next.id);
+        if (it == entries_.end()) {
+            continue;  // removed while queued
+        }
+        it->second.running = true;
+        // remove() waits while running, and map nodes are address-stable, so no copy is needed.
+        Task& task = it->second.task;
+        lock.unlock();
+
+        const auto run_start = Clock::now();
+        const auto delay = task();
+        const auto due = std::max(run_start + delay, Clock::now());
+
+        lock.lock();
+        it = entries_.find(next.id);
+        if (it != entries_.end()) {
+            it->second.running = false;
+            heap_.push(Deadline{due, next.id});
+            idle_cv_.notify_all();
+            wake_cv_.notify_one();
+        }
+    }
+}
+
+}  // namespace pingstats
@@ -1,11 +1,16 @@
 #include "ping_session.hpp"
+#include "ping_scheduler.hpp"
 #include "platform_ping_backend.hpp"
+#include "sample_ingestor.hpp"
+#include "sample_sink.hpp"
 #include "statistics_aggregator.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <utility>
 
@@ -19,13 +24,120 @@ PingSession::PingSession(TargetConfig target,
 
 namespace {
 
+/// Lower bound for ping intervals to avoid excessive request rates.
+constexpr double kMinInterval = 0.1;
+
+/// Timeout derived from the interval: 80% of it, bounded to 100..5000 ms.
+std::chrono::milliseconds timeout_for_interval(double interval_s)
+{
+    const double timeout_ms_d = std::clamp(interval_s * 800.0, 100.0, 5000.0);
+    return std::chrono::milliseconds(static_cast<int>(timeout_ms_d));
+}
+
+/// Where a session's results go: straight into the aggregator, or onto the ingestor's lock-free
+/// queues when one is configured, plus the raw sample sink if any. Cheap to copy into completion
+/// callbacks.
+class SampleRecorder {
+public:
+    SampleRecorder(std::shared_ptr<StatisticsAggregator> aggregator,
+                   std::shared_ptr<SampleIngestor> ingestor,
+                   std::shared_ptr<SampleSink> sink)
+        : aggregator_(std::move(aggregator)), ingestor_(std::move(ingestor)), sink_(std::move(sink))
+    {}
+
+    /// Register the session's host with the sink; must precede the first record().
+    void register_host(const std::string& host)
+    {
+        if (sink_) {
+            sink_host_ = sink_->register_host(host);
+        }
+    }
+
+    void record(StatisticsAggregator::HostHandle handle, const ProbeSample& sample) const
+    {
+        if (sink_) {
+            sink_->record(sink_host_, sample);
+        }
+        if (ingestor_) {
+            ingestor_->submit(SampleRecord{handle, sample.rtt_ms, sample.success, std::chrono::steady_clock::now()});
+            return;
+        }
+        aggregator_->add_sample(handle, sample.rtt_ms, sample.success);
+    }
+
+private:
+    std::shared_ptr<StatisticsAggregator> aggregator_;
+    std::shared_ptr<SampleIngestor> ingestor_;
+    std::shared_ptr<SampleSink> sink_;
+    SampleSink::HostId sink_host_{0};
+};
+
+/// Sample for a probe submitted now; filled in with the outcome once known.
+ProbeSample start_sample(std::uint32_t sequence)
+{
+    ProbeSample sample;
+    sample.sent_at = std::chrono::system_clock::now();
+    sample.sequence = sequence;
+    return sample;
+}
+
+/// Perform one ping and record its outcome; backend errors are logged and counted as loss.
+void probe_once(const TargetConfig& target,
+                StatisticsAggregator::HostHandle handle,
+                PlatformPingBackend& backend,
+                const SampleRecorder& recorder,
+                std::chrono::milliseconds timeout,
+                std::uint32_t sequence)
+{
+    auto sample = start_sample(sequence);
+    try {
+        const auto result = backend.send_ping(target.host, timeout);
+        sample.rtt_ms = result.rtt_ms;
+        sample.success = result.success;
+    } catch (const std::exception& ex) {
+        std::cerr << "PingSession error for " << target.host << ": " << ex.what() << std::endl;
+    } catch (...) {
+        std::cerr << "PingSession unknown error for " << target.host << std::endl;
+    }
+    recorder.record(handle, sample);
+}
+
+/// Submit one ping and record its outcome when it completes. The callback holds its own copy of
+/// the recorder, so a probe still in flight after the session stops stays safe.
+void probe_async(const TargetConfig& target,
+                 StatisticsAggregator::HostHandle handle,
+                 PlatformPingBackend& backend,
+                 const SampleRecorder& recorder,
+                 std::chrono::milliseconds timeout,
+                 std::uint32_t sequence)
+{
+    auto sample = start_sample(sequence);
+    try {
+        backend.send_ping_async(target.host, timeout,
+                                [handle, recorder, sample](const PlatformPingBackend::PingResult& result) mutable {
+                                    sample.rtt_ms = result.rtt_ms;
+                                    sample.success = result.success;
+                                    recorder.record(handle, sample);
+                                });
+    } catch (const std::exception& ex) {
+        std::cerr << "PingSession error for " << target.host << ": " << ex.what() << std::endl;
+        recorder.record(handle, sample);
+    } catch (...) {
+        std::cerr << "PingSession unknown error for " << target.host << std::endl;
+        recorder.record(handle, sample);
+    }
+}
+
 /// Concrete ping session that owns a worker thread and supports live interval updates.
 class PingSessionImpl final : public PingSession {
 public:
     PingSessionImpl(TargetConfig target,
                     std::shared_ptr<PlatformPingBackend> backend,
-                    std::shared_ptr<StatisticsAggregator> aggregator)
+                    std::shared_ptr<StatisticsAggregator> aggregator,
+                    std::shared_ptr<SampleIngestor> ingestor,
+                    std::shared_ptr<SampleSink> sink)
         : PingSession(std::move(target), std::move(backend), std::move(aggregator)),
+          recorder_(aggregator_, std::move(ingestor), std::move(sink)),
           interval_s_(target_.interval_s.value_or(1.0))
     {}
 
@@ -38,6 +150,8 @@ public:
         if (!running_.compare_exchange_strong(expected, true)) {
             return;
         }
+        host_handle_ = aggregator_->register_host(target_.host, target_.bucket_boundaries);
+        recorder_.register_host(target_.host);
         worker_ = std::thread(&PingSessionImpl::run_loop, this);
     }
 
@@ -53,7 +167,6 @@ public:
     /// Update the interval (seconds), clamped to avoid excessive request rates.
     void set_interval(double seconds) override
     {
-        constexpr double kMinInterval = 0.1;
         const double clamped = std::max(seconds, kMinInterval);
         interval_s_.store(clamped);
     }
@@ -67,19 +180,7 @@ private:
         while (running_.load()) {
             const auto iteration_start = std::chrono::steady_clock::now();
             const double interval = interval_s_.load();
-            const double timeout_ms_d = std::clamp(interval * 800.0, 100.0, 5000.0);
-            const auto timeout = std::chrono::milliseconds(static_cast<int>(timeout_ms_d));
-
-            try {
-                const auto result = backend_->send_ping(target_.host, timeout);
-                aggregator_->add_sample(target_.host, result.rtt_ms, result.success);
-            } catch (const std::exception& ex) {
-                std::cerr << "PingSession error for " << target_.host << ": " << ex.what() << std::endl;
-                aggregator_->add_sample(target_.host, 0.0, false);
-            } catch (...) {
-                std::cerr << "PingSession unknown error for " << target_.host << std::endl;
-                aggregator_->add_sample(target_.host, 0.0, false);
-            }
+            probe_once(target_, host_handle_, *backend_, recorder_, timeout_for_interval(interval), next_sequence_++);
 
             const auto elapsed = std::chrono::steady_clock::now() - iteration_start;
             const auto remaining = std::chrono::duration<double>(interval) - std::chrono::duration<double>(elapsed);
@@ -89,18 +190,106 @@ private:
         }
     }
 
+    SampleRecorder recorder_;
+    std::uint32_t next_sequence_{0};  ///< touched only by the worker thread
     std::atomic<bool> running_{false};
     std::atomic<double> interval_s_;
     std::thread worker_;
 };
 
+/// Ping session without its own thread: each probe is a task on a shared PingScheduler.
+/// Probes are submitted asynchronously, so a worker never waits out a timeout and slow or lossy
+/// targets do not hold up the others.
+class ScheduledPingSession final : public PingSession {
+public:
+    ScheduledPingSession(TargetConfig target,
+                         std::shared_ptr<PlatformPingBackend> backend,
+                         std::shared_ptr<StatisticsAggregator> aggregator,
+                         std::shared_ptr<PingScheduler> scheduler,
+                         std::shared_ptr<SampleIngestor> ingestor,
+                         std::shared_ptr<SampleSink> sink)
+        : PingSession(std::move(target), std::move(backend), std::move(aggregator)),
+          recorder_(aggregator_, std::move(ingestor), std::move(sink)),
+          scheduler_(std::move(scheduler)),
+          interval_s_(target_.interval_s.value_or(1.0))
+    {}
+
+    ~ScheduledPingSession() override { stop(); }
+
+    /// Register the probe task with the scheduler, due immediately; idempotent.
+    void start() override
+    {
+        std::lock_guard<std::mutex> lock(start_stop_mutex_);
+        if (task_id_ != 0) {
+            return;
+        }
+        host_handle_ = aggregator_->register_host(target_.host, target_.bucket_boundaries);
+        recorder_.register_host(target_.host);
+        task_id_ = scheduler_->add([this]() { return run_once(); }, PingScheduler::Clock::now());
+    }
+
+    /// Unregister the task; returns once no submission is in progress (a submitted probe may
+    /// still complete afterwards and is then recorded).
+    void stop() override
+    {
+        std::lock_guard<std::mutex> lock(start_stop_mutex_);
+        if (task_id_ == 0) {
+            return;
+        }
+        scheduler_->remove(task_id_);
+        task_id_ = 0;
+    }
+
+    /// Update the interval (seconds); takes effect when the next run is scheduled.
+    void set_interval(double seconds) override
+    {
+        const double clamped = std::max(seconds, kMinInterval);
+        interval_s_.store(clamped);
+    }
+
+    [[nodiscard]] const TargetConfig& get_target() const override { return target_; }
+
+private:
+    /// One scheduler tick: submit a probe and report the delay until the next tick.
+    PingScheduler::Clock::duration run_once()
+    {
+        const double interval = interval_s_.load();
+        probe_async(target_, host_handle_, *backend_, recorder_, timeout_for_interval(interval), next_sequence_++);
+        return std::chrono::duration_cast<PingScheduler::Clock::duration>(
+            std::chrono::duration<double>(interval));
+    }
+
+    SampleRecorder recorder_;
+    std::uint32_t next_sequence_{0};  ///< touched only by run_once(), which never overlaps itself
+    std::shared_ptr<PingScheduler> scheduler_;
+    std::atomic<double> interval_s_;
+    std::mutex start_stop_mutex_;
+    PingScheduler::TaskId task_id_{0};
+};
+
 }  // namespace
 
 std::unique_ptr<PingSession> make_ping_session(TargetConfig target,
                                                std::shared_ptr<PlatformPingBackend> backend,
                                                std::shared_ptr<StatisticsAggregator> aggregator)
 {
-    return std::make_unique<PingSessionImpl>(std::move(target), std::move(backend), std::move(aggregator));
+    return std::make_unique<PingSessionImpl>(std::move(target), std::move(backend), std::move(aggregator), nullptr,
+                                             nullptr);
+}
+
+std::unique_ptr<PingSession> make_ping_session(TargetConfig target,
+                                               std::shared_ptr<PlatformPingBackend> backend,
+                                               std::shared_ptr<StatisticsAggregator> aggregator,
+                                               std::shared_ptr<PingScheduler> scheduler,
+                                               std::shared_ptr<SampleIngestor> ingestor,
+                                               std::shared_ptr<SampleSink> sink)
+{
+    if (!scheduler) {
+        return std::make_unique<PingSessionImpl>(std::move(target), std::move(backend), std::move(aggregator),
+                                                 std::move(ingestor), std::move(sink));
+    }
+    return std::make_unique<ScheduledPingSession>(std::move(target), std::move(backend), std::move(aggregator),
+                                                  std::move(scheduler), std::move(ingestor), std::move(sink));
 }
 
 }  // namespace pingstats
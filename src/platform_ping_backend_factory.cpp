@@ -26,12 +26,17 @@ public:
 
 } // namespace
 
-/// Select platform-specific backend (Linux/macOS/Windows); otherwise return null backend.
+/// Select platform-specific backend with default options.
 std::unique_ptr<PlatformPingBackend> make_platform_ping_backend() {
+    return make_platform_ping_backend(BackendConfig{});
+}
+
+/// Select platform-specific backend (Linux/macOS/Windows); otherwise return null backend.
+std::unique_ptr<PlatformPingBackend> make_platform_ping_backend([[maybe_unused]] const BackendConfig& config) {
 #if defined(__APPLE__)
     return std::make_unique<MacOsPingBackend>();
 #elif defined(__linux__)
-    return std::make_unique<LinuxPingBackend>();
+    return std::make_unique<LinuxPingBackend>(config);
 #elif defined(_WIN32)
     return std::make_unique<WindowsPingBackend>();
 #else
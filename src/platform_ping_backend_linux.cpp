@@ -4,168 +4,133 @@
 #error "LinuxPingBackend is only available on Linux builds"
 #endif
 
-#include <arpa/inet.h>
+#include "linux_icmp_engine.hpp"
+
 #include <chrono>
-#include <cstddef>
-#include <cstring>
-#include <netdb.h>
-#include <netinet/ip_icmp.h>
+#include <exception>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <string_view>
-#include <sys/select.h>
-#include <sys/socket.h>
-#include <sys/time.h>
-#include <unistd.h>
+#include <utility>
+#include <vector>
 
 namespace pingstats {
 
-namespace {
-
-/// ICMP protocol number used for raw sockets.
-constexpr int kIcmpProtocol = IPPROTO_ICMP;
-/// ICMP header size in bytes.
-constexpr std::size_t kIcmpHeaderSize = sizeof(icmphdr);
-/// Payload size in bytes (traditional ping default).
-constexpr std::size_t kPayloadSize = 56;
-/// Total packet size (header + payload).
-constexpr std::size_t kPacketSize = kIcmpHeaderSize + kPayloadSize;
-
-/// Internet checksum helper for ICMP messages.
-std::uint16_t checksum(const void* data, std::size_t len) {
-    const std::uint16_t* buf = static_cast<const std::uint16_t*>(data);
-    std::uint32_t sum = 0;
-    std::size_t nwords = len / 2;
-    for (std::size_t i = 0; i < nwords; ++i) {
-        sum += buf[i];
-    }
-    if (len & 1U) {
-        sum += static_cast<const std::uint8_t*>(data)[len - 1];
-    }
-    while (sum >> 16U) {
-        sum = (sum & 0xFFFFU) + (sum >> 16U);
-    }
-    return static_cast<std::uint16_t>(~sum);
-}
-
-} // namespace
-
-LinuxPingBackend::LinuxPingBackend() = default;
+LinuxPingBackend::LinuxPingBackend(const BackendConfig& config)
+    : config_(config), resolver_(config.resolve_ttl) {}
 
 LinuxPingBackend::~LinuxPingBackend() {
     shutdown();
 }
 
-/// Open raw ICMP socket; requires CAP_NET_RAW/root.
+/// Attach to the process-wide ICMP engine and lease a private identifier; the first attach opens
+/// the socket. Auto mode tries the unprivileged datagram socket first and falls back to raw.
 void LinuxPingBackend::initialize() {
     if (initialized_) {
         return;
     }
-    sock_fd_ = ::socket(AF_INET, SOCK_RAW, kIcmpProtocol);
-    if (sock_fd_ < 0) {
-        throw std::runtime_error("Failed to create raw ICMP socket (need CAP_NET_RAW or root)");
+    LinuxIcmpEngine::Options options;
+    options.kernel_timestamps = config_.kernel_timestamps;
+    switch (config_.icmp_socket_mode) {
+    case IcmpSocketMode::Raw:
+        engine_ = LinuxIcmpEngine::shared(options);
+        break;
+    case IcmpSocketMode::Datagram:
+        options.datagram_socket = true;
+        engine_ = LinuxIcmpEngine::shared(options);
+        break;
+    case IcmpSocketMode::Auto:
+        options.datagram_socket = true;
+        try {
+            engine_ = LinuxIcmpEngine::shared(options);
+        } catch (const std::runtime_error&) {
+            options.datagram_socket = false;
+            engine_ = LinuxIcmpEngine::shared(options);
+        }
+        break;
     }
-
-    identifier_ = static_cast<std::uint16_t>(::getpid() & 0xFFFF);
+    identifier_ = engine_->acquire_identifier();
     sequence_ = 0;
     initialized_ = true;
 }
 
-/// Close the socket and reset flags; safe to call multiple times.
+/// Return the identifier and drop the engine reference; the engine closes its socket once no backend holds it.
 void LinuxPingBackend::shutdown() {
-    if (sock_fd_ >= 0) {
-        ::close(sock_fd_);
-        sock_fd_ = -1;
+    if (engine_) {
+        engine_->release_identifier(identifier_);
     }
+    engine_.reset();
     initialized_ = false;
 }
 
-/// Send an ICMP Echo and await a reply; maps timeouts/errors to success=false.
-PlatformPingBackend::PingResult LinuxPingBackend::send_ping(std::string_view host, std::chrono::milliseconds timeout) {
-    if (!initialized_) {
-        throw std::runtime_error("LinuxPingBackend not initialized");
-    }
-
-    // Resolve host
-    struct addrinfo hints {};
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_RAW;
-    hints.ai_protocol = kIcmpProtocol;
-    struct addrinfo* res = nullptr;
-    const std::string host_str(host);
-    if (const int err = ::getaddrinfo(host_str.c_str(), nullptr, &hints, &res); err != 0) {
-        throw std::runtime_error(std::string("getaddrinfo failed: ") + ::gai_strerror(err));
-    }
+/// Warm the resolver cache; with a zero TTL this is the only resolution for the run.
+void LinuxPingBackend::prepare_host(std::string_view host) {
+    resolver_.lookup(host);
+}
 
-    // Build packet
-    std::uint8_t packet[kPacketSize]{};
-    auto* hdr = reinterpret_cast<icmphdr*>(packet);
-    hdr->type = ICMP_ECHO;
-    hdr->code = 0;
-    hdr->un.echo.id = htons(identifier_);
-    hdr->un.echo.sequence = htons(++sequence_);
-    std::memset(packet + kIcmpHeaderSize, 0x42, kPayloadSize);
-    hdr->checksum = 0;
-    hdr->checksum = checksum(packet, kPacketSize);
-
-    // Destination address
-    sockaddr_in dest{};
-    std::memcpy(&dest, res->ai_addr, sizeof(sockaddr_in));
-    ::freeaddrinfo(res);
-
-    // Send timestamp
-    const auto t0 = std::chrono::steady_clock::now();
-    const auto sent = ::sendto(sock_fd_, packet, kPacketSize, 0, reinterpret_cast<sockaddr*>(&dest), sizeof(dest));
-    if (sent < 0 || static_cast<std::size_t>(sent) != kPacketSize) {
-        throw std::runtime_error("sendto failed");
-    }
+/// Force re-resolution of host, replacing the cached address.
+void LinuxPingBackend::refresh_host(std::string_view host) {
+    resolver_.refresh(host);
+}
 
-    // Wait using select()
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sock_fd_, &readfds);
-    timeval tv{};
-    tv.tv_sec = static_cast<long>(timeout.count() / 1000);
-    tv.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
-    const int ready = ::select(sock_fd_ + 1, &readfds, nullptr, nullptr, &tv);
-    if (ready <= 0) {
-        return PingResult{false, 0.0}; // timeout or error
-    }
+/// Block on the asynchronous path; the shared promise outlives a set_value racing our wake-up.
+PlatformPingBackend::PingResult LinuxPingBackend::send_ping(std::string_view host, std::chrono::milliseconds timeout) {
+    auto promise = std::make_shared<std::promise<PingResult>>();
+    auto future = promise->get_future();
+    send_ping_async(host, timeout, [promise](const PingResult& result) { promise->set_value(result); });
+    return future.get();
+}
 
-    // Buffer incoming packet
-    std::uint8_t recv_buf[512]{};
-    sockaddr_in recv_addr{};
-    socklen_t recv_len = sizeof(recv_addr);
-    const auto recvd = ::recvfrom(sock_fd_, recv_buf, sizeof(recv_buf), 0, reinterpret_cast<sockaddr*>(&recv_addr), &recv_len);
-    if (recvd <= 0) {
-        return PingResult{false, 0.0};
+/// Look up the cached address and hand the echo to the shared engine; maps timeouts to success=false.
+void LinuxPingBackend::send_ping_async(std::string_view host, std::chrono::milliseconds timeout,
+                                       PingCallback on_complete) {
+    if (!initialized_) {
+        throw std::runtime_error("LinuxPingBackend not initialized");
     }
 
-    const auto t1 = std::chrono::steady_clock::now();
-    const double rtt_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    // Resolution happens before the engine timestamps the probe, so it never inflates the RTT.
+    const auto lookup = resolver_.lookup(host);
+    engine_->echo_async(lookup.address, identifier_, ++sequence_, timeout,
+                        [on_complete = std::move(on_complete), resolve_ms = lookup.resolve_ms](
+                            const LinuxIcmpEngine::EchoResult& echo) {
+                            on_complete(PingResult{echo.success, echo.rtt_ms, resolve_ms, echo.clock_source});
+                        });
+}
 
-    // Minimal validation: ICMP Echo Reply
-    if (static_cast<std::size_t>(recvd) < kIcmpHeaderSize + sizeof(iphdr)) {
-        return PingResult{false, 0.0};
+/// Resolve every host, then hand the whole batch to the engine so sends and receives are amortized
+/// over sendmmsg/recvmmsg; hosts that fail to resolve are reported as lost without being sent.
+std::vector<PlatformPingBackend::PingResult> LinuxPingBackend::send_ping_batch(const std::vector<std::string>& hosts,
+                                                                               std::chrono::milliseconds timeout) {
+    if (!initialized_) {
+        throw std::runtime_error("LinuxPingBackend not initialized");
     }
 
-    // Skip IP header
-    auto* ip_hdr = reinterpret_cast<iphdr*>(recv_buf);
-    const std::size_t ip_header_len = static_cast<std::size_t>(ip_hdr->ihl * 4);
-    if (ip_header_len + kIcmpHeaderSize > static_cast<std::size_t>(recvd)) {
-        return PingResult{false, 0.0};
+    std::vector<PingResult> results(hosts.size(), PingResult{false, 0.0});
+    std::vector<LinuxIcmpEngine::EchoRequest> requests;
+    std::vector<std::size_t> request_hosts;
+    requests.reserve(hosts.size());
+    request_hosts.reserve(hosts.size());
+    for (std::size_t i = 0; i < hosts.size(); ++i) {
+        try {
+            const auto lookup = resolver_.lookup(hosts[i]);
+            results[i].resolve_ms = lookup.resolve_ms;
+            requests.push_back(LinuxIcmpEngine::EchoRequest{lookup.address, identifier_, ++sequence_});
+            request_hosts.push_back(i);
+        } catch (const std::exception&) {
+            // leave the host marked as lost
+        }
     }
-    auto* icmp_hdr = reinterpret_cast<icmphdr*>(recv_buf + ip_header_len);
 
-    const bool is_reply = icmp_hdr->type == ICMP_ECHOREPLY && icmp_hdr->code == 0 &&
-                          icmp_hdr->un.echo.id == htons(identifier_);
-
-    if (!is_reply) {
-        return PingResult{false, 0.0};
+    const auto echoes = engine_->echo_batch(requests, timeout);
+    for (std::size_t i = 0; i < echoes.size(); ++i) {
+        auto& result = results[request_hosts[i]];
+        result.success = echoes[i].success;
+        result.rtt_ms = echoes[i].rtt_ms;
+        result.clock_source = echoes[i].clock_source;
     }
-
-    return PingResult{true, rtt_ms};
+    return results;
 }
 
 } // namespace pingstats
-
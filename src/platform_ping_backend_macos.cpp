@@ -1,4 +1,5 @@
 #include "platform_ping_backend_macos.hpp"
+#include "icmp_checksum.hpp"
 
 #if !defined(__APPLE__)
 #error "MacOsPingBackend ist nur auf macOS verfügbar"
@@ -7,6 +8,7 @@
 #include <arpa/inet.h>
 #include <chrono>
 #include <cstddef>
+#include <cerrno>
 #include <cstring>
 #include <netdb.h>
 #include <netinet/ip.h>
@@ -14,6 +16,7 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -30,23 +33,6 @@ constexpr std::size_t kPayloadSize = 56;
 /// Total packet size (ICMP header + payload).
 constexpr std::size_t kPacketSize = sizeof(icmp) + kPayloadSize;
 
-/// Internet checksum helper for ICMP messages.
-std::uint16_t checksum(const void* data, std::size_t len) {
-    const std::uint16_t* buf = static_cast<const std::uint16_t*>(data);
-    std::uint32_t sum = 0;
-    std::size_t nwords = len / 2;
-    for (std::size_t i = 0; i < nwords; ++i) {
-        sum += buf[i];
-    }
-    if (len & 1U) {
-        sum += static_cast<const std::uint8_t*>(data)[len - 1];
-    }
-    while (sum >> 16U) {
-        sum = (sum & 0xFFFFU) + (sum >> 16U);
-    }
-    return static_cast<std::uint16_t>(~sum);
-}
-
 } // namespace
 
 MacOsPingBackend::MacOsPingBackend() = default;
@@ -63,7 +49,8 @@ void MacOsPingBackend::initialize() {
     // macOS erlaubt ICMP mit SOCK_DGRAM + IPPROTO_ICMP (erfordert root/entspr. Rechte)
     sock_fd_ = ::socket(AF_INET, SOCK_DGRAM, kIcmpProtocol);
     if (sock_fd_ < 0) {
-        throw std::runtime_error("Failed to create ICMP socket on macOS (need root/CAP_NET_RAW equivalent)");
+        throw std::system_error(errno, std::generic_category(),
+                                "Failed to create ICMP socket on macOS (need root/CAP_NET_RAW equivalent)");
     }
     identifier_ = static_cast<std::uint16_t>(::getpid() & 0xFFFF);
     sequence_ = 0;
@@ -104,7 +91,7 @@ PlatformPingBackend::PingResult MacOsPingBackend::send_ping(std::string_view hos
     icmp_hdr->icmp_seq = htons(++sequence_);
     std::memset(packet + sizeof(icmp), 0x42, kPayloadSize);
     icmp_hdr->icmp_cksum = 0;
-    icmp_hdr->icmp_cksum = checksum(packet, kPacketSize);
+    icmp_hdr->icmp_cksum = icmp_checksum(packet, kPacketSize);
 
     sockaddr_in dest{};
     std::memcpy(&dest, res->ai_addr, sizeof(sockaddr_in));
@@ -0,0 +1,434 @@
+#include "probe_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace pingstats {
+
+namespace {
+
+/// Gorilla delta-of-delta buckets: control bits and value width, tried in order.
+struct DodBucket {
+    std::uint64_t control;
+    int control_bits;
+    int value_bits;
+};
+
+constexpr DodBucket kDodBuckets[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 9},
+    {0b1110, 4, 12},
+};
+/// Control bits of the fallback bucket, followed by the raw 64-bit delta-of-delta.
+constexpr std::uint64_t kDodEscape = 0b1111;
+
+std::int64_t to_unix_ms(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+std::uint64_t zigzag(std::int64_t v)
+{
+    return (static_cast<std::uint64_t>(v) << 1U) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t v)
+{
+    return static_cast<std::int64_t>(v >> 1U) ^ -static_cast<std::int64_t>(v & 1U);
+}
+
+void write_varint(std::vector<std::uint8_t>& out, std::uint64_t v)
+{
+    while (v >= 0x80U) {
+        out.push_back(static_cast<std::uint8_t>(v | 0x80U));
+        v >>= 7U;
+    }
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+/// MSB-first reader over the timestamp column.
+class BitReader {
+public:
+    BitReader(const std::uint8_t* data, std::size_t size) : data_(data), size_bits_(size * 8) {}
+
+    std::uint64_t read(int bits)
+    {
+        if (pos_ + static_cast<std::size_t>(bits) > size_bits_) {
+            throw std::runtime_error("Truncated history timestamp column");
+        }
+        std::uint64_t value = 0;
+        for (int i = 0; i < bits; ++i, ++pos_) {
+            value = (value << 1U) | ((data_[pos_ / 8] >> (7 - pos_ % 8)) & 1U);
+        }
+        return value;
+    }
+
+private:
+    const std::uint8_t* data_;
+    std::size_t size_bits_;
+    std::size_t pos_{0};
+};
+
+std::uint64_t read_varint(const std::uint8_t*& pos, const std::uint8_t* end)
+{
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) {
+            break;
+        }
+        const std::uint8_t byte = *pos++;
+        value |= static_cast<std::uint64_t>(byte & 0x7FU) << static_cast<unsigned>(shift);
+        if ((byte & 0x80U) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed history RTT column");
+}
+
+bool is_plain_file_char(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '.' || c == '_' ||
+           c == '-';
+}
+
+}  // namespace
+
+void HistoryBlockEncoder::append(const ProbeSample& sample)
+{
+    const std::int64_t ms = to_unix_ms(sample.sent_at);
+    if (count_ == 0) {
+        first_ms_ = min_ms_ = max_ms_ = prev_ms_ = ms;
+        prev_delta_ = 0;
+        prev_rtt_us_ = 0;
+    } else {
+        const std::int64_t delta = ms - prev_ms_;
+        const std::int64_t dod = delta - prev_delta_;
+        if (dod == 0) {
+            write_bits(0, 1);
+        } else {
+            bool written = false;
+            for (const auto& bucket : kDodBuckets) {
+                const std::int64_t offset = (std::int64_t{1} << (bucket.value_bits - 1)) - 1;
+                if (dod >= -offset && dod <= offset + 1) {
+                    write_bits(bucket.control, bucket.control_bits);
+                    write_bits(static_cast<std::uint64_t>(dod + offset), bucket.value_bits);
+                    written = true;
+                    break;
+                }
+            }
+            if (!written) {
+                write_bits(kDodEscape, 4);
+                write_bits(static_cast<std::uint64_t>(dod), 64);
+            }
+        }
+        prev_delta_ = delta;
+        prev_ms_ = ms;
+        min_ms_ = std::min(min_ms_, ms);
+        max_ms_ = std::max(max_ms_, ms);
+    }
+
+    if (count_ % 8 == 0) {
+        losses_.push_back(0);
+    }
+    if (sample.success) {
+        const auto rtt_us = static_cast<std::int64_t>(std::llround(std::max(sample.rtt_ms, 0.0) * 1000.0));
+        write_varint(rtts_, zigzag(rtt_us - prev_rtt_us_));
+        prev_rtt_us_ = rtt_us;
+    } else {
+        losses_.back() |= static_cast<std::uint8_t>(1U << (count_ % 8));
+    }
+    ++count_;
+}
+
+void HistoryBlockEncoder::serialize_block(std::vector<std::uint8_t>& out) const
+{
+    HistoryBlockHeader header{};
+    std::memcpy(header.magic, kHistoryBlockMagic, sizeof(kHistoryBlockMagic));
+    header.version = kHistoryBlockVersion;
+    header.count = count_;
+    header.min_ms = min_ms_;
+    header.max_ms = max_ms_;
+    header.first_ms = first_ms_;
+    header.timestamp_bytes = static_cast<std::uint32_t>(timestamps_.size());
+    header.rtt_bytes = static_cast<std::uint32_t>(rtts_.size());
+    header.payload_bytes = static_cast<std::uint32_t>(timestamps_.size() + losses_.size() + rtts_.size());
+
+    const std::size_t start = out.size();
+    out.resize(start + sizeof(header));
+    std::memcpy(out.data() + start, &header, sizeof(header));
+    out.insert(out.end(), timestamps_.begin(), timestamps_.end());
+    out.insert(out.end(), losses_.begin(), losses_.end());
+    out.insert(out.end(), rtts_.begin(), rtts_.end());
+}
+
+void HistoryBlockEncoder::finish_block(std::vector<std::uint8_t>& out)
+{
+    serialize_block(out);
+    count_ = 0;
+    timestamps_.clear();
+    bit_fill_ = 8;
+    losses_.clear();
+    rtts_.clear();
+}
+
+void HistoryBlockEncoder::write_bits(std::uint64_t value, int bits)
+{
+    while (bits > 0) {
+        if (bit_fill_ == 8) {
+            timestamps_.push_back(0);
+            bit_fill_ = 0;
+        }
+        const int take = std::min(bits, 8 - bit_fill_);
+        const auto chunk = static_cast<std::uint8_t>((value >> (bits - take)) & ((1U << take) - 1U));
+        timestamps_.back() |= static_cast<std::uint8_t>(chunk << (8 - bit_fill_ - take));
+        bit_fill_ += take;
+        bits -= take;
+    }
+}
+
+std::vector<HistorySample> decode_history_block(const HistoryBlockHeader& header, const std::uint8_t* payload)
+{
+    const std::size_t loss_bytes = (static_cast<std::size_t>(header.count) + 7) / 8;
+    if (std::memcmp(header.magic, kHistoryBlockMagic, sizeof(kHistoryBlockMagic)) != 0 ||
+        header.version != kHistoryBlockVersion ||
+        static_cast<std::size_t>(header.timestamp_bytes) + loss_bytes + header.rtt_bytes != header.payload_bytes) {
+        throw std::runtime_error("Corrupt history block header");
+    }
+
+    std::vector<HistorySample> samples(header.count);
+    BitReader timestamps(payload, header.timestamp_bytes);
+    const std::uint8_t* losses = payload + header.timestamp_bytes;
+    const std::uint8_t* rtt_pos = losses + loss_bytes;
+    const std::uint8_t* rtt_end = rtt_pos + header.rtt_bytes;
+
+    std::int64_t ms = header.first_ms;
+    std::int64_t delta = 0;
+    std::int64_t rtt_us = 0;
+    for (std::uint32_t i = 0; i < header.count; ++i) {
+        if (i > 0) {
+            std::int64_t dod = 0;
+            if (timestamps.read(1) != 0) {
+                int control_bits = 1;
+                std::uint64_t control = 1;
+                bool decoded = false;
+                for (const auto& bucket : kDodBuckets) {
+                    control = (control << 1U) | timestamps.read(1);
+                    ++control_bits;
+                    if (control == bucket.control && control_bits == bucket.control_bits) {
+                        const std::int64_t offset = (std::int64_t{1} << (bucket.value_bits - 1)) - 1;
+                        dod = static_cast<std::int64_t>(timestamps.read(bucket.value_bits)) - offset;
+                        decoded = true;
+                        break;
+                    }
+                }
+                if (!decoded) {
+                    dod = static_cast<std::int64_t>(timestamps.read(64));
+                }
+            }
+            delta += dod;
+            ms += delta;
+        }
+        HistorySample& sample = samples[i];
+        sample.sent_unix_ms = ms;
+        sample.success = (losses[i / 8] & (1U << (i % 8))) == 0;
+        if (sample.success) {
+            rtt_us += unzigzag(read_varint(rtt_pos, rtt_end));
+            sample.rtt_ms = static_cast<double>(rtt_us) / 1000.0;
+        }
+    }
+    return samples;
+}
+
+std::string history_file_name(const std::string& host)
+{
+    static constexpr char kHex[] = "0123456789ABCDEF";
+    std::string name;
+    name.reserve(host.size() + 7);
+    for (std::size_t i = 0; i < host.size(); ++i) {
+        const char c = host[i];
+        if (is_plain_file_char(c) && !(i == 0 && c == '.')) {
+            name.push_back(c);
+        } else {
+            const auto byte = static_cast<unsigned char>(c);
+            name.push_back('%');
+            name.push_back(kHex[byte >> 4U]);
+            name.push_back(kHex[byte & 0xFU]);
+        }
+    }
+    return name + ".pshist";
+}
+
+ProbeHistoryStore::ProbeHistoryStore(std::string directory, std::uint32_t block_samples)
+    : directory_(std::move(directory)), block_samples_(std::max<std::uint32_t>(block_samples, 1))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec || !std::filesystem::is_directory(directory_)) {
+        throw std::runtime_error("Cannot create history directory: " + directory_);
+    }
+    writer_ = std::thread([this]() { writer_loop(); });
+}
+
+ProbeHistoryStore::~ProbeHistoryStore()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    writer_.join();
+}
+
+SampleSink::HostId ProbeHistoryStore::register_host(const std::string& host)
+{
+    std::unique_lock<std::shared_mutex> lock(hosts_mutex_);
+    if (auto it = host_ids_.find(host); it != host_ids_.end()) {
+        return it->second;
+    }
+    auto series = std::make_unique<HostSeries>();
+    series->path = (std::filesystem::path(directory_) / history_file_name(host)).string();
+    // A history directory is appended to across runs; new blocks start after the existing ones.
+    std::error_code ec;
+    const auto existing = std::filesystem::file_size(series->path, ec);
+    series->sealed_bytes = ec ? 0 : existing;
+    const auto id = static_cast<HostId>(hosts_.size());
+    hosts_.push_back(std::move(series));
+    host_ids_.emplace(host, id);
+    return id;
+}
+
+void ProbeHistoryStore::record(HostId host, const ProbeSample& sample)
+{
+    HostSeries* series = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(hosts_mutex_);
+        series = hosts_.at(host).get();
+    }
+    std::lock_guard<std::mutex> lock(series->mutex);
+    series->encoder.append(sample);
+    if (series->encoder.count() >= block_samples_) {
+        queue_block(*series, true);
+    }
+}
+
+void ProbeHistoryStore::flush()
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(hosts_mutex_);
+        for (const auto& series : hosts_) {
+            std::lock_guard<std::mutex> series_lock(series->mutex);
+            if (series->encoder.count() > series->queued_count) {
+                queue_block(*series, false);
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    const std::uint64_t target = queued_blocks_;
+    queue_cv_.wait(lock, [&]() { return written_blocks_ >= target; });
+}
+
+void ProbeHistoryStore::queue_block(HostSeries& series, bool sealed)
+{
+    PendingBlock block{&series, {}, sealed};
+    if (sealed) {
+        series.encoder.finish_block(block.bytes);
+        series.queued_count = 0;
+    } else {
+        series.encoder.serialize_block(block.bytes);
+        series.queued_count = series.encoder.count();
+    }
+    // Queued under series.mutex, so the blocks of one host reach the writer in order.
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_.push_back(std::move(block));
+        ++queued_blocks_;
+    }
+    queue_cv_.notify_all();
+}
+
+void ProbeHistoryStore::writer_loop()
+{
+    std::deque<PendingBlock> batch;
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (true) {
+        queue_cv_.wait(lock, [&]() { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        batch.swap(queue_);
+        lock.unlock();
+        for (auto& block : batch) {
+            write_block(block);
+        }
+        const auto written = batch.size();
+        batch.clear();
+        lock.lock();
+        written_blocks_ += written;
+        queue_cv_.notify_all();
+    }
+}
+
+void ProbeHistoryStore::write_block(PendingBlock& block)
+{
+    HostSeries& series = *block.series;
+    // An open block only grows, so rewriting it in place never leaves stale bytes behind.
+    std::fstream file(series.path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        std::ofstream(series.path, std::ios::binary | std::ios::app);
+        file.open(series.path, std::ios::binary | std::ios::in | std::ios::out);
+    }
+    file.seekp(static_cast<std::streamoff>(series.sealed_bytes));
+    file.write(reinterpret_cast<const char*>(block.bytes.data()), static_cast<std::streamsize>(block.bytes.size()));
+    file.flush();
+    if (!file) {
+        std::cerr << "History write error: " << series.path << std::endl;
+        return;
+    }
+    if (block.sealed) {
+        series.sealed_bytes += block.bytes.size();
+    }
+}
+
+std::vector<HistorySample> read_probe_history(const std::string& directory,
+                                              const std::string& host,
+                                              std::chrono::system_clock::time_point from,
+                                              std::chrono::system_clock::time_point to)
+{
+    std::vector<HistorySample> result;
+    std::ifstream ifs(std::filesystem::path(directory) / history_file_name(host), std::ios::binary);
+    if (!ifs) {
+        return result;
+    }
+    const std::int64_t from_ms = to_unix_ms(from);
+    const std::int64_t to_ms = to_unix_ms(to);
+    std::vector<std::uint8_t> payload;
+    HistoryBlockHeader header{};
+    while (ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        if (std::memcmp(header.magic, kHistoryBlockMagic, sizeof(kHistoryBlockMagic)) != 0) {
+            throw std::runtime_error("Corrupt history file for host " + host);
+        }
+        if (header.max_ms < from_ms || header.min_ms > to_ms) {
+            ifs.seekg(header.payload_bytes, std::ios::cur);
+            continue;
+        }
+        payload.resize(header.payload_bytes);
+        if (!ifs.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()))) {
+            break;
+        }
+        for (const auto& sample : decode_history_block(header, payload.data())) {
+            if (sample.sent_unix_ms >= from_ms && sample.sent_unix_ms <= to_ms) {
+                result.push_back(sample);
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace pingstats
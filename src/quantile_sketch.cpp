@@ -0,0 +1,144 @@
+#include "quantile_sketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace pingstats {
+
+namespace {
+/// Values at or below this are not worth a logarithmic bin and are counted as zero.
+constexpr double kMinIndexableValue = 1e-9;
+}
+
+/// gamma = (1 + a) / (1 - a) makes every bin [gamma^(i-1), gamma^i] at most 2a wide relative to
+/// its midpoint estimate 2 * gamma^i / (gamma + 1).
+QuantileSketch::QuantileSketch(double relative_accuracy, std::size_t max_bins)
+    : relative_accuracy_(relative_accuracy), max_bins_(std::max<std::size_t>(max_bins, 1))
+{
+    if (!(relative_accuracy > 0.0 && relative_accuracy < 1.0)) {
+        throw std::invalid_argument("QuantileSketch relative accuracy must be in (0, 1)");
+    }
+    const double gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+    log_gamma_ = std::log(gamma);
+    midpoint_factor_ = 2.0 / (1.0 + gamma);
+}
+
+void QuantileSketch::add(double value)
+{
+    ++count_;
+    if (!(value > kMinIndexableValue)) {
+        ++zero_count_;
+        return;
+    }
+    add_to_bin(index_for(value), 1);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    if (other.relative_accuracy_ != relative_accuracy_) {
+        throw std::invalid_argument("Cannot merge QuantileSketch instances with different accuracy");
+    }
+    zero_count_ += other.zero_count_;
+    count_ += other.count_;
+    for (std::size_t i = 0; i < other.bins_.size(); ++i) {
+        if (other.bins_[i] != 0) {
+            add_to_bin(other.offset_ + static_cast<int>(i), other.bins_[i]);
+        }
+    }
+}
+
+/// Mirrors the classic median of an even-sized sample by interpolating between the two ranks
+/// that straddle q * (count - 1).
+double QuantileSketch::quantile(double q) const
+{
+    if (count_ == 0) {
+        return 0.0;
+    }
+    const double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(count_ - 1);
+    const auto lower_rank = static_cast<std::uint64_t>(std::floor(rank));
+    const double lower = value_at_rank(lower_rank);
+    const double fraction = rank - static_cast<double>(lower_rank);
+    if (fraction <= 0.0) {
+        return lower;
+    }
+    const double upper = value_at_rank(lower_rank + 1);
+    return lower + (upper - lower) * fraction;
+}
+
+void QuantileSketch::clear()
+{
+    bins_.clear();
+    offset_ = 0;
+    zero_count_ = 0;
+    count_ = 0;
+}
+
+/// Bins stay one dense vector. When the range would exceed max_bins_, the lowest bins are folded
+/// together, so accuracy is only ever lost at the fast end where it matters least.
+void QuantileSketch::add_to_bin(int index, std::uint64_t n)
+{
+    if (bins_.empty()) {
+        offset_ = index;
+        bins_.assign(1, 0);
+    }
+
+    if (index < offset_) {
+        const auto grow = static_cast<std::size_t>(offset_ - index);
+        if (bins_.size() + grow > max_bins_) {
+            bins_.front() += n;  // below the collapsed floor
+            return;
+        }
+        bins_.insert(bins_.begin(), grow, 0);
+        offset_ = index;
+    } else if (static_cast<std::size_t>(index - offset_) >= bins_.size()) {
+        const auto new_size = static_cast<std::size_t>(index - offset_) + 1;
+        if (new_size > max_bins_) {
+            const std::size_t overflow = new_size - max_bins_;
+            if (overflow >= bins_.size()) {
+                const std::uint64_t total = std::accumulate(bins_.begin(), bins_.end(), std::uint64_t{0});
+                bins_.assign(max_bins_, 0);
+                bins_.front() = total;
+            } else {
+                const std::uint64_t folded =
+                    std::accumulate(bins_.begin(), bins_.begin() + static_cast<std::ptrdiff_t>(overflow),
+                                    std::uint64_t{0});
+                bins_.erase(bins_.begin(), bins_.begin() + static_cast<std::ptrdiff_t>(overflow));
+                bins_.front() += folded;
+                bins_.resize(max_bins_, 0);
+            }
+            offset_ = index - static_cast<int>(max_bins_) + 1;
+        } else {
+            bins_.resize(new_size, 0);
+        }
+    }
+    bins_[static_cast<std::size_t>(index - offset_)] += n;
+}
+
+double QuantileSketch::value_at_rank(std::uint64_t rank) const
+{
+    if (rank < zero_count_) {
+        return 0.0;
+    }
+    std::uint64_t seen = zero_count_;
+    for (std::size_t i = 0; i < bins_.size(); ++i) {
+        seen += bins_[i];
+        if (seen > rank) {
+            return value_for(offset_ + static_cast<int>(i));
+        }
+    }
+    return bins_.empty() ? 0.0 : value_for(offset_ + static_cast<int>(bins_.size()) - 1);
+}
+
+int QuantileSketch::index_for(double value) const
+{
+    return static_cast<int>(std::ceil(std::log(value) / log_gamma_));
+}
+
+double QuantileSketch::value_for(int index) const
+{
+    return std::exp(static_cast<double>(index) * log_gamma_) * midpoint_factor_;
+}
+
+}  // namespace pingstats
@@ -0,0 +1,373 @@
+#include "raw_sample_log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pingstats {
+
+#if defined(_WIN32)
+
+// The log relies on POSIX file mappings that may extend past the end of the file.
+RawSampleLog::RawSampleLog(const std::string& path) : RawSampleLog(path, Options{}) {}
+
+RawSampleLog::RawSampleLog(const std::string& path, Options options) : path_(path), options_(options)
+{
+    throw std::runtime_error("Raw sample logs are not supported on Windows");
+}
+
+RawSampleLog::~RawSampleLog() = default;
+SampleSink::HostId RawSampleLog::register_host(const std::string&) { return 0; }
+void RawSampleLog::record(HostId, const ProbeSample&) {}
+void RawSampleLog::flush() {}
+
+RawSampleLogView::RawSampleLogView(const std::string&)
+{
+    throw std::runtime_error("Raw sample logs are not supported on Windows");
+}
+
+RawSampleLogView::~RawSampleLogView() = default;
+
+#else
+
+namespace {
+
+constexpr std::uint64_t kPageBytes = 4096;
+constexpr std::uint64_t kRecordBytes = sizeof(RawSampleRecord);
+/// Dictionary entry prefix: host id and name length.
+constexpr std::uint64_t kEntryHeaderBytes = 8;
+
+std::uint64_t round_up(std::uint64_t value, std::uint64_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+[[noreturn]] void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// Reject files that are not raw sample logs or whose regions do not fit the file.
+void validate_header(const RawSampleLogHeader& header, std::uint64_t file_size, const std::string& path)
+{
+    if (std::memcmp(header.magic, kRawLogMagic, sizeof(kRawLogMagic)) != 0) {
+        throw std::runtime_error("Not a raw sample log: " + path);
+    }
+    if (header.version != kRawLogVersion || header.record_size != kRecordBytes) {
+        throw std::runtime_error("Unsupported raw sample log version or record size: " + path);
+    }
+    if (header.dictionary_offset < kRawLogHeaderBytes ||
+        header.dictionary_used > header.dictionary_capacity ||
+        header.records_offset < header.dictionary_offset + header.dictionary_capacity ||
+        header.records_offset % kPageBytes != 0 || file_size < header.records_offset) {
+        throw std::runtime_error("Corrupt raw sample log header: " + path);
+    }
+}
+
+/// Walk the dictionary entries and hand each (id, name) to fn; throws on malformed entries.
+template <typename Fn>
+void for_each_dictionary_entry(const std::uint8_t* base, const RawSampleLogHeader& header, Fn&& fn)
+{
+    const std::uint8_t* entry = base + header.dictionary_offset;
+    const std::uint8_t* end = entry + header.dictionary_used;
+    while (entry < end) {
+        std::uint32_t id = 0;
+        std::uint32_t length = 0;
+        std::memcpy(&id, entry, sizeof(id));
+        std::memcpy(&length, entry + sizeof(id), sizeof(length));
+        const std::uint64_t entry_bytes = round_up(kEntryHeaderBytes + length, 8);
+        if (entry_bytes > static_cast<std::uint64_t>(end - entry) || id >= header.host_count) {
+            throw std::runtime_error("Corrupt raw sample log dictionary");
+        }
+        fn(id, std::string(reinterpret_cast<const char*>(entry + kEntryHeaderBytes), length));
+        entry += entry_bytes;
+    }
+}
+
+std::int64_t unix_ns(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+}  // namespace
+
+RawSampleLog::RawSampleLog(const std::string& path) : RawSampleLog(path, Options{}) {}
+
+RawSampleLog::RawSampleLog(const std::string& path, Options options) : path_(path), options_(options)
+{
+    if (options_.grow_records == 0 || options_.max_records == 0 || options_.dictionary_bytes == 0) {
+        throw std::invalid_argument("Raw sample log options must be non-zero");
+    }
+    if (options_.max_records > kRawLogMaxRecords) {
+        throw std::invalid_argument("Raw sample log max_records must not exceed " + std::to_string(kRawLogMaxRecords));
+    }
+    chunk_records_ = std::bit_ceil(std::clamp(options_.grow_records, kPageBytes / kRecordBytes, kRawLogMaxRecords));
+    chunk_shift_ = static_cast<unsigned>(std::countr_zero(chunk_records_));
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw_errno("Failed to open raw sample log " + path_);
+    }
+    try {
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0) {
+            throw_errno("Failed to stat raw sample log " + path_);
+        }
+        if (st.st_size == 0) {
+            create_log(unix_ns(std::chrono::system_clock::now()));
+        } else {
+            open_log(static_cast<std::uint64_t>(st.st_size));
+        }
+    } catch (...) {
+        unmap_all();
+        ::close(fd_);
+        throw;
+    }
+}
+
+/// Runs after the last record() returned (sessions and callbacks hold the sink), so every slot
+/// below the record count is committed and the preallocated tail can be trimmed.
+RawSampleLog::~RawSampleLog()
+{
+    flush();
+    const std::uint64_t records_offset = header().records_offset;
+    const std::uint64_t count = header().record_count;
+    sync(MS_SYNC);
+    unmap_all();
+    // Best effort: an untrimmed, zero-filled tail only holds uncommitted slots readers skip.
+    [[maybe_unused]] const int trimmed = ::ftruncate(fd_, static_cast<off_t>(records_offset + count * kRecordBytes));
+    ::close(fd_);
+}
+
+SampleSink::HostId RawSampleLog::register_host(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = host_ids_.find(host); it != host_ids_.end()) {
+        return it->second;
+    }
+    RawSampleLogHeader& hdr = header();
+    const std::uint64_t entry_bytes = round_up(kEntryHeaderBytes + host.size(), 8);
+    if (hdr.dictionary_used + entry_bytes > hdr.dictionary_capacity) {
+        throw std::runtime_error("Raw sample log host dictionary is full: " + path_);
+    }
+    const auto id = static_cast<HostId>(hdr.host_count);
+    const auto length = static_cast<std::uint32_t>(host.size());
+    std::uint8_t* entry = base_ + hdr.dictionary_offset + hdr.dictionary_used;
+    std::memcpy(entry, &id, sizeof(id));
+    std::memcpy(entry + sizeof(id), &length, sizeof(length));
+    std::memcpy(entry + kEntryHeaderBytes, host.data(), host.size());
+    hdr.host_count = id + 1;
+    std::atomic_ref<std::uint64_t>(hdr.dictionary_used).store(hdr.dictionary_used + entry_bytes,
+                                                              std::memory_order_release);
+    host_ids_.emplace(host, id);
+    return id;
+}
+
+void RawSampleLog::record(HostId host, const ProbeSample& sample)
+{
+    const std::uint64_t index = next_record_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= capacity_.load(std::memory_order_acquire) && !grow_to(index)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    RawSampleRecord& slot = record_at(index);
+    slot.sent_unix_ns = unix_ns(sample.sent_at);
+    slot.rtt_ms = sample.rtt_ms;
+    slot.host_id = host;
+    slot.sequence = sample.sequence;
+    slot.reserved = 0;
+    const std::uint32_t flags = kRawRecordCommitted | (sample.success ? kRawRecordSuccess : 0U);
+    std::atomic_ref<std::uint32_t>(slot.flags).store(flags, std::memory_order_release);
+}
+
+void RawSampleLog::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::uint64_t capacity = capacity_.load(std::memory_order_relaxed);
+    const std::uint64_t count = std::min(next_record_.load(std::memory_order_relaxed), capacity);
+    std::atomic_ref<std::uint64_t>(header().record_count).store(count, std::memory_order_release);
+    sync(MS_ASYNC);
+}
+
+void RawSampleLog::create_log(std::int64_t created_unix_ns)
+{
+    const std::uint64_t dictionary_capacity = round_up(options_.dictionary_bytes, kPageBytes);
+    const std::uint64_t records_offset = kRawLogHeaderBytes + dictionary_capacity;
+    const std::uint64_t capacity = std::min(options_.grow_records, options_.max_records);
+    if (::ftruncate(fd_, static_cast<off_t>(records_offset + capacity * kRecordBytes)) != 0) {
+        throw_errno("Failed to size raw sample log " + path_);
+    }
+    max_records_ = options_.max_records;
+    map_header(records_offset);
+
+    RawSampleLogHeader hdr{};
+    std::memcpy(hdr.magic, kRawLogMagic, sizeof(kRawLogMagic));
+    hdr.version = kRawLogVersion;
+    hdr.record_size = kRecordBytes;
+    hdr.dictionary_offset = kRawLogHeaderBytes;
+    hdr.dictionary_capacity = dictionary_capacity;
+    hdr.records_offset = records_offset;
+    hdr.created_unix_ns = created_unix_ns;
+    std::memcpy(base_, &hdr, sizeof(hdr));
+    if (!map_chunks(capacity)) {
+        throw_errno("Failed to map raw sample log " + path_);
+    }
+    capacity_.store(capacity);
+}
+
+/// The append position is one past the last committed slot: slots between the flushed record
+/// count and the end of the file may have been reserved but never written before a crash.
+void RawSampleLog::open_log(std::uint64_t file_size)
+{
+    RawSampleLogHeader hdr{};
+    if (file_size < kRawLogHeaderBytes ||
+        ::pread(fd_, &hdr, sizeof(hdr), 0) != static_cast<ssize_t>(sizeof(hdr))) {
+        throw std::runtime_error("Not a raw sample log: " + path_);
+    }
+    validate_header(hdr, file_size, path_);
+    const std::uint64_t capacity = (file_size - hdr.records_offset) / kRecordBytes;
+    max_records_ = std::max(options_.max_records, capacity);
+    map_header(hdr.records_offset);
+
+    for_each_dictionary_entry(base_, hdr, [this](std::uint32_t id, std::string name) {
+        host_ids_.emplace(std::move(name), id);
+    });
+    if (!map_chunks(capacity)) {
+        throw_errno("Failed to map raw sample log " + path_);
+    }
+
+    std::uint64_t next = std::min(hdr.record_count, capacity);
+    for (std::uint64_t i = capacity; i > next; --i) {
+        if (record_at(i - 1).flags & kRawRecordCommitted) {
+            next = i;
+            break;
+        }
+    }
+    next_record_.store(next);
+    capacity_.store(capacity);
+}
+
+bool RawSampleLog::grow_to(std::uint64_t index)
+{
+    if (index >= max_records_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint64_t capacity = capacity_.load(std::memory_order_relaxed);
+    if (index < capacity) {
+        return true;
+    }
+    while (capacity <= index) {
+        capacity += options_.grow_records;
+    }
+    capacity = std::min(capacity, max_records_);
+    if (::ftruncate(fd_, static_cast<off_t>(header().records_offset + capacity * kRecordBytes)) != 0 ||
+        !map_chunks(capacity)) {
+        return false;
+    }
+    capacity_.store(capacity, std::memory_order_release);
+    return true;
+}
+
+void RawSampleLog::map_header(std::uint64_t records_offset)
+{
+    void* addr = ::mmap(nullptr, records_offset, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED) {
+        throw_errno("Failed to map raw sample log " + path_);
+    }
+    base_ = static_cast<std::uint8_t*>(addr);
+    base_bytes_ = records_offset;
+    chunk_count_ = (max_records_ + chunk_records_ - 1) >> chunk_shift_;
+    chunks_ = std::make_unique<std::atomic<RawSampleRecord*>[]>(chunk_count_);
+}
+
+/// A chunk may extend past the end of the file; only its slots below capacity_ are touched.
+/// Chunks are published before capacity_, so record() never sees a slot without its mapping.
+bool RawSampleLog::map_chunks(std::uint64_t capacity)
+{
+    const std::uint64_t chunk_bytes = chunk_records_ * kRecordBytes;
+    const std::uint64_t needed = std::min((capacity + chunk_records_ - 1) >> chunk_shift_, chunk_count_);
+    for (; mapped_chunks_ < needed; ++mapped_chunks_) {
+        const auto offset = static_cast<off_t>(header().records_offset + mapped_chunks_ * chunk_bytes);
+        void* addr = ::mmap(nullptr, chunk_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        chunks_[mapped_chunks_].store(static_cast<RawSampleRecord*>(addr), std::memory_order_release);
+    }
+    return true;
+}
+
+void RawSampleLog::sync(int flags) const
+{
+    ::msync(base_, base_bytes_, flags);
+    std::uint64_t remaining = capacity_.load(std::memory_order_acquire);
+    for (std::uint64_t i = 0; i < mapped_chunks_ && remaining != 0; ++i) {
+        const std::uint64_t slots = std::min(remaining, chunk_records_);
+        ::msync(chunks_[i].load(std::memory_order_relaxed), slots * kRecordBytes, flags);
+        remaining -= slots;
+    }
+}
+
+void RawSampleLog::unmap_all()
+{
+    for (std::uint64_t i = 0; i < mapped_chunks_; ++i) {
+        ::munmap(chunks_[i].load(std::memory_order_relaxed), chunk_records_ * kRecordBytes);
+    }
+    mapped_chunks_ = 0;
+    if (base_ != nullptr) {
+        ::munmap(base_, base_bytes_);
+        base_ = nullptr;
+    }
+}
+
+RawSampleLogView::RawSampleLogView(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("Failed to open raw sample log " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < kRawLogHeaderBytes) {
+        ::close(fd);
+        throw std::runtime_error("Not a raw sample log: " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw_errno("Failed to map raw sample log " + path);
+    }
+    base_ = static_cast<const std::uint8_t*>(addr);
+    try {
+        validate_header(header(), size_, path);
+        hosts_.resize(header().host_count);
+        for_each_dictionary_entry(base_, header(), [this](std::uint32_t id, std::string name) {
+            hosts_[id] = std::move(name);
+        });
+    } catch (...) {
+        ::munmap(const_cast<std::uint8_t*>(base_), size_);
+        throw;
+    }
+    record_slots_ = (size_ - header().records_offset) / kRecordBytes;
+}
+
+RawSampleLogView::~RawSampleLogView()
+{
+    ::munmap(const_cast<std::uint8_t*>(base_), size_);
+}
+
+#endif
+
+}  // namespace pingstats
@@ -0,0 +1,100 @@
+#include "rolling_window.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace pingstats {
+
+RollingWindow::RollingWindow(std::chrono::seconds slot_width, std::size_t slot_count)
+    : slot_width_(slot_width), slots_(slot_count)
+{
+    if (slot_width.count() <= 0 || slot_count == 0) {
+        throw std::invalid_argument("RollingWindow needs a positive slot width and at least one slot");
+    }
+}
+
+std::int64_t RollingWindow::epoch_for(Clock::time_point now) const
+{
+    return static_cast<std::int64_t>(now.time_since_epoch() / slot_width_);
+}
+
+void RollingWindow::reset_slot(Slot& slot, std::int64_t epoch)
+{
+    slot.epoch = epoch;
+    slot.sent = 0;
+    slot.success = 0;
+    slot.sum_ms = 0.0;
+    slot.min_ms = std::numeric_limits<double>::infinity();
+    slot.max_ms = -std::numeric_limits<double>::infinity();
+    slot.quantiles.clear();
+}
+
+/// A slot still holding an older interval is reset before it takes the new sample.
+void RollingWindow::add(Clock::time_point now, double rtt_ms, bool success)
+{
+    const std::int64_t epoch = epoch_for(now);
+    Slot& slot = slots_[static_cast<std::size_t>(epoch) % slots_.size()];
+    if (slot.epoch != epoch) {
+        reset_slot(slot, epoch);
+    }
+    ++slot.sent;
+    if (!success) {
+        return;
+    }
+    ++slot.success;
+    slot.sum_ms += rtt_ms;
+    slot.min_ms = std::min(slot.min_ms, rtt_ms);
+    slot.max_ms = std::max(slot.max_ms, rtt_ms);
+    slot.quantiles.add(rtt_ms);
+}
+
+/// Slots are selected by epoch rather than position, so stale slots that were never recycled
+/// (no samples for a while) are skipped.
+WindowSummary RollingWindow::summarize(Clock::time_point now, std::chrono::seconds span) const
+{
+    const auto span_slots = static_cast<std::int64_t>(
+        std::min<std::size_t>(slots_.size(),
+                              static_cast<std::size_t>((span + slot_width_ - std::chrono::nanoseconds{1}) / slot_width_)));
+    const std::int64_t newest = epoch_for(now);
+    const std::int64_t oldest = newest - span_slots + 1;
+
+    WindowSummary summary;
+    std::size_t success = 0;
+    double sum_ms = 0.0;
+    double min_ms = std::numeric_limits<double>::infinity();
+    double max_ms = -std::numeric_limits<double>::infinity();
+    QuantileSketch merged;
+    for (const Slot& slot : slots_) {
+        if (slot.epoch < oldest || slot.epoch > newest) {
+            continue;
+        }
+        summary.count += slot.sent;
+        success += slot.success;
+        sum_ms += slot.sum_ms;
+        min_ms = std::min(min_ms, slot.min_ms);
+        max_ms = std::max(max_ms, slot.max_ms);
+        merged.merge(slot.quantiles);
+    }
+
+    if (summary.count != 0) {
+        summary.loss_ratio = static_cast<double>(summary.count - success) / static_cast<double>(summary.count);
+    }
+    if (success != 0) {
+        summary.min_ms = min_ms;
+        summary.max_ms = max_ms;
+        summary.mean_ms = sum_ms / static_cast<double>(success);
+        summary.median_ms = std::clamp(merged.quantile(0.5), min_ms, max_ms);
+        summary.p95_ms = std::clamp(merged.quantile(0.95), min_ms, max_ms);
+        summary.p99_ms = std::clamp(merged.quantile(0.99), min_ms, max_ms);
+    }
+    return summary;
+}
+
+void RollingWindow::clear()
+{
+    for (Slot& slot : slots_) {
+        reset_slot(slot, -1);
+    }
+}
+
+}  // namespace pingstats
@@ -0,0 +1,189 @@
+#include "sample_ingestor.hpp"
+
+#include <utility>
+
+namespace pingstats {
+
+namespace {
+/// Records taken from one lane per pass, so a busy producer cannot starve the others.
+constexpr std::size_t kDrainBatch = 256;
+/// Ingest thread sleep when every lane was empty; bounds how stale snapshots can be. flush()
+/// polls at the same interval.
+constexpr auto kIdleWait = std::chrono::milliseconds{1};
+
+/// Source of ingestor ids; zero is never handed out.
+std::atomic<std::uint64_t> next_ingestor_id{1};
+
+/// Lane of the current thread for one ingestor. Ids are never reused, so an entry of a destroyed
+/// ingestor can never match; it is recognised by being the lane's last owner and pruned.
+template <typename Lane>
+struct CachedLane {
+    std::uint64_t ingestor_id;
+    std::shared_ptr<Lane> lane;
+};
+}  // namespace
+
+SampleIngestor::SampleIngestor(std::shared_ptr<StatisticsAggregator> aggregator, std::size_t lane_capacity)
+    : aggregator_(std::move(aggregator)),
+      lane_capacity_(lane_capacity),
+      id_(next_ingestor_id.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+SampleIngestor::~SampleIngestor()
+{
+    stop();
+}
+
+void SampleIngestor::start()
+{
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        lanes_closed_ = false;
+        for (const auto& lane : lanes_) {
+            lane->closed.store(false, std::memory_order_seq_cst);
+        }
+    }
+    worker_ = std::thread(&SampleIngestor::ingest_loop, this);
+}
+
+/// After the join this thread is the only consumer. Closing the lanes stops new pushes; a push
+/// that passed its closed check before that is still in flight, so draining continues until no
+/// lane is pushing and every lane is empty.
+void SampleIngestor::stop()
+{
+    bool expected = true;
+    if (!running_.compare_exchange_strong(expected, false)) {
+        return;
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    std::vector<std::shared_ptr<Lane>> lanes;
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        lanes_closed_ = true;
+        for (const auto& lane : lanes_) {
+            lane->closed.store(true, std::memory_order_seq_cst);
+        }
+        lanes = lanes_;
+    }
+    for (;;) {
+        drain_lanes(lanes);
+        bool settled = true;
+        for (const auto& lane : lanes) {
+            // pushing is checked first: once it reads false, that push is visible to empty().
+            if (lane->pushing.load(std::memory_order_seq_cst) || !lane->queue.empty()) {
+                settled = false;
+                break;
+            }
+        }
+        if (settled) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+/// pushing and closed form a store-then-load handshake with stop(): either stop() sees this push
+/// in flight and drains it, or this thread sees the lane closed and applies the record itself.
+void SampleIngestor::submit(const SampleRecord& record)
+{
+    if (running_.load(std::memory_order_acquire)) {
+        Lane& lane = lane_for_current_thread();
+        lane.pushing.store(true, std::memory_order_seq_cst);
+        if (!lane.closed.load(std::memory_order_seq_cst)) {
+            while (!lane.queue.try_push(record)) {
+                std::this_thread::yield();
+            }
+            lane.pushing.store(false, std::memory_order_seq_cst);
+            return;
+        }
+        lane.pushing.store(false, std::memory_order_seq_cst);
+    }
+    aggregator_->add_sample(record.host, record.rtt_ms, record.success, record.measured_at);
+}
+
+/// Each lane's push count at entry is the target, so producers that keep submitting cannot
+/// extend the wait.
+bool SampleIngestor::flush(std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<std::pair<std::shared_ptr<Lane>, std::size_t>> targets;
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        targets.reserve(lanes_.size());
+        for (const auto& lane : lanes_) {
+            targets.emplace_back(lane, lane->queue.pushed());
+        }
+    }
+    for (const auto& [lane, target] : targets) {
+        while (lane->queue.consumed() < target && running_.load(std::memory_order_acquire)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(kIdleWait);
+        }
+    }
+    return true;
+}
+
+/// Per-thread lookup over a handful of entries, so a linear scan beats any map. The mutex is only
+/// taken the first time a thread submits to this ingestor; that miss also prunes the entries of
+/// ingestors that have been destroyed.
+SampleIngestor::Lane& SampleIngestor::lane_for_current_thread()
+{
+    thread_local std::vector<CachedLane<Lane>> thread_lanes;
+    for (const auto& cached : thread_lanes) {
+        if (cached.ingestor_id == id_) {
+            return *cached.lane;
+        }
+    }
+    std::erase_if(thread_lanes, [](const CachedLane<Lane>& cached) { return cached.lane.use_count() == 1; });
+
+    auto lane = std::make_shared<Lane>(lane_capacity_);
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        lane->closed.store(lanes_closed_, std::memory_order_relaxed);
+        lanes_.push_back(lane);
+        lanes_version_.fetch_add(1, std::memory_order_release);
+    }
+    thread_lanes.push_back(CachedLane<Lane>{id_, lane});
+    return *lane;
+}
+
+void SampleIngestor::ingest_loop()
+{
+    std::vector<std::shared_ptr<Lane>> lanes;
+    std::uint64_t seen_version = 0;
+    while (running_.load(std::memory_order_acquire)) {
+        const std::uint64_t version = lanes_version_.load(std::memory_order_acquire);
+        if (version != seen_version) {
+            std::lock_guard<std::mutex> lock(lanes_mutex_);
+            lanes = lanes_;
+            seen_version = version;
+        }
+        if (drain_lanes(lanes) == 0) {
+            std::this_thread::sleep_for(kIdleWait);
+        }
+    }
+}
+
+std::size_t SampleIngestor::drain_lanes(std::vector<std::shared_ptr<Lane>>& lanes)
+{
+    std::size_t applied = 0;
+    for (const auto& lane : lanes) {
+        applied += lane->queue.consume(
+            [this](const SampleRecord& record) {
+                aggregator_->add_sample(record.host, record.rtt_ms, record.success, record.measured_at);
+            },
+            kDrainBatch);
+    }
+    return applied;
+}
+
+}  // namespace pingstats
@@ -0,0 +1,70 @@
+#include "sample_sink.hpp"
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace pingstats {
+
+namespace {
+
+/// Hands out its own host ids and maps each to the ids the wrapped sinks assigned.
+class SampleSinkFanout final : public SampleSink {
+public:
+    explicit SampleSinkFanout(std::vector<std::shared_ptr<SampleSink>> sinks) : sinks_(std::move(sinks)) {}
+
+    HostId register_host(const std::string& host) override
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (auto it = host_ids_.find(host); it != host_ids_.end()) {
+            return it->second;
+        }
+        std::vector<HostId> ids;
+        ids.reserve(sinks_.size());
+        for (const auto& sink : sinks_) {
+            ids.push_back(sink->register_host(host));
+        }
+        const auto id = static_cast<HostId>(sink_ids_.size());
+        sink_ids_.push_back(std::move(ids));
+        host_ids_.emplace(host, id);
+        return id;
+    }
+
+    void record(HostId host, const ProbeSample& sample) override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const auto& ids = sink_ids_.at(host);
+        for (std::size_t i = 0; i < sinks_.size(); ++i) {
+            sinks_[i]->record(ids[i], sample);
+        }
+    }
+
+    void flush() override
+    {
+        for (const auto& sink : sinks_) {
+            sink->flush();
+        }
+    }
+
+private:
+    std::vector<std::shared_ptr<SampleSink>> sinks_;
+    std::shared_mutex mutex_;
+    std::vector<std::vector<HostId>> sink_ids_;
+    std::unordered_map<std::string, HostId> host_ids_;
+};
+
+}  // namespace
+
+std::shared_ptr<SampleSink> make_sample_sink_fanout(std::vector<std::shared_ptr<SampleSink>> sinks)
+{
+    if (sinks.empty()) {
+        return nullptr;
+    }
+    if (sinks.size() == 1) {
+        return std::move(sinks.front());
+    }
+    return std::make_shared<SampleSinkFanout>(std::move(sinks));
+}
+
+}  // namespace pingstats
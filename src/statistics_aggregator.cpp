@@ -1,10 +1,23 @@
 #include "statistics_aggregator_impl.hpp"
+#include "bucket_boundaries.hpp"
+#include "fixed_ring_buffer.hpp"
+#include "log_linear_histogram.hpp"
+#include "quantile_sketch.hpp"
+#include "rolling_window.hpp"
 
 #include <algorithm>
-#include <deque>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -12,12 +25,28 @@
 namespace pingstats {
 
 namespace {
-/// Max samples retained for median computation; keeps nth_element bounded.
-constexpr std::size_t kMedianCapacity = 1024;
 /// Max samples retained for recent RTT sparkline rendering.
 constexpr std::size_t kRecentCapacity = 256;
-/// Default histogram bucket boundaries in milliseconds.
-const std::vector<double> kDefaultBoundaries{10.0, 20.0, 50.0, 100.0, 200.0, 500.0};
+/// Number of independently locked host-map shards; a power of two so selection is a mask.
+constexpr std::size_t kShardCount = 64;
+/// Number of change flags hosts are spread over by handle; a power of two so selection is a mask.
+constexpr std::size_t kDirtyFlagCount = 16;
+/// Host entries per dense storage chunk (power of two; a handle splits into chunk and slot).
+constexpr std::uint32_t kChunkBits = 8;
+constexpr std::uint32_t kChunkSize = 1U << kChunkBits;
+/// Chunk table size; bounds the number of distinct hosts to kMaxChunks * kChunkSize.
+constexpr std::uint32_t kMaxChunks = 4096;
+/// Spans of the rolling windows reported in every snapshot.
+constexpr std::chrono::seconds kWindowShort{60};
+constexpr std::chrono::seconds kWindowMedium{300};
+constexpr std::chrono::seconds kWindowLong{900};
+
+/// Published sets older than this are rebuilt even without new samples: the rolling windows
+/// only shift once per slot, so this keeps them current without rebuilding every read.
+constexpr auto kPublishedWindowRefresh = RollingWindow::kDefaultSlotWidth;
+
+/// Log-linear histograms count integer microseconds.
+constexpr double kMicrosPerMs = 1000.0;
 
 /// Ensure RTTs are non-negative to avoid skewing aggregates.
 double clamp_non_negative(double value)
@@ -36,22 +65,216 @@ struct StatisticsAggregatorImpl::Impl {
         double min_ms{std::numeric_limits<double>::infinity()};
         double max_ms{-std::numeric_limits<double>::infinity()};
         double sum_ms{0.0};
-        std::deque<double> median_buffer;
-        std::deque<double> recent_rtts;
+        QuantileSketch rtt_quantiles;
+        /// Present in log-linear mode, replacing boundaries/histogram_counts.
+        std::optional<LogLinearHistogram> fine_histogram;
 
+        HostStats() = default;
         HostStats(std::string h, const std::vector<double>& bounds)
             : host(std::move(h)), boundaries(bounds), histogram_counts(bounds.size() + 1, 0)
         {
         }
+        HostStats(std::string h, const LogLinearHistogram& histogram)
+            : host(std::move(h)), fine_histogram(histogram)
+        {
+        }
+    };
+
+    /// Per-host state with its own lock so writers to different hosts never contend.
+    struct HostEntry {
+        mutable std::mutex mutex;
+        HostStats stats;
+        /// Emplaced at registration, like recent_rtts below. Both are kept out of HostStats so
+        /// snapshots read them in place instead of copying them twice.
+        std::optional<RollingWindow> window;
+        /// Latest successful RTTs for sparkline rendering; allocated once at registration.
+        FixedRingBuffer<double> recent_rtts;
+        /// Mutation counter of this host alone; guarded by mutex.
+        std::uint64_t version{0};
+        /// Change epoch current at the host's last mutation; guarded by mutex.
+        std::uint64_t changed_epoch{0};
+        /// Snapshot built at cached_version during rolling-window slot cached_epoch.
+        std::shared_ptr<const StatisticsSnapshot> cached;
+        std::uint64_t cached_version{0};
+        std::int64_t cached_epoch{0};
+    };
+
+    /// Entry state read under the host lock and moved into the snapshot afterwards.
+    struct EntryExtras {
+        WindowSummary last_1m;
+        WindowSummary last_5m;
+        WindowSummary last_15m;
+        std::vector<double> recent_rtts;
+    };
+
+    /// Summarize the rolling windows and linearize recent RTTs; caller holds entry.mutex.
+    static EntryExtras capture_extras(const HostEntry& entry, RollingWindow::Clock::time_point now)
+    {
+        EntryExtras extras;
+        if (entry.window) {
+            extras.last_1m = entry.window->summarize(now, kWindowShort);
+            extras.last_5m = entry.window->summarize(now, kWindowMedium);
+            extras.last_15m = entry.window->summarize(now, kWindowLong);
+        }
+        entry.recent_rtts.copy_to(extras.recent_rtts);
+        return extras;
+    }
+
+    /// Change flag on its own cache line; writers only store to it when it is still clear.
+    struct alignas(64) DirtyFlag {
+        std::atomic<bool> set{false};
     };
 
-    /// Retrieve or create stats for a host; initializes histogram buckets.
-    HostStats& ensure_host(const std::string& host)
+    /// Fixed block of entries; chunks are never moved or freed while the aggregator lives, so a
+    /// handle maps to the same entry forever.
+    struct Chunk {
+        std::array<HostEntry, kChunkSize> entries;
+    };
+
+    /// Slice of the name index; only consulted when a host is registered or addressed by name.
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, HostHandle> handles;
+    };
+
+    const Shard& shard_for(const std::string& host) const
+    {
+        return shards[std::hash<std::string>{}(host) & (kShardCount - 1)];
+    }
+    Shard& shard_for(const std::string& host)
+    {
+        return shards[std::hash<std::string>{}(host) & (kShardCount - 1)];
+    }
+
+    /// Entry for a published handle: one load for the chunk, then a direct index.
+    HostEntry& entry(HostHandle handle) const
+    {
+        return chunks[handle >> kChunkBits].load(std::memory_order_acquire)->entries[handle & (kChunkSize - 1)];
+    }
+
+    /// True when handle was returned by register_host.
+    bool valid(HostHandle handle) const { return handle < host_count.load(std::memory_order_acquire); }
+
+    /// Return the host's handle, allocating the next dense slot on first sight; boundaries (or the
+    /// aggregator default when null) seed a new host and are ignored for existing ones.
+    HostHandle ensure_host(const std::string& host, const std::vector<double>* boundaries = nullptr)
+    {
+        Shard& shard = shard_for(host);
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.handles.find(host);
+            if (it != shard.handles.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.handles.find(host);
+        if (it != shard.handles.end()) {
+            return it->second;  // registered concurrently
+        }
+
+        std::lock_guard<std::mutex> alloc_lock(alloc_mutex);
+        const HostHandle handle = host_count.load(std::memory_order_relaxed);
+        const std::uint32_t chunk_index = handle >> kChunkBits;
+        if (chunk_index >= kMaxChunks) {
+            throw std::length_error("Too many hosts registered with the statistics aggregator");
+        }
+        if (chunks[chunk_index].load(std::memory_order_relaxed) == nullptr) {
+            owned_chunks.push_back(std::make_unique<Chunk>());
+            chunks[chunk_index].store(owned_chunks.back().get(), std::memory_order_release);
+        }
+        entry(handle).stats = fine_histogram_prototype ? HostStats{host, *fine_histogram_prototype}
+                                                       : HostStats{host, boundaries ? *boundaries : default_boundaries};
+        entry(handle).window.emplace();
+        entry(handle).recent_rtts = FixedRingBuffer<double>(kRecentCapacity);
+        mark_changed(entry(handle), handle);
+        host_count.store(handle + 1, std::memory_order_release);
+        shard.handles.emplace(host, handle);
+        return handle;
+    }
+
+    /// Record a mutation of a host; caller holds its mutex (or the host is not yet published).
+    /// Only host-local state and a change flag that is usually already set are written, so
+    /// writers to different hosts share no contended cache line.
+    void mark_changed(HostEntry& host_entry, HostHandle handle)
+    {
+        ++host_entry.version;
+        host_entry.changed_epoch = change_epoch.load(std::memory_order_relaxed);
+        auto& flag = dirty[handle & (kDirtyFlagCount - 1)].set;
+        if (!flag.load(std::memory_order_relaxed)) {
+            flag.store(true, std::memory_order_release);
+        }
+    }
+
+    /// True when a host changed since the last close_epoch().
+    bool any_dirty() const
+    {
+        return std::any_of(dirty.begin(), dirty.end(),
+                           [](const DirtyFlag& flag) { return flag.set.load(std::memory_order_acquire); });
+    }
+
+    /// Derive a data version for a reader: if any host changed since the last call, start a new
+    /// change epoch. Returns the last closed epoch; every mutation stamped with it or earlier has
+    /// completed or still holds its host lock, so a scan that locks each host afterwards sees it.
+    std::uint64_t close_epoch()
+    {
+        std::lock_guard<std::mutex> lock(epoch_mutex);
+        bool changed = false;
+        for (auto& flag : dirty) {
+            changed = flag.set.exchange(false, std::memory_order_acq_rel) || changed;
+        }
+        if (changed) {
+            change_epoch.fetch_add(1, std::memory_order_acq_rel);
+        }
+        return change_epoch.load(std::memory_order_relaxed) - 1;
+    }
+
+    /// Data version a reader sees without closing an epoch; matches the last close_epoch() result
+    /// until another one starts a new epoch.
+    std::uint64_t closed_epoch() const { return change_epoch.load(std::memory_order_acquire) - 1; }
+
+    /// Rolling windows only shift at slot boundaries; a cached snapshot from the same slot still
+    /// has current window figures.
+    static std::int64_t window_epoch(RollingWindow::Clock::time_point now)
+    {
+        return static_cast<std::int64_t>(now.time_since_epoch() / RollingWindow::kDefaultSlotWidth);
+    }
+
+    /// Snapshot one host, reusing its cached snapshot while neither its data nor the window slot
+    /// changed. On a miss the host is locked only to copy its state; the snapshot is built outside
+    /// the lock and cached unless the host changed meanwhile.
+    std::shared_ptr<const StatisticsSnapshot> snapshot_entry(HostHandle handle,
+                                                             RollingWindow::Clock::time_point now) const
+    {
+        const std::int64_t epoch = window_epoch(now);
+        HostEntry& host_entry = entry(handle);
+        std::unique_lock<std::mutex> lock(host_entry.mutex);
+        const std::uint64_t version = host_entry.version;
+        if (host_entry.cached && host_entry.cached_version == version && host_entry.cached_epoch == epoch) {
+            return host_entry.cached;
+        }
+        auto stats_copy = host_entry.stats;
+        auto extras = capture_extras(host_entry, now);
+        lock.unlock();
+
+        auto built = std::make_shared<const StatisticsSnapshot>(build_snapshot(stats_copy, std::move(extras)));
+        lock.lock();
+        if (host_entry.version == version) {
+            host_entry.cached = built;
+            host_entry.cached_version = version;
+            host_entry.cached_epoch = epoch;
+        }
+        return built;
+    }
+
+    /// Existing handle for a host, if registered.
+    std::optional<HostHandle> find_host(const std::string& host) const
     {
-        auto it = hosts.find(host);
-        if (it == hosts.end()) {
-            auto [inserted_it, _] = hosts.emplace(host, HostStats{host, kDefaultBoundaries});
-            return inserted_it->second;
+        const Shard& shard = shard_for(host);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.handles.find(host);
+        if (it == shard.handles.end()) {
+            return std::nullopt;
         }
         return it->second;
     }
@@ -65,35 +288,52 @@ struct StatisticsAggregatorImpl::Impl {
         stats.max_ms = -std::numeric_limits<double>::infinity();
         stats.sum_ms = 0.0;
         std::fill(stats.histogram_counts.begin(), stats.histogram_counts.end(), 0);
-        stats.median_buffer.clear();
-        stats.recent_rtts.clear();
+        if (stats.fine_histogram) {
+            stats.fine_histogram->clear();
+        }
+        stats.rtt_quantiles.clear();
+    }
+
+    /// Sketch quantile clamped to the exact extrema, so small samples report real values at the tails.
+    static double quantile_within_range(const HostStats& stats, double q)
+    {
+        return std::clamp(stats.rtt_quantiles.quantile(q), stats.min_ms, stats.max_ms);
     }
 
-    /// Compute median from a bounded deque using partial selection.
-    static double compute_median(const std::deque<double>& buffer)
+    /// Emit the populated slot range with the fixed-mode layout: (inclusive upper bound, count)
+    /// pairs, then an overflow pair repeating the last bound. Empty slots outside the range are
+    /// left out. Slots count integer microseconds, so a slot's highest value is one below the
+    /// next slot's lowest.
+    static void append_log_linear_buckets(const LogLinearHistogram& histogram, StatisticsSnapshot& snap)
     {
-        if (buffer.empty()) {
-            return 0.0;
+        std::size_t first = histogram.slot_count();
+        std::size_t last = 0;
+        for (std::size_t i = 0; i < histogram.slot_count(); ++i) {
+            if (histogram.count_at(i) != 0) {
+                first = std::min(first, i);
+                last = i;
+            }
         }
-        std::vector<double> data(buffer.begin(), buffer.end());
-        const std::size_t n = data.size();
-        const std::size_t mid = n / 2;
-        if (n % 2 == 1) {
-            std::nth_element(data.begin(), data.begin() + mid, data.end());
-            return data[mid];
+        if (first == histogram.slot_count()) {
+            return;
         }
-        std::nth_element(data.begin(), data.begin() + mid - 1, data.end());
-        double lower = data[mid - 1];
-        std::nth_element(data.begin(), data.begin() + mid, data.end());
-        double upper = data[mid];
-        return (lower + upper) / 2.0;
+        snap.histogram_buckets.reserve(last - first + 2);
+        for (std::size_t i = first; i <= last; ++i) {
+            const double upper_ms = static_cast<double>(histogram.next_non_equivalent(i) - 1) / kMicrosPerMs;
+            snap.histogram_buckets.emplace_back(upper_ms, static_cast<double>(histogram.count_at(i)));
+        }
+        snap.histogram_buckets.emplace_back(snap.histogram_buckets.back().first, 0.0);
     }
 
     /// Build an immutable snapshot ready for rendering/exporting.
-    static StatisticsSnapshot build_snapshot(const HostStats& stats)
+    static StatisticsSnapshot build_snapshot(const HostStats& stats, EntryExtras&& extras)
     {
         StatisticsSnapshot snap;
         snap.host = stats.host;
+        snap.window_1m = extras.last_1m;
+        snap.window_5m = extras.last_5m;
+        snap.window_15m = extras.last_15m;
+        snap.recent_rtts = std::move(extras.recent_rtts);
         snap.count = stats.sent_count;
         if (stats.sent_count == 0) {
             snap.loss_ratio = 0.0;
@@ -111,7 +351,16 @@ struct StatisticsAggregatorImpl::Impl {
             snap.min_ms = stats.min_ms;
             snap.max_ms = stats.max_ms;
             snap.mean_ms = stats.sum_ms / static_cast<double>(stats.success_count);
-            snap.median_ms = compute_median(stats.median_buffer);
+            snap.median_ms = quantile_within_range(stats, 0.5);
+            snap.p90_ms = quantile_within_range(stats, 0.90);
+            snap.p95_ms = quantile_within_range(stats, 0.95);
+            snap.p99_ms = quantile_within_range(stats, 0.99);
+            snap.p999_ms = quantile_within_range(stats, 0.999);
+        }
+
+        if (stats.fine_histogram) {
+            append_log_linear_buckets(*stats.fine_histogram, snap);
+            return snap;
         }
 
         snap.histogram_buckets.reserve(stats.histogram_counts.size());
@@ -122,23 +371,94 @@ struct StatisticsAggregatorImpl::Impl {
                                                                  : stats.boundaries.back());
             snap.histogram_buckets.emplace_back(boundary, static_cast<double>(stats.histogram_counts[i]));
         }
-
-        snap.recent_rtts.assign(stats.recent_rtts.begin(), stats.recent_rtts.end());
         return snap;
     }
 
-    mutable std::mutex mutex;
-    std::unordered_map<std::string, HostStats> hosts;
+    /// Fixed-mode boundaries for hosts registered without their own.
+    std::vector<double> default_boundaries{default_bucket_boundaries()};
+    /// Empty histogram copied into each new host in log-linear mode.
+    std::optional<LogLinearHistogram> fine_histogram_prototype;
+    std::array<Shard, kShardCount> shards;
+    std::array<std::atomic<Chunk*>, kMaxChunks> chunks{};
+    std::atomic<HostHandle> host_count{0};
+    std::mutex alloc_mutex;
+    std::vector<std::unique_ptr<Chunk>> owned_chunks;
+    /// Writers stamp hosts with the current epoch; readers advance it in close_epoch() only
+    /// after something changed, so it is read-mostly. Starts at 1 so version 0 precedes all data.
+    std::atomic<std::uint64_t> change_epoch{1};
+    /// Set by writers, cleared by close_epoch(); spread over cache lines by host handle.
+    std::array<DirtyFlag, kDirtyFlagCount> dirty{};
+    /// Serializes close_epoch().
+    std::mutex epoch_mutex;
+    /// Last published set; swapped atomically so readers never wait on a rebuild in progress.
+    std::atomic<std::shared_ptr<const SnapshotSet>> published;
+    /// Serializes rebuilds so concurrent readers of a stale set build it only once.
+    std::mutex publish_mutex;
 };
 
 StatisticsAggregatorImpl::StatisticsAggregatorImpl() : impl_(std::make_unique<Impl>()) {}
 
-/// Ingest a single ping result, updating counts, extrema, histogram, median, and recent RTTs.
+StatisticsAggregatorImpl::StatisticsAggregatorImpl(const AggregatorConfig& config) : impl_(std::make_unique<Impl>())
+{
+    if (!config.bucket_boundaries.empty()) {
+        validate_bucket_boundaries(config.bucket_boundaries);
+        impl_->default_boundaries = config.bucket_boundaries;
+    }
+    if (config.histogram_mode == HistogramMode::LogLinear) {
+        if (!(config.log_linear_lowest_ms > 0.0) || !(config.log_linear_highest_ms > config.log_linear_lowest_ms)) {
+            throw std::invalid_argument("Log-linear histogram range must satisfy 0 < lowest < highest");
+        }
+        impl_->fine_histogram_prototype.emplace(
+            static_cast<std::uint64_t>(std::llround(config.log_linear_lowest_ms * kMicrosPerMs)),
+            static_cast<std::uint64_t>(std::llround(config.log_linear_highest_ms * kMicrosPerMs)),
+            config.log_linear_significant_digits);
+    }
+}
+
+/// Look up or allocate the host's dense slot; the name is hashed here and nowhere on the hot path.
+StatisticsAggregator::HostHandle StatisticsAggregatorImpl::register_host(const std::string& host)
+{
+    return impl_->ensure_host(host);
+}
+
+/// Validate before touching storage so a bad set never leaves a half-registered host.
+StatisticsAggregator::HostHandle StatisticsAggregatorImpl::register_host(const std::string& host,
+                                                                         const std::vector<double>& bucket_boundaries)
+{
+    if (bucket_boundaries.empty()) {
+        return impl_->ensure_host(host);
+    }
+    validate_bucket_boundaries(bucket_boundaries);
+    return impl_->ensure_host(host, &bucket_boundaries);
+}
+
+/// Name-keyed convenience path; resolves the handle and forwards.
 void StatisticsAggregatorImpl::add_sample(const std::string& host, double rtt_ms, bool success)
 {
+    add_sample(impl_->ensure_host(host), rtt_ms, success);
+}
+
+/// Handle path for live samples; stamps them with the current time.
+void StatisticsAggregatorImpl::add_sample(HostHandle host, double rtt_ms, bool success)
+{
+    add_sample(host, rtt_ms, success, RollingWindow::Clock::now());
+}
+
+/// Ingest a single ping result, updating counts, extrema, histogram, quantiles, rolling windows,
+/// and recent RTTs.
+/// Unknown handles are ignored.
+void StatisticsAggregatorImpl::add_sample(HostHandle host, double rtt_ms, bool success,
+                                          std::chrono::steady_clock::time_point measured_at)
+{
+    if (!impl_->valid(host)) {
+        return;
+    }
     double rtt = clamp_non_negative(rtt_ms);
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    auto& stats = impl_->ensure_host(host);
+    auto& entry = impl_->entry(host);
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    impl_->mark_changed(entry, host);
+    entry.window->add(measured_at, rtt, success);
+    auto& stats = entry.stats;
     ++stats.sent_count;
     if (!success) {
         return;
@@ -149,76 +469,129 @@ void StatisticsAggregatorImpl::add_sample(const std::string& host, double rtt_ms
     stats.min_ms = std::min(stats.min_ms, rtt);
     stats.max_ms = std::max(stats.max_ms, rtt);
 
-    if (stats.median_buffer.size() >= kMedianCapacity) {
-        stats.median_buffer.pop_front();
-    }
-    stats.median_buffer.push_back(rtt);
+    stats.rtt_quantiles.add(rtt);
 
-    std::size_t bucket = stats.boundaries.size();
-    for (std::size_t i = 0; i < stats.boundaries.size(); ++i) {
-        if (rtt < stats.boundaries[i]) {
-            bucket = i;
-            break;
-        }
+    if (stats.fine_histogram) {
+        stats.fine_histogram->record(static_cast<std::uint64_t>(std::llround(rtt * kMicrosPerMs)));
+    } else {
+        // Boundaries are validated ascending and inclusive, like an OpenMetrics le: the first one
+        // not below rtt is found in O(log n).
+        const auto bucket = std::lower_bound(stats.boundaries.begin(), stats.boundaries.end(), rtt);
+        ++stats.histogram_counts[static_cast<std::size_t>(bucket - stats.boundaries.begin())];
     }
-    ++stats.histogram_counts[bucket];
 
-    if (stats.recent_rtts.size() >= kRecentCapacity) {
-        stats.recent_rtts.pop_front();
-    }
-    stats.recent_rtts.push_back(rtt);
+    entry.recent_rtts.push_back(rtt);
 }
 
 /// Snapshot metrics for one host; returns empty snapshot when unknown.
 StatisticsSnapshot StatisticsAggregatorImpl::snapshot(const std::string& host) const
 {
-    std::unique_lock<std::mutex> lock(impl_->mutex);
-    auto it = impl_->hosts.find(host);
-    if (it == impl_->hosts.end()) {
+    const auto handle = impl_->find_host(host);
+    if (!handle) {
         return StatisticsSnapshot{};
     }
-    auto stats_copy = it->second;
-    lock.unlock();
-    return Impl::build_snapshot(stats_copy);
+    return *impl_->snapshot_entry(*handle, RollingWindow::Clock::now());
 }
 
-/// Snapshot all hosts with minimal lock hold time.
+/// Snapshot all hosts in registration order. Only hosts that changed since their cached snapshot
+/// are rebuilt, and each is locked only briefly, so ingestion for other hosts continues.
 std::vector<StatisticsSnapshot> StatisticsAggregatorImpl::snapshot_all() const
 {
-    std::vector<Impl::HostStats> copies;
-    {
-        std::lock_guard<std::mutex> lock(impl_->mutex);
-        copies.reserve(impl_->hosts.size());
-        for (const auto& [_, stats] : impl_->hosts) {
-            copies.push_back(stats);
+    const HostHandle count = impl_->host_count.load(std::memory_order_acquire);
+    const auto now = RollingWindow::Clock::now();
+    std::vector<StatisticsSnapshot> result;
+    result.reserve(count);
+    for (HostHandle handle = 0; handle < count; ++handle) {
+        result.push_back(*impl_->snapshot_entry(handle, now));
+    }
+    return result;
+}
+
+/// Unchanged hosts cost one uncontended lock to read their change epoch. The version is derived
+/// before the scan, so a host changing during the scan may be reported again by the next call.
+SnapshotSet StatisticsAggregatorImpl::snapshot_changed_since(std::uint64_t version) const
+{
+    SnapshotSet delta;
+    delta.version = impl_->close_epoch();
+    delta.built_at = RollingWindow::Clock::now();
+    const HostHandle count = impl_->host_count.load(std::memory_order_acquire);
+    for (HostHandle handle = 0; handle < count; ++handle) {
+        const auto& entry = impl_->entry(handle);
+        std::unique_lock<std::mutex> lock(entry.mutex);
+        const bool changed = entry.changed_epoch > version;
+        lock.unlock();
+        if (changed) {
+            delta.hosts.push_back(*impl_->snapshot_entry(handle, delta.built_at));
         }
     }
+    return delta;
+}
 
-    std::vector<StatisticsSnapshot> result;
-    result.reserve(copies.size());
-    for (const auto& stats : copies) {
-        result.push_back(Impl::build_snapshot(stats));
+/// Fast path is a handful of atomic loads (published set, epoch, change flags); a stale set is
+/// rebuilt by one reader while the others keep using the previous one. The version is derived before
+/// building, so samples that arrive during the rebuild leave the new set stale and trigger the
+/// next one.
+std::shared_ptr<const SnapshotSet> StatisticsAggregatorImpl::published_snapshots() const
+{
+    const auto is_current = [this](const std::shared_ptr<const SnapshotSet>& set, std::uint64_t version,
+                                   RollingWindow::Clock::time_point now) {
+        return set && set->version == version && now - set->built_at < kPublishedWindowRefresh;
+    };
+
+    auto current = impl_->published.load(std::memory_order_acquire);
+    if (!impl_->any_dirty() && is_current(current, impl_->closed_epoch(), RollingWindow::Clock::now())) {
+        return current;
     }
+
+    std::unique_lock<std::mutex> lock(impl_->publish_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        if (current) {
+            return current;  // another reader is rebuilding; the previous set is still consistent
+        }
+        lock.lock();
+    }
+    const auto now = RollingWindow::Clock::now();
+    current = impl_->published.load(std::memory_order_acquire);
+    if (!impl_->any_dirty() && is_current(current, impl_->closed_epoch(), now)) {
+        return current;
+    }
+    const std::uint64_t version = impl_->close_epoch();
+
+    auto fresh = std::make_shared<SnapshotSet>();
+    fresh->version = version;
+    fresh->built_at = now;
+    fresh->hosts = snapshot_all();
+    std::shared_ptr<const SnapshotSet> result = std::move(fresh);
+    impl_->published.store(result, std::memory_order_release);
     return result;
 }
 
 /// Reset one host's statistics.
 void StatisticsAggregatorImpl::reset(const std::string& host)
 {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    auto it = impl_->hosts.find(host);
-    if (it == impl_->hosts.end()) {
+    const auto handle = impl_->find_host(host);
+    if (!handle) {
         return;
     }
-    Impl::reset_stats(it->second);
+    auto& entry = impl_->entry(*handle);
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    impl_->mark_changed(entry, *handle);
+    Impl::reset_stats(entry.stats);
+    entry.window->clear();
+    entry.recent_rtts.clear();
 }
 
 /// Reset statistics for all known hosts.
 void StatisticsAggregatorImpl::reset_all()
 {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    for (auto& [_, stats] : impl_->hosts) {
-        Impl::reset_stats(stats);
+    const HostHandle count = impl_->host_count.load(std::memory_order_acquire);
+    for (HostHandle handle = 0; handle < count; ++handle) {
+        auto& entry = impl_->entry(handle);
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        impl_->mark_changed(entry, handle);
+        Impl::reset_stats(entry.stats);
+        entry.window->clear();
+        entry.recent_rtts.clear();
     }
 }
 
@@ -227,5 +600,10 @@ std::shared_ptr<StatisticsAggregator> make_statistics_aggregator()
     return std::make_shared<StatisticsAggregatorImpl>();
 }
 
+std::shared_ptr<StatisticsAggregator> make_statistics_aggregator(const AggregatorConfig& config)
+{
+    return std::make_shared<StatisticsAggregatorImpl>(config);
+}
+
 }  // namespace pingstats
 
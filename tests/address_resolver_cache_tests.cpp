@@ -0,0 +1,40 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <arpa/inet.h>
+#include <chrono>
+
+#include "address_resolver_cache.hpp"
+
+using namespace pingstats;
+
+TEST_CASE("resolver cache serves repeated lookups without resolving again")
+{
+    AddressResolverCache cache{std::chrono::seconds{300}};
+    const auto first = cache.lookup("127.0.0.1");
+    REQUIRE(first.address.sin_family == AF_INET);
+    REQUIRE(first.address.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+
+    const auto second = cache.lookup("127.0.0.1");
+    REQUIRE(second.resolve_ms == 0.0);
+    REQUIRE(second.address.sin_addr.s_addr == first.address.sin_addr.s_addr);
+}
+
+TEST_CASE("zero TTL keeps the startup resolution for the whole run")
+{
+    AddressResolverCache cache{std::chrono::seconds{0}};
+    cache.lookup("127.0.0.1");
+    REQUIRE(cache.lookup("127.0.0.1").resolve_ms == 0.0);
+}
+
+TEST_CASE("refresh and invalidate force a new resolution")
+{
+    AddressResolverCache cache{std::chrono::seconds{300}};
+    cache.lookup("127.0.0.1");
+    const auto refreshed = cache.refresh("127.0.0.1");
+    REQUIRE(refreshed.address.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+
+    cache.invalidate("127.0.0.1");
+    const auto again = cache.lookup("127.0.0.1");
+    REQUIRE(again.address.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+    REQUIRE(cache.lookup("127.0.0.1").resolve_ms == 0.0);
+}
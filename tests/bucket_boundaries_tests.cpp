@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bucket_boundaries.hpp"
+
+using namespace pingstats;
+
+namespace {
+
+/// Write content to a fresh file in the temp directory and return its path.
+std::string write_temp_file(const std::string& name, const std::string& content)
+{
+    const auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::trunc);
+    ofs << content;
+    return path.string();
+}
+
+}  // namespace
+
+TEST_CASE("validator accepts ascending boundaries and rejects malformed sets")
+{
+    REQUIRE_NOTHROW(validate_bucket_boundaries({0.0, 0.5, 10.0}));
+    REQUIRE_NOTHROW(validate_bucket_boundaries(default_bucket_boundaries()));
+
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({}), std::invalid_argument);
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({5.0, 5.0}), std::invalid_argument);
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({10.0, 5.0}), std::invalid_argument);
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({-1.0, 5.0}), std::invalid_argument);
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({1.0, std::numeric_limits<double>::infinity()}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(validate_bucket_boundaries({std::numeric_limits<double>::quiet_NaN()}), std::invalid_argument);
+
+    std::vector<double> many;
+    for (std::size_t i = 0; i <= kMaxBucketBoundaries; ++i) {
+        many.push_back(static_cast<double>(i + 1));
+    }
+    REQUIRE_THROWS_AS(validate_bucket_boundaries(many), std::invalid_argument);
+    many.pop_back();
+    REQUIRE_NOTHROW(validate_bucket_boundaries(many));
+}
+
+TEST_CASE("CLI values parse as lists or presets")
+{
+    REQUIRE(parse_bucket_boundaries("1, 2.5,10") == std::vector<double>{1.0, 2.5, 10.0});
+    REQUIRE(parse_bucket_boundaries("coarse") == std::vector<double>{50, 100, 250, 500, 1000});
+    REQUIRE_NOTHROW(validate_bucket_boundaries(parse_bucket_boundaries("fine")));
+    REQUIRE_NOTHROW(validate_bucket_boundaries(parse_bucket_boundaries("log")));
+
+    REQUIRE_THROWS_AS(parse_bucket_boundaries(""), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_bucket_boundaries("1,,2"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_bucket_boundaries("1,2x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_bucket_boundaries("10,5"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_bucket_boundaries("medium"), std::invalid_argument);
+}
+
+TEST_CASE("bucket file loads the boundaries array and reports bad content")
+{
+    const auto good = write_temp_file("pingstats_buckets_good.json",
+                                      "{\n  \"bucket_boundaries\": [0.5, 1, 2, 5]\n}\n");
+    REQUIRE(load_bucket_boundaries_file(good) == std::vector<double>{0.5, 1.0, 2.0, 5.0});
+
+    const auto unsorted = write_temp_file("pingstats_buckets_unsorted.json", "{\"bucket_boundaries\": [5, 1]}");
+    REQUIRE_THROWS_AS(load_bucket_boundaries_file(unsorted), std::invalid_argument);
+
+    const auto missing_key = write_temp_file("pingstats_buckets_nokey.json", "{\"buckets\": [1, 2]}");
+    REQUIRE_THROWS_AS(load_bucket_boundaries_file(missing_key), std::invalid_argument);
+
+    const auto empty = write_temp_file("pingstats_buckets_empty.json", "{\"bucket_boundaries\": []}");
+    REQUIRE_THROWS_AS(load_bucket_boundaries_file(empty), std::invalid_argument);
+
+    REQUIRE_THROWS_AS(load_bucket_boundaries_file("/nonexistent/pingstats/buckets.json"), std::runtime_error);
+
+    std::filesystem::remove(good);
+    std::filesystem::remove(unsorted);
+    std::filesystem::remove(missing_key);
+    std::filesystem::remove(empty);
+}
+
+TEST_CASE("shipped default bucket file is valid")
+{
+    const auto path = std::filesystem::path(__FILE__).parent_path() / ".." / "config" / "buckets_default.json";
+    const auto boundaries = load_bucket_boundaries_file(path.string());
+    REQUIRE(boundaries.size() == 11);
+    REQUIRE(boundaries.front() == 0.5);
+}
@@ -0,0 +1,140 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csv_exporter.hpp"
+#include "test_support.hpp"
+
+using namespace pingstats;
+using namespace pingstats::test;
+
+namespace {
+
+constexpr const char* kHeader =
+    "timestamp,host,count,loss_ratio,min_ms,max_ms,mean_ms,median_ms,p90_ms,p95_ms,p99_ms,p999_ms\n";
+
+std::vector<StatisticsSnapshot> one_host(const std::string& host, std::size_t count)
+{
+    StatisticsSnapshot snap;
+    snap.host = host;
+    snap.count = count;
+    snap.loss_ratio = 0.25;
+    snap.min_ms = 1.0;
+    snap.max_ms = 123.456789;
+    snap.mean_ms = 12.3456789;
+    snap.median_ms = 10.0;
+    snap.p90_ms = 20.5;
+    snap.p95_ms = 0.000123;
+    snap.p99_ms = 1234567.0;
+    snap.p999_ms = 0.0;
+    return {snap};
+}
+
+std::size_t count_lines(const std::string& text)
+{
+    return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+}
+
+}  // namespace
+
+TEST_CASE("CSV writer emits the header once and formats like the stream exporter")
+{
+    TempDir dir("csv_format");
+    const auto path = (dir.path / "stats.csv").string();
+    const auto ts = std::chrono::system_clock::now();
+    {
+        CsvSnapshotWriter writer(path);
+        writer.append({}, ts);
+        REQUIRE_FALSE(std::filesystem::exists(path));
+        writer.append(one_host("a", 4), ts);
+        writer.append(one_host("b", 8), ts);
+    }
+    write_snapshots_csv_append(path, one_host("c", 1), ts);
+
+    const auto text = read_file(path);
+    REQUIRE(text.rfind(kHeader, 0) == 0);
+    REQUIRE(text.find(kHeader, 1) == std::string::npos);
+    REQUIRE(count_lines(text) == 4);
+    REQUIRE(text.find("\",\"a\",4,0.25,1,123.457,12.3457,10,20.5,0.000123,1.23457e+06,0\n") != std::string::npos);
+    REQUIRE(text.find("\",\"c\",1,") != std::string::npos);
+}
+
+TEST_CASE("CSV writer rotates by size and keeps a bounded number of files")
+{
+    TempDir dir("csv_rotate_size");
+    const auto path = (dir.path / "stats.csv").string();
+    CsvRotationPolicy rotation;
+    rotation.max_bytes = 300;
+    rotation.keep_files = 2;
+    {
+        CsvSnapshotWriter writer(path, rotation);
+        for (int i = 0; i < 12; ++i) {
+            writer.append(one_host("host", static_cast<std::size_t>(i)));
+        }
+    }
+
+    REQUIRE(std::filesystem::exists(path + ".1"));
+    REQUIRE(std::filesystem::exists(path + ".2"));
+    REQUIRE_FALSE(std::filesystem::exists(path + ".3"));
+    for (const auto& file : {path, path + ".1", path + ".2"}) {
+        const auto text = read_file(file);
+        REQUIRE(text.size() <= rotation.max_bytes);
+        REQUIRE(text.rfind(kHeader, 0) == 0);
+        REQUIRE(count_lines(text) >= 2);
+    }
+    REQUIRE(read_file(path).find("\",\"host\",11,") != std::string::npos);
+}
+
+TEST_CASE("CSV writer rotates by the age of the rows in the current file")
+{
+    TempDir dir("csv_rotate_age");
+    const auto path = (dir.path / "stats.csv").string();
+    CsvRotationPolicy rotation;
+    rotation.max_age = std::chrono::seconds{60};
+    const auto t0 = std::chrono::system_clock::now();
+    {
+        CsvSnapshotWriter writer(path, rotation);
+        writer.append(one_host("h", 1), t0);
+        writer.append(one_host("h", 2), t0 + std::chrono::seconds{59});
+        writer.append(one_host("h", 3), t0 + std::chrono::seconds{60});
+        writer.append(one_host("h", 4), t0 + std::chrono::seconds{90});
+    }
+
+    REQUIRE(count_lines(read_file(path + ".1")) == 3);
+    REQUIRE(count_lines(read_file(path)) == 3);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".2"));
+}
+
+TEST_CASE("CSV writer never appends to a file with another column layout")
+{
+    TempDir dir("csv_legacy_header");
+    const auto path = (dir.path / "stats.csv").string();
+    const std::string legacy = "timestamp,host,count,loss_ratio,min_ms,max_ms,mean_ms,median_ms\n"
+                               "\"2024-01-01 00:00:00\",\"h\",1,0,1,1,1,1\n";
+    {
+        std::ofstream(path, std::ios::binary) << legacy;
+    }
+
+    CsvRotationPolicy no_backups;
+    no_backups.keep_files = 0;
+    REQUIRE_THROWS_AS(CsvSnapshotWriter(path, no_backups).append(one_host("h", 2)), std::runtime_error);
+    REQUIRE(read_file(path) == legacy);
+
+    write_snapshots_csv_append(path, one_host("h", 3));
+    REQUIRE(read_file(path + ".1") == legacy);
+    const auto text = read_file(path);
+    REQUIRE(text.rfind(kHeader, 0) == 0);
+    REQUIRE(count_lines(text) == 2);
+
+    // A file that already has the current header is appended to as before.
+    write_snapshots_csv_append(path, one_host("h", 4));
+    REQUIRE(count_lines(read_file(path)) == 3);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".2"));
+}
@@ -1,13 +1,46 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include "platform_ping_backend_factory.hpp"
 
 using namespace pingstats;
 
+namespace {
+
+/// Create and initialize a backend, or return null after a WARN when the process may not open
+/// ICMP sockets (EPERM/EACCES), so the calling test can skip. Any other failure propagates: it
+/// means the backend is broken.
+std::unique_ptr<PlatformPingBackend> open_backend_or_skip(const BackendConfig& config = {})
+{
+    try {
+        auto backend = make_platform_ping_backend(config);
+        backend->initialize();
+        return backend;
+    } catch (const std::system_error& ex) {
+        if (ex.code() != std::errc::operation_not_permitted && ex.code() != std::errc::permission_denied) {
+            throw;
+        }
+        if (config.icmp_socket_mode == IcmpSocketMode::Datagram) {
+            WARN("ICMP datagram sockets unavailable (check net.ipv4.ping_group_range): " << ex.what());
+        } else {
+            WARN("Ping backend unavailable (need ICMP permissions): " << ex.what());
+        }
+        return nullptr;
+    }
+}
+
+}  // namespace
+
 TEST_CASE("platform backend can ping configured host")
 {
     const char* env_host = std::getenv("PINGSTATS_TEST_HOST");
@@ -25,3 +58,142 @@ TEST_CASE("platform backend can ping configured host")
 
     REQUIRE(result.success == true);
 }
+
+TEST_CASE("concurrent backends share the ICMP path and each get their own replies")
+{
+    constexpr std::size_t kBackends = 8;
+    std::vector<std::unique_ptr<PlatformPingBackend>> backends;
+    for (std::size_t i = 0; i < kBackends; ++i) {
+        backends.push_back(open_backend_or_skip());
+        if (!backends.back()) {
+            return;
+        }
+    }
+
+    std::vector<int> successes(kBackends, 0);
+    std::vector<std::exception_ptr> errors(kBackends);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < kBackends; ++i) {
+        workers.emplace_back([&, i]() {
+            try {
+                for (int n = 0; n < 5; ++n) {
+                    const auto r = backends[i]->send_ping("127.0.0.1", std::chrono::milliseconds{500});
+                    successes[i] += r.success ? 1 : 0;
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    for (auto& b : backends) {
+        b->shutdown();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (successes[0] == 0) {
+        WARN("Loopback ping failed (backend may be stub or ICMP is filtered)");
+        return;
+    }
+    for (const int s : successes) {
+        REQUIRE(s == 5);
+    }
+}
+
+TEST_CASE("kernel timestamp mode reports the clock source it used")
+{
+    BackendConfig config;
+    config.kernel_timestamps = true;
+    const auto backend = open_backend_or_skip(config);
+    if (!backend) {
+        return;
+    }
+    const auto result = backend->send_ping("127.0.0.1", std::chrono::milliseconds{500});
+    backend->shutdown();
+
+    if (!result.success) {
+        WARN("Loopback ping failed (backend may be stub or ICMP is filtered)");
+        return;
+    }
+    REQUIRE(result.rtt_ms >= 0.0);
+    if (result.clock_source == PlatformPingBackend::ClockSource::UserSpace) {
+        WARN("Kernel timestamps unavailable; fell back to user-space timing");
+    }
+}
+
+TEST_CASE("datagram ICMP socket mode pings loopback without raw sockets")
+{
+    BackendConfig config;
+    config.icmp_socket_mode = IcmpSocketMode::Datagram;
+    const auto backend = open_backend_or_skip(config);
+    if (!backend) {
+        return;
+    }
+    const auto result = backend->send_ping("127.0.0.1", std::chrono::milliseconds{500});
+    backend->shutdown();
+
+    if (!result.success) {
+        WARN("Loopback ping failed (backend may be stub or ICMP is filtered)");
+        return;
+    }
+    REQUIRE(result.rtt_ms >= 0.0);
+}
+
+TEST_CASE("batched pings return one result per host in order")
+{
+    // More than two sendmmsg chunks, so later chunks are registered and stamped separately.
+    const std::vector<std::string> hosts(160, "127.0.0.1");
+    const auto backend = open_backend_or_skip();
+    if (!backend) {
+        return;
+    }
+    const auto results = backend->send_ping_batch(hosts, std::chrono::milliseconds{1000});
+    backend->shutdown();
+
+    REQUIRE(results.size() == hosts.size());
+    const auto successes = std::count_if(results.begin(), results.end(), [](const auto& r) { return r.success; });
+    if (successes == 0) {
+        WARN("Loopback ping failed (backend may be stub or ICMP is filtered)");
+        return;
+    }
+    CHECK(successes == static_cast<long>(hosts.size()));
+}
+
+TEST_CASE("async pings keep many probes in flight from one thread")
+{
+    constexpr int kProbes = 16;
+    std::mutex mutex;
+    std::condition_variable cv;
+    int completed = 0;
+    int succeeded = 0;
+    const auto backend = open_backend_or_skip();
+    if (!backend) {
+        return;
+    }
+    for (int i = 0; i < kProbes; ++i) {
+        backend->send_ping_async("127.0.0.1", std::chrono::milliseconds{1000},
+                                 [&](const PlatformPingBackend::PingResult& result) {
+                                     std::lock_guard<std::mutex> lock(mutex);
+                                     ++completed;
+                                     succeeded += result.success ? 1 : 0;
+                                     cv.notify_all();
+                                 });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        REQUIRE(cv.wait_for(lock, std::chrono::seconds{5}, [&] { return completed == kProbes; }));
+    }
+    backend->shutdown();
+    if (succeeded == 0) {
+        WARN("Loopback ping failed (backend may be stub or ICMP is filtered)");
+        return;
+    }
+    CHECK(succeeded == kProbes);
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "json_exporter.hpp"
+#include "test_support.hpp"
+
+using namespace pingstats;
+using namespace pingstats::test;
+
+namespace {
+
+std::vector<std::string> read_lines(const std::filesystem::path& path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(ifs, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+StatisticsSnapshot make_snapshot(const std::string& host, std::size_t count)
+{
+    StatisticsSnapshot snap;
+    snap.host = host;
+    snap.count = count;
+    snap.loss_ratio = 0.25;
+    snap.min_ms = 1.0;
+    snap.max_ms = 123.456789;
+    snap.mean_ms = std::numeric_limits<double>::quiet_NaN();
+    snap.window_1m.count = 3;
+    snap.window_1m.p99_ms = 7.5;
+    snap.histogram_buckets = {{10.0, 2}, {std::numeric_limits<double>::infinity(), 1}};
+    snap.recent_rtts = {1.5, 2.25};
+    return snap;
+}
+
+}  // namespace
+
+TEST_CASE("JSON writer renders the snapshot document with escaping")
+{
+    TempDir dir("json_format");
+    const auto path = (dir.path / "stats.json").string();
+    write_snapshots_json(path, {make_snapshot("a\"b\\c\n", 4), make_snapshot("d", 8)});
+
+    const auto text = read_file(path);
+    REQUIRE(text.rfind("{\n  \"timestamp\": \"", 0) == 0);
+    REQUIRE(text.find("\"host\": \"a\\\"b\\\\c\\n\"") != std::string::npos);
+    REQUIRE(text.find("\"count\": 4,\n      \"loss_ratio\": 0.25") != std::string::npos);
+    REQUIRE(text.find("\"max_ms\": 123.457") != std::string::npos);
+    REQUIRE(text.find("\"mean_ms\": null") != std::string::npos);
+    REQUIRE(text.find("\"1m\": {\"count\": 3, ") != std::string::npos);
+    REQUIRE(text.find("\"histogram_buckets\": [[10,2],[null,1]]") != std::string::npos);
+    REQUIRE(text.find("\"recent_rtts\": [1.5,2.25]\n    },\n") != std::string::npos);
+    REQUIRE(text.size() >= 6);
+    REQUIRE(text.compare(text.size() - 6, 6, "  ]\n}\n") == 0);
+}
+
+TEST_CASE("JSON writer replaces the previous document without leaving a temporary file")
+{
+    TempDir dir("json_replace");
+    const auto path = (dir.path / "stats.json").string();
+    JsonSnapshotWriter writer(path);
+    writer.write({make_snapshot("first", 1), make_snapshot("second", 2)});
+    writer.write({make_snapshot("third", 3)});
+
+    const auto text = read_file(path);
+    REQUIRE(text.find("\"third\"") != std::string::npos);
+    REQUIRE(text.find("\"first\"") == std::string::npos);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".tmp"));
+    REQUIRE(std::distance(std::filesystem::directory_iterator(dir.path), std::filesystem::directory_iterator{}) == 1);
+
+    JsonSnapshotWriter missing_dir((dir.path / "missing" / "stats.json").string());
+    REQUIRE_THROWS(missing_dir.write({make_snapshot("x", 1)}));
+    REQUIRE(read_file(path) == text);
+}
+
+TEST_CASE("NDJSON writer appends one compact line per host and tick")
+{
+    TempDir dir("ndjson_append");
+    const auto path = (dir.path / "stats.ndjson").string();
+    {
+        NdjsonSnapshotWriter writer(path);
+        writer.append({});
+        REQUIRE_FALSE(std::filesystem::exists(path));
+        writer.append({make_snapshot("a", 1), make_snapshot("b", 2)});
+        writer.append({make_snapshot("a", 3), make_snapshot("b", 4)});
+    }
+    {
+        NdjsonSnapshotWriter reopened(path);
+        reopened.append({make_snapshot("c", 5)});
+    }
+
+    const auto lines = read_lines(path);
+    REQUIRE(lines.size() == 5);
+    for (const auto& line : lines) {
+        REQUIRE(line.front() == '{');
+        REQUIRE(line.back() == '}');
+        REQUIRE(line.find("\"timestamp\":\"") == 1);
+        REQUIRE(line.find("recent_rtts") == std::string::npos);
+        REQUIRE(line.find(": ") == std::string::npos);
+    }
+    REQUIRE(lines[0].find("\"host\":\"a\",\"count\":1,\"loss_ratio\":0.25,") != std::string::npos);
+    REQUIRE(lines[3].find("\"host\":\"b\",\"count\":4,") != std::string::npos);
+    REQUIRE(lines[4].find("\"histogram_buckets\":[[10,2],[null,1]]}") != std::string::npos);
+    REQUIRE(lines[4].find("\"windows\":{\"1m\":{\"count\":3,") != std::string::npos);
+}
@@ -0,0 +1,33 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "linux_icmp_engine.hpp"
+
+using namespace pingstats;
+
+TEST_CASE("identifier leases stay unique across more than one block of lease/release cycles")
+{
+    LinuxIcmpEngine engine;
+    constexpr std::uint32_t kRange = LinuxIcmpEngine::kIdentifierRange;
+
+    // A long-lived lease must never be handed out again while churn wraps past the block size.
+    const auto held = engine.acquire_identifier();
+    for (std::uint32_t i = 0; i < 2 * kRange; ++i) {
+        const auto identifier = engine.acquire_identifier();
+        REQUIRE(identifier != held);
+        engine.release_identifier(identifier);
+    }
+
+    std::set<std::uint16_t> leased{held};
+    for (std::uint32_t i = 1; i < kRange; ++i) {
+        REQUIRE(leased.insert(engine.acquire_identifier()).second);
+    }
+    REQUIRE_THROWS_AS(engine.acquire_identifier(), std::runtime_error);
+
+    engine.release_identifier(held);
+    REQUIRE(engine.acquire_identifier() == held);
+}
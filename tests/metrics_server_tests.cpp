@@ -0,0 +1,212 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics_server.hpp"
+#include "config.hpp"
+#include "statistics_aggregator_impl.hpp"
+
+using namespace pingstats;
+
+namespace {
+
+/// Send request to 127.0.0.1:port and return everything the server sends until it closes;
+/// half_close shuts down the sending side right after the request.
+std::string http_exchange(std::uint16_t port, const std::string& request, bool half_close = false)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(fd >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    REQUIRE(::send(fd, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+    if (half_close) {
+        REQUIRE(::shutdown(fd, SHUT_WR) == 0);
+    }
+    std::string response;
+    char buffer[4096];
+    for (ssize_t n; (n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0;) {
+        response.append(buffer, static_cast<std::size_t>(n));
+    }
+    ::close(fd);
+    return response;
+}
+
+std::string get(std::uint16_t port, const std::string& method, const std::string& target)
+{
+    return http_exchange(port, method + " " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
+std::string body_of(const std::string& response)
+{
+    const auto end = response.find("\r\n\r\n");
+    return end == std::string::npos ? std::string{} : response.substr(end + 4);
+}
+
+}  // namespace
+
+TEST_CASE("OpenMetrics rendering has counters, gauges and cumulative histogram buckets")
+{
+    StatisticsSnapshot snap;
+    snap.host = "a\"b\\c";
+    snap.count = 10;
+    snap.loss_ratio = 0.2;
+    snap.mean_ms = 25.0;
+    snap.median_ms = 20.0;
+    snap.window_1m.count = 4;
+    snap.window_1m.p99_ms = 40.0;
+    snap.histogram_buckets = {{10.0, 1}, {20.0, 3}, {20.0, 0}, {50.0, 2}, {50.0, 2}};
+
+    std::string text;
+    render_openmetrics(text, {snap});
+
+    REQUIRE(text.find("# TYPE pingstats_probes counter\n") != std::string::npos);
+    REQUIRE(text.find("pingstats_probes_total{host=\"a\\\"b\\\\c\"} 10\n") != std::string::npos);
+    REQUIRE(text.find("pingstats_probes_lost_total{host=\"a\\\"b\\\\c\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("# UNIT pingstats_rtt_quantile_seconds seconds\n") != std::string::npos);
+    REQUIRE(text.find(",quantile=\"0.5\"} 0.02\n") != std::string::npos);
+    REQUIRE(text.find("pingstats_window_probes{host=\"a\\\"b\\\\c\",window=\"1m\"} 4\n") != std::string::npos);
+    REQUIRE(text.find(",window=\"1m\",quantile=\"0.99\"} 0.04\n") != std::string::npos);
+
+    REQUIRE(text.find("# TYPE pingstats_rtt_seconds histogram\n") != std::string::npos);
+    REQUIRE(text.find(",le=\"0.01\"} 1\n") != std::string::npos);
+    REQUIRE(text.find(",le=\"0.02\"} 4\n") != std::string::npos);
+    REQUIRE(text.find(",le=\"0.05\"} 6\n") != std::string::npos);
+    REQUIRE(text.find(",le=\"+Inf\"} 8\n") != std::string::npos);
+    REQUIRE(text.find("pingstats_rtt_seconds_count{host=\"a\\\"b\\\\c\"} 8\n") != std::string::npos);
+    REQUIRE(text.find("pingstats_rtt_seconds_sum{host=\"a\\\"b\\\\c\"} 0.2\n") != std::string::npos);
+    // The repeated 20 ms bound is folded into the next bucket instead of being emitted twice.
+    REQUIRE(text.find(",le=\"0.02\"", text.find(",le=\"0.02\"") + 1) == std::string::npos);
+
+    REQUIRE(text.size() >= 6);
+    REQUIRE(text.compare(text.size() - 6, 6, "# EOF\n") == 0);
+}
+
+TEST_CASE("OpenMetrics histogram uses a fixed le set with exact bounds")
+{
+    StatisticsSnapshot fixed;
+    fixed.host = "fixed";
+    fixed.histogram_buckets = {{0.3, 1}, {0.7, 0}, {0.7, 0}};
+    std::string text;
+    render_openmetrics(text, {fixed});
+    REQUIRE(text.find(",le=\"0.0003\"} 1\n") != std::string::npos);
+    REQUIRE(text.find(",le=\"0.0007\"} 1\n") != std::string::npos);
+
+    // A sample exactly on a fixed boundary is inside that boundary's le bucket.
+    auto edges = make_statistics_aggregator();
+    edges->add_sample("edge", 10.0, true);
+    text.clear();
+    render_openmetrics(text, edges->snapshot_all());
+    REQUIRE(text.find("{host=\"edge\",le=\"0.01\"} 1\n") != std::string::npos);
+
+    AggregatorConfig config;
+    config.histogram_mode = HistogramMode::LogLinear;
+    auto aggregator = make_statistics_aggregator(config);
+    const std::vector<double> bounds{10.0, 20.0, 50.0};
+    aggregator->add_sample("fine", 9.0, true);
+
+    // Empty buckets are still emitted, so the series set does not depend on the data seen so far.
+    text.clear();
+    render_openmetrics(text, aggregator->snapshot_all(), bounds);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.01\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.02\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.05\"} 1\n") != std::string::npos);
+
+    aggregator->add_sample("fine", 12.5, true);
+    aggregator->add_sample("fine", 19.0, true);
+    aggregator->add_sample("fine", 250.0, true);
+    text.clear();
+    render_openmetrics(text, aggregator->snapshot_all(), bounds);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.01\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.02\"} 3\n") != std::string::npos);
+    REQUIRE(text.find("{host=\"fine\",le=\"0.05\"} 3\n") != std::string::npos);
+    REQUIRE(text.find("{host=\"fine\",le=\"+Inf\"} 4\n") != std::string::npos);
+    std::size_t bucket_lines = 0;
+    for (auto pos = text.find("pingstats_rtt_seconds_bucket{"); pos != std::string::npos;
+         pos = text.find("pingstats_rtt_seconds_bucket{", pos + 1)) {
+        ++bucket_lines;
+    }
+    REQUIRE(bucket_lines == bounds.size() + 1);
+}
+
+TEST_CASE("metrics listen addresses accept ports, hosts and bracketed IPv6")
+{
+    const auto bare = parse_metrics_listen_address("9464");
+    REQUIRE(bare.host == "127.0.0.1");
+    REQUIRE(bare.port == 9464);
+
+    const auto any = parse_metrics_listen_address(":9100");
+    REQUIRE(any.host.empty());
+    REQUIRE(any.port == 9100);
+
+    const auto named = parse_metrics_listen_address("0.0.0.0:80");
+    REQUIRE(named.host == "0.0.0.0");
+    REQUIRE(named.port == 80);
+
+    const auto v6 = parse_metrics_listen_address("[::1]:0");
+    REQUIRE(v6.host == "::1");
+    REQUIRE(v6.port == 0);
+
+    REQUIRE_THROWS_AS(parse_metrics_listen_address(""), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_metrics_listen_address("::1:9464"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_metrics_listen_address("host:65536"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_metrics_listen_address("host:12x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_metrics_listen_address("[::1]9464"), std::invalid_argument);
+}
+
+TEST_CASE("metrics server renders once per published snapshot set and shares it across scrapes")
+{
+    auto aggregator = make_statistics_aggregator();
+    const auto host = aggregator->register_host("example.org");
+    aggregator->add_sample(host, 12.5, true);
+
+    MetricsServer server(aggregator, parse_metrics_listen_address("127.0.0.1:0"));
+    REQUIRE(server.port() != 0);
+    server.start();
+
+    const auto first = get(server.port(), "GET", "/metrics");
+    REQUIRE(first.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    REQUIRE(first.find(std::string("Content-Type: ") + kOpenMetricsContentType) != std::string::npos);
+    const auto body = body_of(first);
+    REQUIRE(first.find("Content-Length: " + std::to_string(body.size()) + "\r\n") != std::string::npos);
+    REQUIRE(body.find("pingstats_probes_total{host=\"example.org\"} 1\n") != std::string::npos);
+
+    REQUIRE(get(server.port(), "GET", "/metrics?format=openmetrics") == first);
+    REQUIRE(server.render_count() == 1);
+
+    const auto head = get(server.port(), "HEAD", "/metrics");
+    REQUIRE(head.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    REQUIRE(body_of(head).empty());
+
+    aggregator->add_sample(host, 13.5, true);
+    REQUIRE(body_of(get(server.port(), "GET", "/metrics")).find("pingstats_probes_total{host=\"example.org\"} 2\n") !=
+            std::string::npos);
+    REQUIRE(server.render_count() == 2);
+
+    REQUIRE(get(server.port(), "GET", "/").rfind("HTTP/1.1 404 ", 0) == 0);
+    const auto half_closed =
+        http_exchange(server.port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", true);
+    REQUIRE(half_closed.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    REQUIRE(get(server.port(), "POST", "/metrics").rfind("HTTP/1.1 405 ", 0) == 0);
+
+    server.stop();
+    server.stop();
+}
+
+TEST_CASE("metrics server reports addresses it cannot bind")
+{
+    auto aggregator = make_statistics_aggregator();
+    MetricsServer first(aggregator, parse_metrics_listen_address("127.0.0.1:0"));
+    REQUIRE_THROWS_AS(MetricsServer(aggregator, parse_metrics_listen_address("127.0.0.1:" + std::to_string(first.port()))),
+                      std::runtime_error);
+}
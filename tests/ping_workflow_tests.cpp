@@ -1,13 +1,18 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <thread>
 
+#include "ping_scheduler.hpp"
 #include "ping_session.hpp"
+#include "sample_ingestor.hpp"
+#include "sample_sink.hpp"
 #include "statistics_aggregator_impl.hpp"
 #include "platform_ping_backend.hpp"
 
@@ -42,6 +47,77 @@ private:
     std::size_t counter_{0};
 };
 
+/// Backend that parks async probes until the test completes them, like a slow network.
+class DeferredBackend final : public PlatformPingBackend {
+public:
+    void initialize() override {}
+    void shutdown() override {}
+
+    PingResult send_ping(std::string_view /*host*/, std::chrono::milliseconds /*timeout*/) override
+    {
+        return PingResult{false, 0.0};
+    }
+
+    void send_ping_async(std::string_view /*host*/, std::chrono::milliseconds /*timeout*/,
+                         PingCallback on_complete) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        parked_.push_back(std::move(on_complete));
+    }
+
+    std::size_t parked() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return parked_.size();
+    }
+
+    void complete_all(double rtt_ms)
+    {
+        std::vector<PingCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            callbacks.swap(parked_);
+        }
+        for (auto& callback : callbacks) {
+            callback(PingResult{true, rtt_ms});
+        }
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<PingCallback> parked_;
+};
+
+/// Sink that keeps every probe it receives.
+class RecordingSink final : public SampleSink {
+public:
+    HostId register_host(const std::string& host) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hosts_.push_back(host);
+        return static_cast<HostId>(hosts_.size() - 1);
+    }
+
+    void record(HostId host, const ProbeSample& sample) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.emplace_back(host, sample);
+    }
+
+    void flush() override {}
+
+    std::vector<std::pair<HostId, ProbeSample>> samples() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return samples_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::string> hosts_;
+    std::vector<std::pair<HostId, ProbeSample>> samples_;
+};
+
 }  // namespace
 
 TEST_CASE("ping workflow aggregates multiple hosts via fake backends")
@@ -92,3 +168,151 @@ TEST_CASE("ping workflow aggregates multiple hosts via fake backends")
     REQUIRE(snap_b.mean_ms >= 30.0);
 }
 
+
+TEST_CASE("scheduler drives many sessions from a small worker pool")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto scheduler = std::make_shared<PingScheduler>(2);
+    REQUIRE(scheduler->worker_count() == 2);
+
+    constexpr int kHosts = 32;
+    std::vector<std::unique_ptr<PingSession>> sessions;
+    for (int i = 0; i < kHosts; ++i) {
+        auto backend = std::make_shared<FakeBackend>(std::vector<FakeBackend::Entry>{{5.0, true}});
+        TargetConfig cfg;
+        cfg.host = "sched-" + std::to_string(i);
+        cfg.interval_s = 0.01;
+        sessions.push_back(make_ping_session(cfg, backend, aggregator, scheduler));
+    }
+
+    for (auto& s : sessions) {
+        s->start();
+        s->start();  // idempotent
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (auto& s : sessions) {
+        s->stop();
+    }
+
+    const auto snaps = aggregator->snapshot_all();
+    REQUIRE(snaps.size() == kHosts);
+    for (const auto& snap : snaps) {
+        REQUIRE(snap.count > 0);
+        REQUIRE(snap.loss_ratio == Approx(0.0));
+        REQUIRE(snap.mean_ms == Approx(5.0));
+    }
+
+    // Stopped sessions must not record further samples.
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    const auto after = aggregator->snapshot_all();
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        const auto& host = after[i].host;
+        const auto it = std::find_if(snaps.begin(), snaps.end(), [&](const auto& s) { return s.host == host; });
+        REQUIRE(it != snaps.end());
+        REQUIRE(it->count == after[i].count);
+    }
+}
+
+TEST_CASE("scheduled session waits a full interval between probes")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto scheduler = std::make_shared<PingScheduler>(1);
+    auto backend = std::make_shared<FakeBackend>(std::vector<FakeBackend::Entry>{{1.0, true}});
+    TargetConfig cfg;
+    cfg.host = "slow";
+    cfg.interval_s = 10.0;
+
+    auto session = make_ping_session(cfg, backend, aggregator, scheduler);
+    session->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // First probe is due immediately; the 10 s interval holds back the second.
+    REQUIRE(aggregator->snapshot("slow").count == 1);
+    session->stop();
+}
+
+TEST_CASE("scheduled sessions keep probes in flight without blocking workers")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto scheduler = std::make_shared<PingScheduler>(1);
+    auto backend = std::make_shared<DeferredBackend>();
+
+    constexpr int kHosts = 8;
+    std::vector<std::unique_ptr<PingSession>> sessions;
+    for (int i = 0; i < kHosts; ++i) {
+        TargetConfig cfg;
+        cfg.host = "async-" + std::to_string(i);
+        cfg.interval_s = 10.0;
+        sessions.push_back(make_ping_session(cfg, backend, aggregator, scheduler));
+        sessions.back()->start();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // A single worker submitted every host's probe although none has completed yet.
+    REQUIRE(backend->parked() == kHosts);
+    for (const auto& snap : aggregator->snapshot_all()) {
+        REQUIRE(snap.count == 0);
+    }
+
+    for (auto& s : sessions) {
+        s->stop();
+    }
+    // Completions arriving after stop are still recorded.
+    backend->complete_all(7.0);
+    const auto snaps = aggregator->snapshot_all();
+    REQUIRE(snaps.size() == kHosts);
+    for (const auto& snap : snaps) {
+        REQUIRE(snap.count == 1);
+        REQUIRE(snap.mean_ms == Approx(7.0));
+    }
+}
+
+TEST_CASE("sessions can queue samples to the ingest thread instead of the aggregator")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto ingestor = std::make_shared<SampleIngestor>(aggregator);
+    ingestor->start();
+
+    auto backend = std::make_shared<FakeBackend>(std::vector<FakeBackend::Entry>{{7.0, true}, {0.0, false}});
+    TargetConfig cfg;
+    cfg.host = "queued";
+    cfg.interval_s = 0.01;
+    auto session = make_ping_session(cfg, backend, aggregator, nullptr, ingestor);
+
+    session->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    session->stop();
+    ingestor->flush();
+
+    const auto snap = aggregator->snapshot("queued");
+    REQUIRE(snap.count >= 2);
+    REQUIRE(snap.min_ms == Approx(7.0));
+    REQUIRE(snap.loss_ratio > 0.0);
+    ingestor->stop();
+}
+
+TEST_CASE("sessions hand every probe to the sample sink with sequence numbers")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto sink = std::make_shared<RecordingSink>();
+    auto backend = std::make_shared<FakeBackend>(std::vector<FakeBackend::Entry>{{7.0, true}, {0.0, false}});
+    TargetConfig cfg;
+    cfg.host = "sunk";
+    cfg.interval_s = 0.01;
+    auto session = make_ping_session(cfg, backend, aggregator, nullptr, nullptr, sink);
+
+    const auto before = std::chrono::system_clock::now();
+    session->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    session->stop();
+
+    const auto samples = sink->samples();
+    REQUIRE(samples.size() >= 2);
+    REQUIRE(samples.size() == aggregator->snapshot("sunk").count);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        REQUIRE(samples[i].first == 0);
+        REQUIRE(samples[i].second.sequence == i);
+        REQUIRE(samples[i].second.sent_at >= before);
+        REQUIRE(samples[i].second.success == (i % 2 == 0));
+    }
+    REQUIRE(samples[0].second.rtt_ms == Approx(7.0));
+}
@@ -0,0 +1,211 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "probe_history.hpp"
+#include "sample_sink.hpp"
+#include "test_support.hpp"
+
+using namespace pingstats;
+using namespace pingstats::test;
+using Catch::Approx;
+
+namespace {
+
+using SystemClock = std::chrono::system_clock;
+
+ProbeSample sample_at(std::int64_t unix_ms, double rtt_ms, bool success)
+{
+    ProbeSample sample;
+    sample.sent_at = SystemClock::time_point{std::chrono::milliseconds{unix_ms}};
+    sample.rtt_ms = rtt_ms;
+    sample.success = success;
+    return sample;
+}
+
+SystemClock::time_point at_ms(std::int64_t unix_ms)
+{
+    return SystemClock::time_point{std::chrono::milliseconds{unix_ms}};
+}
+
+std::vector<HistorySample> round_trip(const std::vector<ProbeSample>& input)
+{
+    HistoryBlockEncoder encoder;
+    for (const auto& sample : input) {
+        encoder.append(sample);
+    }
+    std::vector<std::uint8_t> bytes;
+    encoder.finish_block(bytes);
+    REQUIRE(encoder.count() == 0);
+    HistoryBlockHeader header{};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    REQUIRE(bytes.size() == sizeof(header) + header.payload_bytes);
+    return decode_history_block(header, bytes.data() + sizeof(header));
+}
+
+/// Sample count of every block in a history file, in file order.
+std::vector<std::uint32_t> block_counts(const std::filesystem::path& file)
+{
+    const std::string bytes = read_file(file);
+    std::vector<std::uint32_t> counts;
+    for (std::size_t pos = 0; pos + sizeof(HistoryBlockHeader) <= bytes.size();) {
+        HistoryBlockHeader header{};
+        std::memcpy(&header, bytes.data() + pos, sizeof(header));
+        counts.push_back(header.count);
+        pos += sizeof(header) + header.payload_bytes;
+    }
+    return counts;
+}
+
+}  // namespace
+
+TEST_CASE("history blocks round-trip irregular timestamps, losses and RTTs")
+{
+    const std::int64_t t0 = 1700000000000;
+    const std::vector<ProbeSample> input{
+        sample_at(t0, 12.345, true),
+        sample_at(t0 + 1000, 0.0, false),
+        sample_at(t0 + 2001, 13.1, true),
+        sample_at(t0 + 2999, 400.25, true),  // small jitter both ways
+        sample_at(t0 + 2990, 0.001, true),   // out of order
+        sample_at(t0 + 90000000, 11.0, true),  // long gap needs the 64-bit escape
+        sample_at(t0 + 90001000, 0.0, false),
+        sample_at(t0 + 90002000, 11.0, true),
+        sample_at(t0 + 90002100, 11.5, true),
+    };
+    const auto decoded = round_trip(input);
+    REQUIRE(decoded.size() == input.size());
+    for (std::size_t i = 0; i < input.size(); ++i) {
+        INFO("sample " << i);
+        REQUIRE(decoded[i].sent_unix_ms ==
+                std::chrono::duration_cast<std::chrono::milliseconds>(input[i].sent_at.time_since_epoch()).count());
+        REQUIRE(decoded[i].success == input[i].success);
+        if (input[i].success) {
+            REQUIRE(decoded[i].rtt_ms == Approx(input[i].rtt_ms).margin(0.0005));
+        }
+    }
+}
+
+TEST_CASE("steady 1 Hz probes compress to a few bytes per sample")
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> jitter_ms(-3, 3);
+    std::normal_distribution<double> rtt(20.0, 0.8);
+    HistoryBlockEncoder encoder;
+    constexpr int kSamples = 1024;
+    for (int i = 0; i < kSamples; ++i) {
+        encoder.append(sample_at(1700000000000 + i * 1000 + jitter_ms(rng), rtt(rng), i % 100 != 0));
+    }
+    std::vector<std::uint8_t> bytes;
+    encoder.finish_block(bytes);
+    REQUIRE(bytes.size() < kSamples * 4);
+}
+
+TEST_CASE("history file names keep plain host names and escape the rest")
+{
+    REQUIRE(history_file_name("example.org") == "example.org.pshist");
+    REQUIRE(history_file_name("fe80::1") == "fe80%3A%3A1.pshist");
+    REQUIRE(history_file_name("../etc") == "%2E.%2Fetc.pshist");
+}
+
+TEST_CASE("history store writes blocks per host and reads a time range")
+{
+    TempPath dir("history_store");
+    const std::int64_t t0 = 1700000000000;
+    {
+        ProbeHistoryStore store(dir.string(), 16);
+        const auto a = store.register_host("a.example");
+        const auto b = store.register_host("b.example");
+        REQUIRE(store.register_host("a.example") == a);
+        for (int i = 0; i < 100; ++i) {
+            store.record(a, sample_at(t0 + i * 1000, 10.0 + i, i % 10 != 9));
+            store.record(b, sample_at(t0 + i * 1000, 50.0, true));
+        }
+        // 96 samples per host are in sealed blocks; the flush stores the open block after them.
+        store.flush();
+        REQUIRE(read_probe_history(dir.string(), "a.example", at_ms(t0), at_ms(t0 + 1000000)).size() == 100);
+    }
+
+    const auto all = read_probe_history(dir.string(), "a.example", at_ms(t0), at_ms(t0 + 1000000));
+    REQUIRE(all.size() == 100);
+    REQUIRE(all[99].sent_unix_ms == t0 + 99000);
+    REQUIRE_FALSE(all[9].success);
+    REQUIRE(all[10].rtt_ms == Approx(20.0));
+
+    const auto range = read_probe_history(dir.string(), "a.example", at_ms(t0 + 40000), at_ms(t0 + 49000));
+    REQUIRE(range.size() == 10);
+    REQUIRE(range.front().sent_unix_ms == t0 + 40000);
+    REQUIRE(range.front().rtt_ms == Approx(50.0));
+
+    REQUIRE(read_probe_history(dir.string(), "b.example", at_ms(t0), at_ms(t0 + 1000000)).size() == 100);
+    REQUIRE(read_probe_history(dir.string(), "unknown", at_ms(t0), at_ms(t0 + 1000000)).empty());
+}
+
+TEST_CASE("flushed open blocks are rewritten in place as they grow")
+{
+    TempPath dir("history_open_block");
+    const std::int64_t t0 = 1700000000000;
+    const auto file = dir.path / history_file_name("h");
+    {
+        ProbeHistoryStore store(dir.string(), 16);
+        const auto h = store.register_host("h");
+        for (int i = 0; i < 10; ++i) {
+            store.record(h, sample_at(t0 + i * 1000, 10.0, true));
+        }
+        store.flush();
+        REQUIRE(read_probe_history(dir.string(), "h", at_ms(t0), at_ms(t0 + 1000000)).size() == 10);
+        store.flush();  // nothing new: the file stays as it is
+        REQUIRE(block_counts(file) == std::vector<std::uint32_t>{10});
+
+        for (int i = 10; i < 20; ++i) {
+            store.record(h, sample_at(t0 + i * 1000, 10.0, true));
+        }
+        store.flush();
+        // One sealed block of 16 and an open one of 4, not the two flushed pieces of 10.
+        REQUIRE(block_counts(file) == std::vector<std::uint32_t>{16, 4});
+        const auto samples = read_probe_history(dir.string(), "h", at_ms(t0), at_ms(t0 + 1000000));
+        REQUIRE(samples.size() == 20);
+        for (std::size_t i = 0; i < samples.size(); ++i) {
+            REQUIRE(samples[i].sent_unix_ms == t0 + static_cast<std::int64_t>(i) * 1000);
+        }
+    }
+
+    // A new run appends after what the previous one left.
+    {
+        ProbeHistoryStore store(dir.string(), 16);
+        store.record(store.register_host("h"), sample_at(t0 + 20000, 10.0, true));
+    }
+    REQUIRE(read_probe_history(dir.string(), "h", at_ms(t0), at_ms(t0 + 1000000)).size() == 21);
+}
+
+TEST_CASE("sink fan-out forwards to every sink under its own ids")
+{
+    TempPath dir_a("history_fanout_a");
+    TempPath dir_b("history_fanout_b");
+    auto store_a = std::make_shared<ProbeHistoryStore>(dir_a.string());
+    auto store_b = std::make_shared<ProbeHistoryStore>(dir_b.string());
+    store_b->register_host("only-in-b");
+
+    REQUIRE(make_sample_sink_fanout({}) == nullptr);
+    REQUIRE(make_sample_sink_fanout({store_a}) == store_a);
+
+    auto fanout = make_sample_sink_fanout({store_a, store_b});
+    const auto host = fanout->register_host("shared");
+    REQUIRE(host == 0);
+    fanout->record(host, sample_at(1700000000000, 5.0, true));
+    fanout->flush();
+
+    for (const auto& dir : {dir_a.string(), dir_b.string()}) {
+        const auto samples = read_probe_history(dir, "shared", at_ms(0), at_ms(1800000000000));
+        REQUIRE(samples.size() == 1);
+        REQUIRE(samples[0].rtt_ms == Approx(5.0));
+    }
+}
@@ -0,0 +1,183 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raw_sample_log.hpp"
+#include "test_support.hpp"
+
+using namespace pingstats;
+using namespace pingstats::test;
+
+namespace {
+
+ProbeSample make_sample(std::uint32_t sequence, double rtt_ms, bool success)
+{
+    ProbeSample sample;
+    sample.sent_at = std::chrono::system_clock::time_point{std::chrono::seconds{1700000000 + sequence}};
+    sample.rtt_ms = rtt_ms;
+    sample.sequence = sequence;
+    sample.success = success;
+    return sample;
+}
+
+}  // namespace
+
+TEST_CASE("raw sample log stores records and the host dictionary in place")
+{
+    TempPath tmp("basic.rawlog");
+    {
+        RawSampleLog log(tmp.string());
+        const auto a = log.register_host("alpha.example");
+        const auto b = log.register_host("b");
+        REQUIRE(log.register_host("alpha.example") == a);
+        REQUIRE(a != b);
+        log.record(a, make_sample(0, 12.5, true));
+        log.record(b, make_sample(0, 0.0, false));
+        log.record(a, make_sample(1, 13.0, true));
+    }
+
+    RawSampleLogView view(tmp.string());
+    REQUIRE(view.header().record_count == 3);
+    REQUIRE(view.record_slots() == 3);
+    REQUIRE(view.hosts() == std::vector<std::string>{"alpha.example", "b"});
+    REQUIRE(std::filesystem::file_size(tmp.string()) == view.header().records_offset + 3 * sizeof(RawSampleRecord));
+
+    const RawSampleRecord* records = view.records();
+    REQUIRE(records[0].host_id == 0);
+    REQUIRE(records[0].rtt_ms == 12.5);
+    REQUIRE(records[0].flags == (kRawRecordCommitted | kRawRecordSuccess));
+    REQUIRE(records[0].sent_unix_ns == 1700000000LL * 1000000000LL);
+    REQUIRE(records[1].host_id == 1);
+    REQUIRE(records[1].flags == kRawRecordCommitted);
+    REQUIRE(records[2].sequence == 1);
+}
+
+TEST_CASE("raw sample log grows in chunks and reopens at its end")
+{
+    TempPath tmp("grow.rawlog");
+    RawSampleLog::Options options;
+    options.grow_records = 4;
+    {
+        RawSampleLog log(tmp.string(), options);
+        const auto host = log.register_host("grower");
+        for (std::uint32_t i = 0; i < 10; ++i) {
+            log.record(host, make_sample(i, i, true));
+        }
+        log.flush();
+        RawSampleLogView live(tmp.string());
+        REQUIRE(live.header().record_count == 10);
+        REQUIRE(live.record_slots() == 12);
+    }
+    {
+        RawSampleLog log(tmp.string(), options);
+        REQUIRE(log.register_host("second") == 1);
+        REQUIRE(log.register_host("grower") == 0);
+        log.record(1, make_sample(10, 10.0, true));
+    }
+
+    RawSampleLogView view(tmp.string());
+    REQUIRE(view.record_slots() == 11);
+    REQUIRE(view.hosts() == std::vector<std::string>{"grower", "second"});
+    for (std::uint32_t i = 0; i < 11; ++i) {
+        REQUIRE(view.records()[i].sequence == i);
+        REQUIRE((view.records()[i].flags & kRawRecordCommitted) != 0);
+    }
+}
+
+TEST_CASE("raw sample log drops samples beyond max_records")
+{
+    TempPath tmp("full.rawlog");
+    RawSampleLog::Options options;
+    options.grow_records = 2;
+    options.max_records = 3;
+    RawSampleLog log(tmp.string(), options);
+    const auto host = log.register_host("h");
+    for (std::uint32_t i = 0; i < 5; ++i) {
+        log.record(host, make_sample(i, 1.0, true));
+    }
+    REQUIRE(log.dropped() == 2);
+    log.flush();
+    RawSampleLogView view(tmp.string());
+    REQUIRE(view.header().record_count == 3);
+}
+
+TEST_CASE("raw sample log maps records chunk by chunk and bounds max_records")
+{
+    TempPath tmp("chunks.rawlog");
+    RawSampleLog::Options options;
+    options.grow_records = 100;  // one mapping holds 128 slots
+    {
+        RawSampleLog log(tmp.string(), options);
+        const auto host = log.register_host("h");
+        for (std::uint32_t i = 0; i < 300; ++i) {
+            log.record(host, make_sample(i, 1.0, true));
+        }
+    }
+    {
+        RawSampleLog reopened(tmp.string(), options);
+        for (std::uint32_t i = 300; i < 520; ++i) {
+            reopened.record(0, make_sample(i, 1.0, true));
+        }
+    }
+
+    RawSampleLogView view(tmp.string());
+    REQUIRE(view.record_slots() == 520);
+    for (std::uint32_t i = 0; i < 520; ++i) {
+        REQUIRE(view.records()[i].sequence == i);
+    }
+
+    RawSampleLog::Options oversized;
+    oversized.max_records = kRawLogMaxRecords + 1;
+    REQUIRE_THROWS_AS(RawSampleLog(tmp.string(), oversized), std::invalid_argument);
+}
+
+TEST_CASE("raw sample log accepts concurrent writers without losing records")
+{
+    TempPath tmp("threads.rawlog");
+    constexpr int kThreads = 4;
+    constexpr std::uint32_t kPerThread = 20000;
+    RawSampleLog::Options options;
+    options.grow_records = 1024;
+    {
+        RawSampleLog log(tmp.string(), options);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < kThreads; ++t) {
+            const auto host = log.register_host("host-" + std::to_string(t));
+            writers.emplace_back([&log, host]() {
+                for (std::uint32_t i = 0; i < kPerThread; ++i) {
+                    log.record(host, make_sample(i, 1.0, true));
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+    }
+
+    RawSampleLogView view(tmp.string());
+    REQUIRE(view.record_slots() == kThreads * kPerThread);
+    std::vector<std::uint32_t> next_sequence(kThreads, 0);
+    for (std::uint64_t i = 0; i < view.record_slots(); ++i) {
+        const auto& record = view.records()[i];
+        REQUIRE((record.flags & kRawRecordCommitted) != 0);
+        REQUIRE(record.sequence == next_sequence[record.host_id]++);
+    }
+}
+
+TEST_CASE("raw sample log rejects files that are not logs")
+{
+    TempPath tmp("bogus.rawlog");
+    {
+        std::ofstream ofs(tmp.string());
+        ofs << std::string(8192, 'x');
+    }
+    REQUIRE_THROWS_AS(RawSampleLog(tmp.string()), std::runtime_error);
+    REQUIRE_THROWS_AS(RawSampleLogView(tmp.string()), std::runtime_error);
+}
@@ -0,0 +1,202 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sample_ingestor.hpp"
+#include "spsc_queue.hpp"
+#include "statistics_aggregator_impl.hpp"
+
+using namespace pingstats;
+
+namespace {
+
+/// Aggregator whose timestamped add_sample() blocks while open is false, to stall the ingest thread.
+class GatedAggregator : public StatisticsAggregator {
+public:
+    std::atomic<bool> open{true};
+
+    HostHandle register_host(const std::string& host) override { return inner_->register_host(host); }
+    HostHandle register_host(const std::string& host, const std::vector<double>& bucket_boundaries) override
+    {
+        return inner_->register_host(host, bucket_boundaries);
+    }
+    void add_sample(const std::string& host, double rtt_ms, bool success) override
+    {
+        inner_->add_sample(host, rtt_ms, success);
+    }
+    void add_sample(HostHandle host, double rtt_ms, bool success) override { inner_->add_sample(host, rtt_ms, success); }
+    void add_sample(HostHandle host, double rtt_ms, bool success,
+                    std::chrono::steady_clock::time_point measured_at) override
+    {
+        while (!open.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        inner_->add_sample(host, rtt_ms, success, measured_at);
+    }
+    StatisticsSnapshot snapshot(const std::string& host) const override { return inner_->snapshot(host); }
+    std::vector<StatisticsSnapshot> snapshot_all() const override { return inner_->snapshot_all(); }
+    SnapshotSet snapshot_changed_since(std::uint64_t version) const override
+    {
+        return inner_->snapshot_changed_since(version);
+    }
+    std::shared_ptr<const SnapshotSet> published_snapshots() const override { return inner_->published_snapshots(); }
+    void reset(const std::string& host) override { inner_->reset(host); }
+    void reset_all() override { inner_->reset_all(); }
+
+private:
+    std::shared_ptr<StatisticsAggregator> inner_ = make_statistics_aggregator();
+};
+
+}  // namespace
+
+TEST_CASE("SPSC queue preserves order, bounds capacity, and consumes in batches")
+{
+    SpscQueue<int> queue(3);
+    REQUIRE(queue.capacity() == 4);
+    REQUIRE(queue.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(queue.try_push(i));
+    }
+    REQUIRE_FALSE(queue.try_push(99));
+
+    std::vector<int> seen;
+    REQUIRE(queue.consume([&](int v) { seen.push_back(v); }, 3) == 3);
+    REQUIRE(seen == std::vector<int>{0, 1, 2});
+    REQUIRE(queue.try_push(4));
+    REQUIRE(queue.consume([&](int v) { seen.push_back(v); }, 16) == 2);
+    REQUIRE(seen == std::vector<int>{0, 1, 2, 3, 4});
+    REQUIRE(queue.empty());
+    REQUIRE(queue.consume([&](int v) { seen.push_back(v); }, 16) == 0);
+}
+
+TEST_CASE("SPSC queue hands every element across threads exactly once")
+{
+    constexpr int kCount = 100000;
+    SpscQueue<int> queue(64);
+    std::thread producer([&]() {
+        for (int i = 0; i < kCount; ++i) {
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool in_order = true;
+    while (expected < kCount) {
+        const auto consumed = queue.consume(
+            [&](int v) {
+                in_order = in_order && v == expected;
+                ++expected;
+            },
+            32);
+        if (consumed == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    REQUIRE(in_order);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("ingestor applies samples from many producer threads to the aggregator")
+{
+    auto aggregator = make_statistics_aggregator();
+    auto ingestor = std::make_shared<SampleIngestor>(aggregator, 16);
+    ingestor->start();
+
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 5000;
+    std::vector<StatisticsAggregator::HostHandle> handles;
+    for (int t = 0; t < kThreads; ++t) {
+        handles.push_back(aggregator->register_host("lane-" + std::to_string(t)));
+    }
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+        producers.emplace_back([&, t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                ingestor->submit(SampleRecord{handles[t], 5.0, i % 10 != 0, std::chrono::steady_clock::now()});
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    ingestor->flush();
+
+    for (int t = 0; t < kThreads; ++t) {
+        const auto snap = aggregator->snapshot("lane-" + std::to_string(t));
+        REQUIRE(snap.count == kPerThread);
+        REQUIRE(snap.loss_ratio == 0.1);
+        REQUIRE(snap.window_1m.count == kPerThread);
+    }
+
+    ingestor->stop();
+    ingestor->submit(SampleRecord{handles[0], 5.0, true, std::chrono::steady_clock::now()});
+    REQUIRE(aggregator->snapshot("lane-0").count == kPerThread + 1);
+}
+
+TEST_CASE("ingestor loses no sample submitted concurrently with stop")
+{
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 20000;
+    for (int round = 0; round < 8; ++round) {
+        auto aggregator = make_statistics_aggregator();
+        const auto handle = aggregator->register_host("race");
+        SampleIngestor ingestor(aggregator, 8);
+        ingestor.start();
+
+        std::atomic<int> started{0};
+        std::vector<std::thread> producers;
+        for (int t = 0; t < kThreads; ++t) {
+            producers.emplace_back([&]() {
+                started.fetch_add(1);
+                for (int i = 0; i < kPerThread; ++i) {
+                    ingestor.submit(SampleRecord{handle, 1.0, true, std::chrono::steady_clock::now()});
+                }
+            });
+        }
+        while (started.load() < kThreads) {
+            std::this_thread::yield();
+        }
+        ingestor.stop();
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        REQUIRE(aggregator->snapshot("race").count == kThreads * kPerThread);
+
+        // Restarting reopens the lanes the producers left behind.
+        ingestor.start();
+        ingestor.submit(SampleRecord{handle, 1.0, true, std::chrono::steady_clock::now()});
+        REQUIRE(ingestor.flush());
+        REQUIRE(aggregator->snapshot("race").count == kThreads * kPerThread + 1);
+    }
+}
+
+TEST_CASE("ingestor flush gives up after its timeout while the ingest thread is stalled")
+{
+    auto gated = std::make_shared<GatedAggregator>();
+    const auto handle = gated->register_host("stalled");
+    SampleIngestor ingestor(gated, 4);
+    ingestor.start();
+
+    gated->open.store(false);
+    ingestor.submit(SampleRecord{handle, 1.0, true, std::chrono::steady_clock::now()});
+    const auto begin = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(ingestor.flush(std::chrono::milliseconds{20}));
+    REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds{2});
+
+    gated->open.store(true);
+    REQUIRE(ingestor.flush());
+    REQUIRE(gated->snapshot("stalled").count == 1);
+    ingestor.stop();
+}
@@ -1,6 +1,18 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.hpp"
+#include "fixed_ring_buffer.hpp"
+#include "log_linear_histogram.hpp"
+#include "quantile_sketch.hpp"
+#include "rolling_window.hpp"
 #include "statistics_aggregator_impl.hpp"
 
 using namespace pingstats;
@@ -32,7 +44,8 @@ TEST_CASE("basic success and loss updates stats")
     REQUIRE(snap.min_ms == Approx(10.0));
     REQUIRE(snap.max_ms == Approx(20.0));
     REQUIRE(snap.mean_ms == Approx(15.0));
-    REQUIRE(snap.median_ms == Approx(15.0));
+    // Median comes from the streaming sketch, which guarantees 1% relative accuracy.
+    REQUIRE(snap.median_ms == Approx(15.0).epsilon(0.01));
     REQUIRE_FALSE(snap.histogram_buckets.empty());
     REQUIRE_FALSE(snap.recent_rtts.empty());
 }
@@ -42,20 +55,20 @@ TEST_CASE("histogram bucket edges distribute counts")
     auto agg = make_statistics_aggregator();
     // Default boundaries: 10,20,50,100,200,500
     agg->add_sample("h", 5.0, true);    // bucket 0
-    agg->add_sample("h", 10.0, true);   // boundary => bucket 1
+    agg->add_sample("h", 10.0, true);   // boundary => bucket 0 (<= 10)
     agg->add_sample("h", 55.0, true);   // bucket 3 (50-100)
-    agg->add_sample("h", 500.0, true);  // boundary => last bucket
+    agg->add_sample("h", 500.0, true);  // boundary => bucket 5 (<= 500)
     agg->add_sample("h", 800.0, true);  // last bucket overflow
 
     auto snap = agg->snapshot("h");
     REQUIRE(snap.histogram_buckets.size() == 7);
-    REQUIRE(snap.histogram_buckets[0].second == Approx(1.0));
-    REQUIRE(snap.histogram_buckets[1].second == Approx(1.0));
+    REQUIRE(snap.histogram_buckets[0].second == Approx(2.0));
+    REQUIRE(snap.histogram_buckets[1].second == Approx(0.0));
     REQUIRE(snap.histogram_buckets[2].second == Approx(0.0));
     REQUIRE(snap.histogram_buckets[3].second == Approx(1.0));
     REQUIRE(snap.histogram_buckets[4].second == Approx(0.0));
-    REQUIRE(snap.histogram_buckets[5].second == Approx(0.0));
-    REQUIRE(snap.histogram_buckets[6].second == Approx(2.0));
+    REQUIRE(snap.histogram_buckets[5].second == Approx(1.0));
+    REQUIRE(snap.histogram_buckets[6].second == Approx(1.0));
 }
 
 TEST_CASE("reset clears stats")
@@ -73,3 +86,428 @@ TEST_CASE("reset clears stats")
     REQUIRE(sum == Approx(0.0));
 }
 
+
+TEST_CASE("concurrent writers and snapshots keep per-host counts exact")
+{
+    auto agg = make_statistics_aggregator();
+    constexpr int kThreads = 8;
+    constexpr int kHostsPerThread = 50;
+    constexpr int kSamplesPerHost = 20;
+
+    std::atomic<bool> writing{true};
+    std::thread reader([&] {
+        while (writing.load()) {
+            (void)agg->snapshot_all();
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&, t] {
+            for (int n = 0; n < kSamplesPerHost; ++n) {
+                for (int h = 0; h < kHostsPerThread; ++h) {
+                    // Every host is written by two threads to exercise the per-host lock.
+                    agg->add_sample("h" + std::to_string((t / 2) * kHostsPerThread + h), 5.0, true);
+                }
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+    writing.store(false);
+    reader.join();
+
+    const auto snaps = agg->snapshot_all();
+    REQUIRE(snaps.size() == (kThreads / 2) * kHostsPerThread);
+    for (const auto& snap : snaps) {
+        REQUIRE(snap.count == 2 * kSamplesPerHost);
+        REQUIRE(snap.mean_ms == Approx(5.0));
+    }
+}
+
+TEST_CASE("host handles address the same stats as host names")
+{
+    auto agg = make_statistics_aggregator();
+    const auto a = agg->register_host("a");
+    const auto b = agg->register_host("b");
+    REQUIRE(a != b);
+    REQUIRE(agg->register_host("a") == a);
+
+    agg->add_sample(a, 10.0, true);
+    agg->add_sample("a", 20.0, true);
+    agg->add_sample(b, 0.0, false);
+    agg->add_sample(b + 100, 1.0, true);  // unknown handle is ignored
+
+    const auto snap_a = agg->snapshot("a");
+    REQUIRE(snap_a.count == 2);
+    REQUIRE(snap_a.mean_ms == Approx(15.0));
+    REQUIRE(agg->snapshot("b").loss_ratio == Approx(1.0));
+
+    // Registered hosts appear in registration order, even before their first sample.
+    agg->register_host("c");
+    const auto snaps = agg->snapshot_all();
+    REQUIRE(snaps.size() == 3);
+    REQUIRE(snaps[0].host == "a");
+    REQUIRE(snaps[2].host == "c");
+    REQUIRE(snaps[2].count == 0);
+}
+
+TEST_CASE("quantile sketch tracks tail percentiles within its relative accuracy")
+{
+    QuantileSketch sketch;
+    for (int i = 1; i <= 10000; ++i) {
+        sketch.add(static_cast<double>(i) / 10.0);  // 0.1 .. 1000 ms
+    }
+    REQUIRE(sketch.count() == 10000);
+    REQUIRE(sketch.quantile(0.5) == Approx(500.0).epsilon(0.01));
+    REQUIRE(sketch.quantile(0.99) == Approx(990.0).epsilon(0.01));
+    REQUIRE(sketch.quantile(0.999) == Approx(999.0).epsilon(0.01));
+    REQUIRE(sketch.quantile(0.0) == Approx(0.1).epsilon(0.01));
+
+    QuantileSketch low;
+    QuantileSketch high;
+    for (int i = 1; i <= 10000; ++i) {
+        (i <= 5000 ? low : high).add(static_cast<double>(i) / 10.0);
+    }
+    low.merge(high);
+    REQUIRE(low.count() == sketch.count());
+    REQUIRE(low.quantile(0.95) == Approx(sketch.quantile(0.95)));
+
+    sketch.clear();
+    REQUIRE(sketch.count() == 0);
+    REQUIRE(sketch.quantile(0.5) == 0.0);
+}
+
+TEST_CASE("snapshot reports percentiles over the whole run")
+{
+    auto agg = make_statistics_aggregator();
+    for (int i = 0; i < 990; ++i) {
+        agg->add_sample("tail", 10.0, true);
+    }
+    for (int i = 0; i < 10; ++i) {
+        agg->add_sample("tail", 400.0, true);
+    }
+    const auto snap = agg->snapshot("tail");
+    REQUIRE(snap.median_ms == Approx(10.0).epsilon(0.01));
+    REQUIRE(snap.p95_ms == Approx(10.0).epsilon(0.01));
+    REQUIRE(snap.p999_ms == Approx(400.0).epsilon(0.01));
+    REQUIRE(snap.p999_ms <= snap.max_ms);
+}
+
+TEST_CASE("log-linear histogram buckets stay within their relative precision")
+{
+    LogLinearHistogram hist(10, 60000000, 2);
+    for (std::uint64_t value : {std::uint64_t{0}, std::uint64_t{1}, std::uint64_t{127}, std::uint64_t{1000},
+                                std::uint64_t{12345}, std::uint64_t{987654}, std::uint64_t{59999999}}) {
+        const std::size_t index = hist.index_for(value);
+        REQUIRE(index < hist.slot_count());
+        REQUIRE(hist.lowest_equivalent(index) <= value);
+        REQUIRE(value < hist.next_non_equivalent(index));
+        if (value >= 1000) {
+            const double width = static_cast<double>(hist.next_non_equivalent(index) - hist.lowest_equivalent(index));
+            REQUIRE(width / static_cast<double>(value) <= 0.01);
+        }
+    }
+    REQUIRE(hist.index_for(std::uint64_t{1} << 40) == hist.index_for(60000000));
+
+    LogLinearHistogram other(10, 60000000, 2);
+    hist.record(500);
+    other.record(500);
+    other.record(70000);
+    hist.merge(other);
+    REQUIRE(hist.total_count() == 3);
+    REQUIRE(hist.count_at(hist.index_for(500)) == 2);
+    REQUIRE(hist.count_at(hist.index_for(70000)) == 1);
+
+    hist.clear();
+    REQUIRE(hist.total_count() == 0);
+    REQUIRE(hist.count_at(hist.index_for(500)) == 0);
+}
+
+TEST_CASE("log-linear aggregator mode reports fine-grained buckets")
+{
+    AggregatorConfig config;
+    config.histogram_mode = HistogramMode::LogLinear;
+    auto agg = make_statistics_aggregator(config);
+    agg->add_sample("fine", 10.0, true);
+    agg->add_sample("fine", 10.4, true);
+    agg->add_sample("fine", 250.0, true);
+    agg->add_sample("fine", 0.0, false);
+
+    const auto snap = agg->snapshot("fine");
+    REQUIRE(snap.histogram_buckets.size() > 2);
+    double total = 0.0;
+    double below_eleven = 0.0;
+    for (const auto& bucket : snap.histogram_buckets) {
+        total += bucket.second;
+        if (bucket.first <= 11.0) {
+            below_eleven += bucket.second;
+        }
+    }
+    REQUIRE(total == Approx(3.0));
+    REQUIRE(below_eleven == Approx(2.0));
+    REQUIRE(snap.histogram_buckets.back().second == 0.0);
+    REQUIRE(snap.histogram_buckets.back().first >= 250.0);
+
+    AggregatorConfig invalid;
+    invalid.histogram_mode = HistogramMode::LogLinear;
+    invalid.log_linear_significant_digits = 9;
+    REQUIRE_THROWS(make_statistics_aggregator(invalid));
+}
+
+TEST_CASE("per-host bucket boundaries place samples by binary search")
+{
+    AggregatorConfig config;
+    config.bucket_boundaries = {1.0, 2.0};
+    auto agg = make_statistics_aggregator(config);
+
+    std::vector<double> wide;
+    for (int i = 1; i <= 64; ++i) {
+        wide.push_back(static_cast<double>(i * 10));
+    }
+    const auto handle = agg->register_host("wide", wide);
+    REQUIRE(agg->register_host("wide", {5.0}) == handle);  // first registration wins
+    agg->add_sample(handle, 5.0, true);
+    agg->add_sample(handle, 10.0, true);  // a boundary value belongs to its own bucket
+    agg->add_sample(handle, 639.0, true);
+    agg->add_sample(handle, 640.0, true);
+
+    const auto snap = agg->snapshot("wide");
+    REQUIRE(snap.histogram_buckets.size() == 65);
+    REQUIRE(snap.histogram_buckets[0].second == 2.0);
+    REQUIRE(snap.histogram_buckets[1].second == 0.0);
+    REQUIRE(snap.histogram_buckets[63].second == 2.0);
+    REQUIRE(snap.histogram_buckets[64].second == 0.0);
+
+    agg->add_sample("default", 1.5, true);
+    const auto fallback = agg->snapshot("default");
+    REQUIRE(fallback.histogram_buckets.size() == 3);
+    REQUIRE(fallback.histogram_buckets[1].second == 1.0);
+
+    REQUIRE_THROWS_AS(agg->register_host("bad", {3.0, 1.0}), std::invalid_argument);
+    REQUIRE(agg->snapshot_all().size() == 2);
+
+    AggregatorConfig invalid;
+    invalid.bucket_boundaries = {-1.0};
+    REQUIRE_THROWS(make_statistics_aggregator(invalid));
+}
+
+TEST_CASE("rolling window summarizes only the slots inside the span")
+{
+    using namespace std::chrono_literals;
+    RollingWindow window{10s, 90};
+    const RollingWindow::Clock::time_point start{std::chrono::hours{1}};
+
+    // Ten minutes ago: a clean period at 10 ms.
+    for (int i = 0; i < 60; ++i) {
+        window.add(start + std::chrono::seconds{i}, 10.0, true);
+    }
+    // Last minute: an outage with half the probes lost and slower replies.
+    const auto recent = start + 10min;
+    for (int i = 0; i < 50; ++i) {
+        window.add(recent + std::chrono::seconds{i}, 100.0, i % 2 == 0);
+    }
+    const auto now = recent + 50s;
+
+    const auto last_1m = window.summarize(now, 60s);
+    REQUIRE(last_1m.count == 50);
+    REQUIRE(last_1m.loss_ratio == Approx(0.5));
+    REQUIRE(last_1m.min_ms == 100.0);
+    REQUIRE(last_1m.mean_ms == Approx(100.0));
+    REQUIRE(last_1m.p99_ms == Approx(100.0).epsilon(0.01));
+
+    const auto last_15m = window.summarize(now, 900s);
+    REQUIRE(last_15m.count == 110);
+    REQUIRE(last_15m.loss_ratio == Approx(25.0 / 110.0));
+    REQUIRE(last_15m.min_ms == 10.0);
+    REQUIRE(last_15m.max_ms == 100.0);
+    REQUIRE(last_15m.median_ms == Approx(10.0).epsilon(0.01));
+
+    // Twenty minutes on every slot has aged out, including ones never recycled.
+    const auto later = window.summarize(now + 20min, 900s);
+    REQUIRE(later.count == 0);
+    REQUIRE(later.mean_ms == 0.0);
+
+    window.add(now, 5.0, true);
+    window.clear();
+    REQUIRE(window.summarize(now, 60s).count == 0);
+}
+
+TEST_CASE("snapshot carries rolling windows next to lifetime totals")
+{
+    auto agg = make_statistics_aggregator();
+    agg->add_sample("win", 20.0, true);
+    agg->add_sample("win", 0.0, false);
+
+    const auto snap = agg->snapshot("win");
+    REQUIRE(snap.window_1m.count == 2);
+    REQUIRE(snap.window_1m.loss_ratio == Approx(0.5));
+    REQUIRE(snap.window_1m.mean_ms == Approx(20.0));
+    REQUIRE(snap.window_15m.count == snap.count);
+
+    agg->reset("win");
+    REQUIRE(agg->snapshot_all().front().window_5m.count == 0);
+}
+
+TEST_CASE("fixed ring buffer keeps the newest values in order across wraparound")
+{
+    FixedRingBuffer<double> ring(4);
+    std::vector<double> out;
+    ring.copy_to(out);
+    REQUIRE(out.empty());
+
+    for (int i = 1; i <= 3; ++i) {
+        ring.push_back(static_cast<double>(i));
+    }
+    ring.copy_to(out);
+    REQUIRE(out == std::vector<double>{1, 2, 3});
+
+    for (int i = 4; i <= 10; ++i) {
+        ring.push_back(static_cast<double>(i));
+    }
+    REQUIRE(ring.size() == 4);
+    REQUIRE(ring[0] == 7.0);
+    ring.copy_to(out);
+    REQUIRE(out == std::vector<double>{7, 8, 9, 10});
+
+    FixedRingBuffer<double> copy(ring);
+    ring.push_back(11.0);
+    copy.copy_to(out);
+    REQUIRE(out == std::vector<double>{7, 8, 9, 10});
+    copy.push_back(12.0);
+    copy.copy_to(out);
+    REQUIRE(out == std::vector<double>{8, 9, 10, 12});
+
+    FixedRingBuffer<double> moved(std::move(copy));
+    REQUIRE(moved.size() == 4);
+    REQUIRE(copy.capacity() == 0);
+    copy.push_back(1.0);
+    REQUIRE(copy.empty());
+
+    ring.clear();
+    REQUIRE(ring.empty());
+    REQUIRE(ring.capacity() == 4);
+}
+
+TEST_CASE("recent RTTs keep the latest 256 successes")
+{
+    auto agg = make_statistics_aggregator();
+    for (int i = 0; i < 300; ++i) {
+        agg->add_sample("spark", static_cast<double>(i), true);
+    }
+    agg->add_sample("spark", 0.0, false);
+    const auto snap = agg->snapshot("spark");
+    REQUIRE(snap.recent_rtts.size() == 256);
+    REQUIRE(snap.recent_rtts.front() == 44.0);
+    REQUIRE(snap.recent_rtts.back() == 299.0);
+}
+
+TEST_CASE("published snapshot set is reused until the data changes")
+{
+    auto agg = make_statistics_aggregator();
+    agg->add_sample("pub", 12.0, true);
+
+    const auto first = agg->published_snapshots();
+    REQUIRE(first->hosts.size() == 1);
+    REQUIRE(first->hosts.front().count == 1);
+    REQUIRE(agg->published_snapshots() == first);
+
+    agg->add_sample("pub", 14.0, true);
+    const auto second = agg->published_snapshots();
+    REQUIRE(second != first);
+    REQUIRE(second->version > first->version);
+    REQUIRE(second->hosts.front().count == 2);
+    REQUIRE(first->hosts.front().count == 1);  // earlier readers keep their immutable set
+
+    agg->reset("pub");
+    REQUIRE(agg->published_snapshots()->hosts.front().count == 0);
+}
+
+TEST_CASE("snapshot_changed_since reports only hosts with new samples")
+{
+    auto agg = make_statistics_aggregator();
+    for (int i = 0; i < 50; ++i) {
+        agg->add_sample("fleet-" + std::to_string(i), 10.0, true);
+    }
+
+    const auto all = agg->snapshot_changed_since(0);
+    REQUIRE(all.hosts.size() == 50);
+
+    const auto none = agg->snapshot_changed_since(all.version);
+    REQUIRE(none.hosts.empty());
+    REQUIRE(none.version == all.version);
+
+    agg->add_sample("fleet-7", 20.0, true);
+    agg->add_sample("fleet-42", 0.0, false);
+    const auto delta = agg->snapshot_changed_since(all.version);
+    REQUIRE(delta.hosts.size() == 2);
+    REQUIRE(delta.hosts[0].host == "fleet-7");
+    REQUIRE(delta.hosts[0].count == 2);
+    REQUIRE(delta.hosts[1].host == "fleet-42");
+    REQUIRE(delta.hosts[1].loss_ratio == Approx(0.5));
+    REQUIRE(delta.version > all.version);
+
+    // Cached snapshots of unchanged hosts stay identical to freshly built ones.
+    const auto snaps = agg->snapshot_all();
+    REQUIRE(snaps.size() == 50);
+    REQUIRE(snaps[7].count == 2);
+    REQUIRE(snaps[8].count == 1);
+    REQUIRE(snaps[8].mean_ms == Approx(10.0));
+
+    agg->reset("fleet-8");
+    const auto after_reset = agg->snapshot_changed_since(delta.version);
+    REQUIRE(after_reset.hosts.size() == 1);
+    REQUIRE(after_reset.hosts[0].count == 0);
+}
+
+TEST_CASE("change tracking never misses a sample written concurrently with readers")
+{
+    auto agg = make_statistics_aggregator();
+    constexpr int kHosts = 8;
+    constexpr int kPerHost = 5000;
+    std::vector<StatisticsAggregator::HostHandle> handles;
+    for (int i = 0; i < kHosts; ++i) {
+        handles.push_back(agg->register_host("live-" + std::to_string(i)));
+    }
+
+    std::atomic<bool> writing{true};
+    std::vector<std::thread> writers;
+    for (int i = 0; i < kHosts; ++i) {
+        writers.emplace_back([&, i]() {
+            for (int n = 0; n < kPerHost; ++n) {
+                agg->add_sample(handles[i], 1.0, true);
+            }
+        });
+    }
+
+    // A delta consumer that only keeps what snapshot_changed_since reports must end up current.
+    std::vector<std::size_t> seen(kHosts, 0);
+    std::uint64_t version = 0;
+    const auto poll = [&]() {
+        const auto delta = agg->snapshot_changed_since(version);
+        version = delta.version;
+        for (const auto& snap : delta.hosts) {
+            seen[static_cast<std::size_t>(std::stoi(snap.host.substr(5)))] = snap.count;
+        }
+        (void)agg->published_snapshots();
+    };
+    std::thread reader([&]() {
+        while (writing.load()) {
+            poll();
+        }
+    });
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    writing.store(false);
+    reader.join();
+    poll();
+
+    for (int i = 0; i < kHosts; ++i) {
+        REQUIRE(seen[static_cast<std::size_t>(i)] == kPerHost);
+    }
+    for (const auto& snap : agg->published_snapshots()->hosts) {
+        REQUIRE(snap.count == kPerHost);
+    }
+}
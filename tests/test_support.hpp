@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+namespace pingstats::test {
+
+/// Path "pingstats_<name>" in the temp directory; whatever is there is removed when the test
+/// starts and again when it ends.
+struct TempPath {
+    std::filesystem::path path;
+
+    explicit TempPath(const std::string& name) : path(std::filesystem::temp_directory_path() / ("pingstats_" + name))
+    {
+        std::filesystem::remove_all(path);
+    }
+    ~TempPath()
+    {
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+
+    TempPath(const TempPath&) = delete;
+    TempPath& operator=(const TempPath&) = delete;
+
+    /// The path as a string, for APIs that take one.
+    [[nodiscard]] std::string string() const { return path.string(); }
+};
+
+/// TempPath created as an empty directory.
+struct TempDir : TempPath {
+    explicit TempDir(const std::string& name) : TempPath(name) { std::filesystem::create_directories(path); }
+};
+
+/// Whole file contents; empty when the file cannot be read.
+inline std::string read_file(const std::filesystem::path& path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+}  // namespace pingstats::test